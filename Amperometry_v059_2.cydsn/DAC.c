@@ -2,9 +2,14 @@
 * File Name: DAC.c
 *
 * Description:
-*  An abstraction of 2 different DACs, an 8-bit VDAC or 12-bit DVDAC.
+*  An abstraction of 4 different DACs, an 8-bit VDAC, 12-bit DVDAC, 12-bit MIDAC
+*  or 11-bit PIDAC.
 *  This file contains the source code for
-*  the custom DAC, an 8-bit VDAC or 12-bit DVDAC selectable by the user
+*  the custom DAC, one of the 4 DACs selectable by the user.  The DVDAC has the
+*  best resolution but is dithered by DMA, the MIDAC and PIDAC are current DACs
+*  into a load resistor that update faster, the PIDAC the fastest
+*  Each DAC has a table of its functions and DAC_Start points dac_ops at the
+*  table of the DAC in use, so the other functions do not check which DAC it is
 *
 **********************************************************************************
  * Copyright Naresuan University, Phitsanulok Thailand
@@ -14,117 +19,210 @@
 #include "DAC.h"
 #include "globals.h"
 
+/***************************************
+* Forward function references
+***************************************/
+static void dac_vdac_set_value(uint16_t value);
+
+/* the VDAC functions take a uint8 so it needs a wrapper, the other APIs match */
+static const struct DacOps dac_ops_vdac = {
+    .start = VDAC_source_Start,
+    .stop = VDAC_source_Stop,
+    .sleep = VDAC_source_Sleep,
+    .wakeup = VDAC_source_Wakeup,
+    .set_value = dac_vdac_set_value,
+    .isr = dacInterruptVdac,
+    .ground_value = VIRTUAL_GROUND / 16,  // the VDAC is 16 mV per bit
+    .max_value = 255,
+    .mv_per_bit = 16,
+    .amux_channel = VDAC_channel
+};
+
+static const struct DacOps dac_ops_dvdac = {
+    .start = DVDAC_Start,
+    .stop = DVDAC_Stop,
+    .sleep = DVDAC_Sleep,
+    .wakeup = DVDAC_Wakeup,
+    .set_value = DVDAC_SetValue,
+    .isr = dacInterruptDvdac,
+    .ground_value = VIRTUAL_GROUND,  // VIRTUAL_GROUND / 1 mV
+    .max_value = 4095,
+    .mv_per_bit = 1,
+    .amux_channel = DVDAC_channel
+};
+
+#if DAC_CURRENT_DACS_ENABLED
+static const struct DacOps dac_ops_midac = {
+    .start = MIDAC_source_Start,
+    .stop = MIDAC_source_Stop,
+    .sleep = MIDAC_source_Sleep,
+    .wakeup = MIDAC_source_Wakeup,
+    .set_value = MIDAC_source_SetValue,
+    .isr = dacInterruptMidac,
+    .ground_value = VIRTUAL_GROUND / MIDAC_MV_PER_BIT,
+    .max_value = 4095,
+    .mv_per_bit = MIDAC_MV_PER_BIT,
+    .amux_channel = MIDAC_channel
+};
+
+static const struct DacOps dac_ops_pidac = {
+    .start = PIDAC_source_Start,
+    .stop = PIDAC_source_Stop,
+    .sleep = PIDAC_source_Sleep,
+    .wakeup = PIDAC_source_Wakeup,
+    .set_value = PIDAC_source_SetValue,
+    .isr = dacInterruptPidac,
+    .ground_value = VIRTUAL_GROUND / PIDAC_MV_PER_BIT,
+    .max_value = 2047,
+    .mv_per_bit = PIDAC_MV_PER_BIT,
+    .amux_channel = PIDAC_channel
+};
+#endif
+
+const struct DacOps *dac_ops = &dac_ops_vdac;  // the VDAC until DAC_Start checks the EEPROM
+
 /******************************************************************************
-* Function Name: DAC_Start
+* Function Name: DAC_GetOps
 *******************************************************************************
 *
 * Summary:
-*  Start the correct voltage source.  
-*  Figure what source is being used, set the  correct AMux settings and start 
-*  the correct source
+*  Get the table of functions for a voltage source
 *
 * Parameters:
+*  uint8_t voltage_source: VDAC_IS_VDAC, VDAC_IS_DVDAC, VDAC_IS_MIDAC or VDAC_IS_PIDAC,
+*                          anything else is the VDAC, the MIDAC and PIDAC too
+*                          if DAC_CURRENT_DACS_ENABLED is 0
 *
-*
-*  Global variables:
-*  selected_voltage_source:  voltage source that is set to run, 
-*      [VDAC_IS_VDAC or VDAC_IS_DVDAC]
+* Return:
+*  const struct DacOps*: functions of the DAC
 *
 *******************************************************************************/
 
-void DAC_Start(void) {
-    selected_voltage_source = helper_check_voltage_source();  // check which DAC is being used
-    
-    if (selected_voltage_source == VDAC_IS_DVDAC) {
-        DVDAC_Start();
-        dac_ground_value = VIRTUAL_GROUND;  //VIRTUAL_GROUND / 1 mV the value of the DAC that will make 0 V across the working and aux electrodes 
-        AMux_V_source_Select(DVDAC_channel);
-    }
-    else {
-        VDAC_source_Start();
-        dac_ground_value = VIRTUAL_GROUND / 16;  // value of dac to make 0 V across working and aux electrodes
-        AMux_V_source_Select(VDAC_channel);
+const struct DacOps* DAC_GetOps(uint8_t voltage_source) {
+    switch (voltage_source) {
+        case VDAC_IS_DVDAC:
+            return &dac_ops_dvdac;
+#if DAC_CURRENT_DACS_ENABLED
+        case VDAC_IS_MIDAC:
+            return &dac_ops_midac;
+        case VDAC_IS_PIDAC:
+            return &dac_ops_pidac;
+#endif
+        default:
+            return &dac_ops_vdac;
     }
 }
 
 /******************************************************************************
-* Function Name: DAC_Sleep
+* Function Name: DAC_mV_to_value
 *******************************************************************************
 *
 * Summary:
-*  Put to sleep the correct voltage source
+*  Convert a potential between the working and aux electrodes into the value of
+*  the DAC picked by DAC_Start, rounded to the nearest bit and limited to the
+*  range of the DAC
 *
 * Parameters:
+*  int16_t mV: potential in millivolts
 *
-*
-* Global variables:
-*  selected_voltage_source:  voltage source that is set to run, 
-*      [VDAC_IS_VDAC or VDAC_IS_DVDAC]
+* Return:
+*  uint16_t: value to put in the DAC
 *
 *******************************************************************************/
 
-void DAC_Sleep(void) {
-    if (selected_voltage_source == VDAC_IS_DVDAC) {
-        DVDAC_Sleep();
+uint16_t DAC_mV_to_value(int16_t mV) {
+    int32_t half_bit = dac_ops->mv_per_bit / 2;
+    int32_t bits;
+    if (mV >= 0) {
+        bits = (mV + half_bit) / dac_ops->mv_per_bit;
     }
     else {
-        VDAC_source_Sleep();
+        bits = -((-mV + half_bit) / dac_ops->mv_per_bit);
+    }
+    int32_t value = dac_ops->ground_value + bits;
+    if (value < 0) {
+        return 0;
     }
+    if (value > dac_ops->max_value) {
+        return dac_ops->max_value;
+    }
+    return value;
 }
 
-
 /******************************************************************************
-* Function Name: DAC_Wakeup
+* Function Name: DAC_Start
 *******************************************************************************
 *
 * Summary:
-*  Wake up the correct voltage source
+*  Start the correct voltage source.  
+*  Figure what source is being used, set the  correct AMux settings and start 
+*  the correct source.  The source picked here is used by the other DAC
+*  functions and its isr is put in the DAC interrupt vector until DAC_Start
+*  is called again
 *
 * Parameters:
 *
 *
-* Global variables:
+*  Global variables:
 *  selected_voltage_source:  voltage source that is set to run, 
-*      [VDAC_IS_VDAC or VDAC_IS_DVDAC]
+*      [VDAC_IS_VDAC, VDAC_IS_DVDAC, VDAC_IS_MIDAC or VDAC_IS_PIDAC]
+*  dac_ops: set to the functions of the voltage source
 *
 *******************************************************************************/
 
-void DAC_Wakeup(void) {
-    if (selected_voltage_source == VDAC_IS_DVDAC) {
-        DVDAC_Wakeup();
-    }
-    else {
-        VDAC_source_Wakeup();
-    }
+void DAC_Start(void) {
+    selected_voltage_source = helper_check_voltage_source();  // check which DAC is being used
+    dac_ops = DAC_GetOps(selected_voltage_source);
+    
+    dac_ops->start();
+    dac_ground_value = dac_ops->ground_value;
+    AMux_V_source_Select(dac_ops->amux_channel);
+    isr_dac_SetVector(dac_ops->isr);
 }
 
+/******************************************************************************
+* Function Name: DAC_Stop
+*******************************************************************************
+*
+* Summary:
+*  Turn off the voltage source picked by DAC_Start, before another one is selected
+*
+*******************************************************************************/
+
+void DAC_Stop(void) {
+    dac_ops->stop();
+}
 
 /******************************************************************************
-* Function Name: DAC_SetValue
+* Function Name: DAC_Sleep
 *******************************************************************************
 *
 * Summary:
-*  Set the value of the correct voltage source
+*  Put to sleep the voltage source picked by DAC_Start
 *
-* Parameters:
-*  uint16_t value: number to place in the appropriate DAC
+*******************************************************************************/
+
+void DAC_Sleep(void) {
+    dac_ops->sleep();
+}
+
+
+/******************************************************************************
+* Function Name: DAC_Wakeup
+*******************************************************************************
 *
-* Global variables:
-*  selected_voltage_source:  voltage source that is set to run, 
-*      [VDAC_IS_VDAC or VDAC_IS_DVDAC]
+* Summary:
+*  Wake up the voltage source picked by DAC_Start
 *
 *******************************************************************************/
 
-void DAC_SetValue(uint16_t value) {
-    
-    if (selected_voltage_source == VDAC_IS_DVDAC) {
-        DVDAC_SetValue(value);
-    }
-    else {
-        VDAC_source_SetValue(value);
-    }
+void DAC_Wakeup(void) {
+    dac_ops->wakeup();
 }
 
+static void dac_vdac_set_value(uint16_t value) {
+    VDAC_source_SetValue(value);
+}
 
 
 /* [] END OF FILE */
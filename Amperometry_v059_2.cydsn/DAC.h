@@ -3,7 +3,9 @@
 *
 * Description:
 *  This file contains the function prototypes and constants used for
-*  the custom DAC, an 8-bit VDAC or DVDAC selectable by the user
+*  the custom DAC, an 8-bit VDAC, DVDAC, MIDAC or PIDAC selectable by the user.  The DAC in use
+*  is picked once by DAC_Start through a table of its functions, so setting the
+*  value in the isrs does not have to check which DAC is used each time
 *
 **********************************************************************************
  * Copyright Naresuan University, Phitsanulok Thailand
@@ -24,7 +26,49 @@
     
 #define DVDAC_channel 1
 #define VDAC_channel 0
+#define MIDAC_channel 2
+#define PIDAC_channel 3
     
+/* The MIDAC (12-bit) and PIDAC (11-bit) are current DACs, their load resistors
+ * are picked so the full scale is 4.096 V like the DVDAC.  These are the
+ * scales of the host emulator, a board with the components has to match them
+ * to the IDAC range and load resistor it is built with */
+#define MIDAC_MV_PER_BIT 1
+#define PIDAC_MV_PER_BIT 2
+
+/* The MIDAC and PIDAC need the MIDAC_source and PIDAC_source components on
+ * AMux_V_source channels 2 and 3, they are not in the TopDesign yet so the
+ * device refuses voltage sources 3 and 4.  Set to 1 when they are added, only
+ * the host emulator and benchmark have them now */
+#if !defined(DAC_CURRENT_DACS_ENABLED)
+#define DAC_CURRENT_DACS_ENABLED 0
+#endif
+
+// highest voltage source the firmware was built with, others are set to the VDAC
+#if DAC_CURRENT_DACS_ENABLED
+#define DAC_LAST_VOLTAGE_SOURCE VDAC_IS_PIDAC
+#else
+#define DAC_LAST_VOLTAGE_SOURCE VDAC_IS_DVDAC
+#endif
+    
+    
+/***************************************
+*        Structs
+***************************************/
+
+/* Functions of one DAC backend, add a table in DAC.c for a new DAC */
+struct DacOps {
+    void (*start)(void);
+    void (*stop)(void);
+    void (*sleep)(void);
+    void (*wakeup)(void);
+    void (*set_value)(uint16_t value);
+    void (*isr)(void);  // DAC isr that calls this DAC directly, see main.c
+    uint16_t ground_value;  // value of the DAC that makes 0 V across the working and aux electrodes
+    uint16_t max_value;
+    uint8_t mv_per_bit;
+    uint8_t amux_channel;  // AMux_V_source channel the DAC is on
+};
     
 /***************************************
 *        Variables
@@ -32,6 +76,7 @@
     
 uint8_t selected_voltage_source;
 extern uint16_t dac_ground_value;
+extern const struct DacOps *dac_ops;  // DAC in use, set by DAC_Start
     
     
 /***************************************
@@ -39,9 +84,35 @@ extern uint16_t dac_ground_value;
 ***************************************/ 
     
 void DAC_Start(void);
+// a DAC isr for each DAC, in main.c
+void dacInterruptVdac(void);
+void dacInterruptDvdac(void);
+#if DAC_CURRENT_DACS_ENABLED
+void dacInterruptMidac(void);
+void dacInterruptPidac(void);
+#endif
+void DAC_Stop(void);
 void DAC_Sleep(void);
 void DAC_Wakeup(void);
-void DAC_SetValue(uint16_t value);
+const struct DacOps* DAC_GetOps(uint8_t voltage_source);
+uint16_t DAC_mV_to_value(int16_t mV);
+
+/******************************************************************************
+* Function Name: DAC_SetValue
+*******************************************************************************
+*
+* Summary:
+*  Set the value of the DAC picked by DAC_Start, inline so it calls the DAC
+*  straight from the table.  The DAC isrs call their DAC directly instead
+*
+* Parameters:
+*  uint16_t value: number to place in the DAC
+*
+*******************************************************************************/
+
+static inline void DAC_SetValue(uint16_t value) {
+    dac_ops->set_value(value);
+}
     
 #endif
 /* [] END OF FILE */
@@ -0,0 +1,99 @@
+/*******************************************************************************
+* File Name: arena.c
+*
+* Description:
+*  One static block of SRAM that is split at run time between the waveform
+*  look up table and the ADC buffers.  A slow cyclic voltammetry can use a few
+*  long buffers, fast amperometry many short buffers, and a long differential
+*  pulse voltammetry a large look up table, instead of always paying for the
+*  largest of each
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "arena.h"
+
+static uint16_t arena[ARENA_SIZE_WORDS];
+
+uint16_t *waveform_lut = arena;
+uint16_t arena_lut_size = MAX_LUT_SIZE;
+int16_t *adc_buffers[ARENA_MAX_ADC_BUFFERS];
+uint8_t arena_adc_buffer_count = 0;  // no adc buffers until arena_partition is called
+uint16_t arena_adc_buffer_size = 0;
+
+/******************************************************************************
+* Function Name: arena_partition
+*******************************************************************************
+*
+* Summary:
+*  Split the arena into a look up table and equal sized ADC buffers.  Do not call
+*  this while the isrs are running as they use the buffer pointers directly
+*
+* Parameters:
+*  uint16_t lut_size: most entries the look up table can have
+*  uint8_t buffer_count: number of ADC buffers, 1 to ARENA_MAX_ADC_BUFFERS
+*  uint16_t buffer_size: samples in each ADC buffer
+*
+* Return:
+*  true (1) if the arena was partitioned, false (0) if the sizes do not fit and
+*  the arena was not changed
+*
+*******************************************************************************/
+
+uint8_t arena_partition(uint16_t lut_size, uint8_t buffer_count, uint16_t buffer_size) {
+    if ((lut_size == 0) || (buffer_count == 0) || (buffer_count > ARENA_MAX_ADC_BUFFERS) ||
+        (buffer_size == 0)) {
+        return false;
+    }
+    // check with 32 bits so large sizes can not wrap around the check
+    uint32_t words_needed = (uint32_t)lut_size + ARENA_LUT_PAD +
+                            (uint32_t)buffer_count * (buffer_size + ARENA_ADC_MARKER_PAD);
+    if (words_needed > ARENA_SIZE_WORDS) {
+        return false;
+    }
+    arena_lut_size = lut_size;
+    uint16_t *next_buffer = &arena[lut_size + ARENA_LUT_PAD];
+    for (uint8_t i = 0; i < ARENA_MAX_ADC_BUFFERS; i++) {
+        if (i < buffer_count) {
+            adc_buffers[i] = (int16_t*)next_buffer;
+            next_buffer += buffer_size + ARENA_ADC_MARKER_PAD;
+        }
+        else {
+            adc_buffers[i] = 0;
+        }
+    }
+    arena_adc_buffer_count = buffer_count;
+    arena_adc_buffer_size = buffer_size;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: arena_adc_range
+*******************************************************************************
+*
+* Summary:
+*  Bounds checked access to part of an ADC buffer, the end of data marker can
+*  be included in the range
+*
+* Parameters:
+*  uint8_t channel: which ADC buffer
+*  uint16_t offset: first sample of the range
+*  uint16_t count: number of samples in the range
+*
+* Return:
+*  int16_t*: pointer to the first sample, or 0 (NULL) if the range is not
+*  inside the buffer
+*
+*******************************************************************************/
+
+int16_t* arena_adc_range(uint8_t channel, uint16_t offset, uint16_t count) {
+    if ((channel >= arena_adc_buffer_count) ||
+        ((uint32_t)offset + count > (uint32_t)arena_adc_buffer_size + ARENA_ADC_MARKER_PAD)) {
+        return 0;
+    }
+    return &adc_buffers[channel][offset];
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,57 @@
+/*******************************************************************************
+* File Name: arena.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to split
+*  one static block of SRAM between the waveform look up table and the ADC buffers
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(ARENA_H)
+#define ARENA_H
+
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+// add 5 to the lut to add a buffer cause a few functions go over the end
+// of the look up table by 1, and will use arena_lut_size to check for over runs
+#define ARENA_LUT_PAD                   5
+// each ADC buffer has 1 extra place for the 0xC000 end of data marker
+#define ARENA_ADC_MARKER_PAD            1
+#define ARENA_MAX_ADC_BUFFERS           16
+// same amount of SRAM as the fixed look up table and ADC arrays used before,
+// the default partition is that same layout
+#define ARENA_SIZE_WORDS                (MAX_LUT_SIZE + ARENA_LUT_PAD + ADC_CHANNELS*(MAX_LUT_SIZE + ARENA_ADC_MARKER_PAD))
+
+/**************************************
+*      Global variables
+**************************************/
+
+/* The look up table is always at the start of the arena so it is kept when the
+ * arena is partitioned again with the same or a larger look up table.  The isrs
+ * use these pointers directly, use the functions below to check the bounds
+ * of anything the user sends */
+extern uint16_t *waveform_lut;  // look up table to store waveform for variable potential experiments
+extern uint16_t arena_lut_size;  // most entries the look up table can have
+extern int16_t *adc_buffers[ARENA_MAX_ADC_BUFFERS];  // where to put the adc measurements
+extern uint8_t arena_adc_buffer_count;
+extern uint16_t arena_adc_buffer_size;  // most samples in each adc buffer, not counting the marker
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8_t arena_partition(uint16_t lut_size, uint8_t buffer_count, uint16_t buffer_size);
+int16_t* arena_adc_range(uint8_t channel, uint16_t offset, uint16_t count);
+
+#endif
+/* [] END OF FILE */
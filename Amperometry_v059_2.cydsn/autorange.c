@@ -0,0 +1,279 @@
+/*******************************************************************************
+* File Name: autorange.c
+*
+* Description:
+*  Automatic current ranging.  When it is enabled the ADC isrs pass each reading
+*  to autorange_sample, which lowers the gain when the readings get close to the
+*  ADC full scale and raises it when they stay down in the noise.  Each change
+*  is saved in a log with the sample it starts at so the host can rescale the
+*  data, the TIA resistor and ADC buffer gain selected with 'A' are put back at
+*  the end of the run.  The 'O' pA format and the peak currents convert every
+*  sample with the range selected with 'A' so they can not be used with it
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "autorange.h"
+#include "arena.h"
+#include "calibrate.h"
+#include "data_export.h"
+#include "telemetry.h"
+#include "usb_protocols.h"
+
+extern uint8_t adc_recording_channel;
+
+static struct AutorangeLog autorange_log = {.count = 0};
+static uint8_t resistor_index;  // range in use during the run
+static uint8_t buffer_index;
+static uint8_t low_count;  // readings in a row that could use a higher gain
+static uint8_t settle_count;
+static int32_t high_counts = AUTORANGE_HIGH_COUNTS;  // limits for the ADC resolution of the run
+static int32_t target_counts = AUTORANGE_TARGET_COUNTS;
+static uint8_t ranging = false;  // the run in progress changes the range, 'a' only changes the next runs
+static uint16_t samples_per_buffer;  // readings in each ADC buffer, 0 for a voltammetry run
+
+/***************************************
+* Forward function references
+***************************************/
+static uint32_t autorange_gain(uint8_t resistor, uint8_t buffer);
+static void autorange_set(uint8_t resistor, uint8_t buffer, uint8_t adc_buffer, uint16_t sample_index);
+
+/******************************************************************************
+* Function Name: autorange_enable
+*******************************************************************************
+*
+* Summary:
+*  Turn the automatic ranging on or off for the next runs.  main refuses to
+*  turn it on while the 'O' pA format or the peak detection is selected, they
+*  would report the currents with the wrong range
+*
+* Parameters:
+*  uint8_t enable: true (1) to change the range during runs, false (0) to keep
+*                  the range selected with the 'A' command
+*
+*******************************************************************************/
+
+void autorange_enable(uint8_t enable) {
+    autorange_log.enabled = (enable != 0);
+}
+
+/******************************************************************************
+* Function Name: autorange_enabled
+*******************************************************************************
+*
+* Summary:
+*  Check if the range can change during the runs
+*
+* Return:
+*  uint8_t: true (1) if the automatic ranging is on
+*
+*******************************************************************************/
+
+uint8_t autorange_enabled(void) {
+    return autorange_log.enabled;
+}
+
+/******************************************************************************
+* Function Name: autorange_start
+*******************************************************************************
+*
+* Summary:
+*  Clear the log and start the run at the range selected with the 'A' command.
+*  Call before the ADC isr is enabled
+*
+* Parameters:
+*  uint16_t buffer_size: readings in each amperometry buffer, a switch after the
+*                        last reading is logged at the start of the next buffer.
+*                        0 for a voltammetry run, it only uses 1 buffer
+*
+* Global variables:
+*  uint8 TIA_resistor_value_index, ADC_buffer_index: range selected by the user
+*  uint8 ADC_config_index: ADC configuration, its resolution scales the limits
+*  adc_recording_channel: ADC buffer the first samples are saved in
+*
+*******************************************************************************/
+
+void autorange_start(uint16_t buffer_size) {
+    ranging = autorange_log.enabled;
+    samples_per_buffer = buffer_size;
+    uint8_t shift = AUTORANGE_LIMIT_BITS - export_adc_resolution(ADC_config_index);
+    high_counts = AUTORANGE_HIGH_COUNTS >> shift;
+    target_counts = AUTORANGE_TARGET_COUNTS >> shift;
+    resistor_index = TIA_resistor_value_index;
+    buffer_index = ADC_buffer_index;
+    low_count = 0;
+    settle_count = 0;
+    autorange_log.count = 0;
+    autorange_log.dropped = 0;
+    autorange_set(resistor_index, buffer_index, adc_recording_channel, 0);
+}
+
+/******************************************************************************
+* Function Name: autorange_sample
+*******************************************************************************
+*
+* Summary:
+*  Check an ADC reading and change the range if needed, called by the ADC isrs.
+*  A new range is used from the next sample on
+*
+* Parameters:
+*  int16_t reading: ADC reading just saved
+*  uint8_t adc_buffer: ADC buffer the reading was saved in
+*  uint16_t sample_index: where in the ADC buffer the reading was saved
+*
+*******************************************************************************/
+
+void autorange_sample(int16_t reading, uint8_t adc_buffer, uint16_t sample_index) {
+    if (!ranging) {
+        return;
+    }
+    if (settle_count) {  // the reading was taken while the TIA was settling
+        settle_count--;
+        return;
+    }
+    int32_t magnitude = reading;
+    if (magnitude < 0) {
+        magnitude = -magnitude;
+    }
+    if (magnitude > high_counts) {  // lower the gain right away so the ADC does not saturate
+        low_count = 0;
+        if ((resistor_index == AUTORANGE_TOP_RESISTOR) && (buffer_index > 0)) {
+            autorange_set(resistor_index, buffer_index-1, adc_buffer, sample_index+1);
+        }
+        else if (resistor_index > 0) {
+            autorange_set(resistor_index-1, buffer_index, adc_buffer, sample_index+1);
+        }
+        else if (buffer_index > 0) {
+            autorange_set(resistor_index, buffer_index-1, adc_buffer, sample_index+1);
+        }
+        return;
+    }
+    uint8_t next_resistor = resistor_index;
+    uint8_t next_buffer = buffer_index;
+    if (resistor_index < AUTORANGE_TOP_RESISTOR) {
+        next_resistor++;
+    }
+    else if (buffer_index < AUTORANGE_TOP_BUFFER) {
+        next_buffer++;
+    }
+    else {
+        return;  // already at the highest gain
+    }
+    // would the reading still be below the target with the higher gain
+    if (magnitude * autorange_gain(next_resistor, next_buffer) <
+        target_counts * autorange_gain(resistor_index, buffer_index)) {
+        low_count++;
+    }
+    else {
+        low_count = 0;
+    }
+    if (low_count >= AUTORANGE_LOW_SAMPLES) {
+        low_count = 0;
+        autorange_set(next_resistor, next_buffer, adc_buffer, sample_index+1);
+    }
+}
+
+/******************************************************************************
+* Function Name: autorange_stop
+*******************************************************************************
+*
+* Summary:
+*  Put the range selected with the 'A' command back at the end of a run so the
+*  calibration and the next run use it, the log is kept for the host.  It is
+*  put back if the run was ranging even if 'a' turned the ranging off since
+*
+*******************************************************************************/
+
+void autorange_stop(void) {
+    if (!ranging) {
+        return;
+    }
+    ranging = false;
+    resistor_index = TIA_resistor_value_index;
+    buffer_index = ADC_buffer_index;
+    TIA_SetResFB(resistor_index);
+    ADC_SigDel_SetBufferGain(buffer_index);
+    autorange_log.gain_code = AUTORANGE_GAIN_CODE(resistor_index, buffer_index);
+}
+
+/******************************************************************************
+* Function Name: autorange_export_log
+*******************************************************************************
+*
+* Summary:
+*  Send the range changes saved since the log was last sent, AUTORANGE_EXPORT_SIZE
+*  bytes, and clear them.  Can be used during a run, the log is copied with the
+*  interrupts off so the ADC isrs do not change it while it is sent.  See
+*  struct AutorangeLog for the layout
+*
+*******************************************************************************/
+
+void autorange_export_log(void) {
+    struct AutorangeLog log;
+    uint8 interrupts = CyEnterCriticalSection();
+    log = autorange_log;
+    autorange_log.count = 0;
+    autorange_log.dropped = 0;
+    CyExitCriticalSection(interrupts);
+    USB_Export_Data((uint8_t*)&log, AUTORANGE_EXPORT_SIZE);
+}
+
+/******************************************************************************
+* Function Name: autorange_gain
+*******************************************************************************
+*
+* Summary:
+*  Current gain of a range, TIA resistor in kohms times the ADC buffer gain
+*
+*******************************************************************************/
+
+static uint32_t autorange_gain(uint8_t resistor, uint8_t buffer) {
+    return (uint32_t)calibrate_TIA_resistor_list[resistor] << buffer;
+}
+
+/******************************************************************************
+* Function Name: autorange_set
+*******************************************************************************
+*
+* Summary:
+*  Change the hardware to a range and save it in the log
+*
+* Parameters:
+*  uint8_t resistor: TIA resistor index, 0-7
+*  uint8_t buffer: ADC buffer gain index, 0-3
+*  uint8_t adc_buffer: ADC buffer of sample_index
+*  uint16_t sample_index: first sample that is measured with the range, can be
+*                         1 past the end of an amperometry buffer
+*
+*******************************************************************************/
+
+static void autorange_set(uint8_t resistor, uint8_t buffer, uint8_t adc_buffer, uint16_t sample_index) {
+    resistor_index = resistor;
+    buffer_index = buffer;
+    TIA_SetResFB(resistor);
+    ADC_SigDel_SetBufferGain(buffer);
+    settle_count = AUTORANGE_SETTLE_SAMPLES;
+    autorange_log.gain_code = AUTORANGE_GAIN_CODE(resistor, buffer);
+    if (autorange_log.count >= AUTORANGE_LOG_SIZE) {
+        if (autorange_log.dropped < 255) {
+            autorange_log.dropped++;
+        }
+        return;
+    }
+    uint32_t block = telemetry.buffers_filled + 1;  // the buffer is counted when it is full
+    if (samples_per_buffer && (sample_index >= samples_per_buffer)) {  // starts in the next buffer
+        sample_index = 0;
+        adc_buffer = (adc_buffer + 1) % arena_adc_buffer_count;
+        block++;
+    }
+    struct AutorangeEvent *event = &autorange_log.events[autorange_log.count];
+    event->block = block;
+    event->sample_index = sample_index;
+    event->adc_buffer = adc_buffer;
+    event->gain_code = autorange_log.gain_code;
+    autorange_log.count++;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,85 @@
+/*******************************************************************************
+* File Name: autorange.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to change the
+*  TIA resistor and ADC buffer gain during a run when the current gets close to
+*  the ADC full scale or down into the noise
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(AUTORANGE_H)
+#define AUTORANGE_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+/**************************************
+*      Constants
+**************************************/
+
+/* The range is lowered as soon as a reading is above AUTORANGE_HIGH_COUNTS, and
+ * raised only after AUTORANGE_LOW_SAMPLES readings in a row would be below
+ * AUTORANGE_TARGET_COUNTS with the higher gain.  The gap between the 2 keeps the
+ * range from switching back and forth.  The limits are for a 16-bit ADC, they
+ * are shifted down for the resolution of the ADC configuration in use */
+#define AUTORANGE_HIGH_COUNTS       30000  // about 92% of the ADC full scale
+#define AUTORANGE_TARGET_COUNTS     16000
+#define AUTORANGE_LIMIT_BITS        16  // resolution the limits are for
+#define AUTORANGE_LOW_SAMPLES       16
+#define AUTORANGE_SETTLE_SAMPLES    2  // readings ignored after a switch while the TIA settles
+
+#define AUTORANGE_TOP_RESISTOR      7
+#define AUTORANGE_TOP_BUFFER        3
+#define AUTORANGE_LOG_SIZE          32
+#define AUTORANGE_LOG_HEADER_SIZE   4
+#define AUTORANGE_EVENT_SIZE        8
+#define AUTORANGE_EXPORT_SIZE       (AUTORANGE_LOG_HEADER_SIZE + AUTORANGE_EVENT_SIZE*AUTORANGE_LOG_SIZE)  // bytes the 'w' command sends
+
+// gain code saved in the log, the same indexes as the 'A' command and the calibration table
+#define AUTORANGE_GAIN_CODE(resistor, buffer)   (((buffer) << 4) | (resistor))
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* A range change, the samples from sample_index on in the ADC buffer were
+ * measured with the gain code, until the next event.  Amperometry reuses the
+ * ADC buffers so block tells which fill of the buffer the change is in, it is
+ * the telemetry.buffers_filled count the buffer gets when it is full, the same
+ * as the block sent by the 'Z' statistics */
+struct AutorangeEvent {
+    uint32_t block;
+    uint16_t sample_index;
+    uint8_t adc_buffer;
+    uint8_t gain_code;
+};
+
+/* The log the host reads with the 'w' command, the first event is the range
+ * the run started with.  The events are cleared when they are sent so a host
+ * that reads the log after each amperometry block does not lose any */
+struct AutorangeLog {
+    uint8_t count;  // events saved
+    uint8_t dropped;  // events that did not fit in the log
+    uint8_t gain_code;  // range in use now
+    uint8_t enabled;
+    struct AutorangeEvent events[AUTORANGE_LOG_SIZE];
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void autorange_enable(uint8_t enable);
+uint8_t autorange_enabled(void);
+void autorange_start(uint16_t buffer_size);
+void autorange_sample(int16_t reading, uint8_t adc_buffer, uint16_t sample_index);
+void autorange_stop(void);
+void autorange_export_log(void);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,175 @@
+/*******************************************************************************
+* File Name: background.c
+*
+* Description:
+*  Save a blank voltammetry run and take it off the next runs.  The blank is
+*  saved in an ADC buffer the host picks while the blank runs, then a run with
+*  the same look up table has each blank reading taken off its reading in the
+*  ADC isr, so the data saved in ADC buffer 0 is already background subtracted.
+*  The readings line up because the isrs step through the look up table the
+*  same way every run
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "background.h"
+#include "arena.h"
+#include "helper_functions.h"
+#include "telemetry.h"
+
+static uint8_t background_mode = BACKGROUND_OFF;
+static struct BackgroundBlank blank = {0, 0, 0, 1, false};
+// checked by the isr every reading
+static uint8_t capturing = false;
+static uint8_t subtracting = false;
+
+/******************************************************************************
+* Function Name: background_set
+*******************************************************************************
+*
+* Summary:
+*  Choose to save the next run as the blank, take the blank off the next runs or
+*  turn it off.  Saving a new blank replaces the old one
+*
+* Parameters:
+*  uint8_t mode: BACKGROUND_OFF, BACKGROUND_CAPTURE or BACKGROUND_SUBTRACT
+*  uint8_t buffer: ADC buffer to save the blank in for BACKGROUND_CAPTURE, 1 to
+*                  the number of ADC buffers - 1 because runs are saved in buffer 0
+*
+* Return:
+*  uint8_t: true (1) if the mode was set, false (0) if the buffer does not exist
+*           or the mode is unknown
+*
+*******************************************************************************/
+
+uint8_t background_set(uint8_t mode, uint8_t buffer) {
+    if (mode > BACKGROUND_SUBTRACT) {
+        return false;
+    }
+    if (mode == BACKGROUND_CAPTURE) {
+        if ((buffer == 0) || (buffer >= arena_adc_buffer_count)) {
+            return false;
+        }
+        background_clear();
+        blank.buffer = buffer;
+    }
+    background_mode = mode;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: background_start
+*******************************************************************************
+*
+* Summary:
+*  Set up the isr for a voltammetry run, called before the isrs are enabled.
+*  The blank is only taken off if it was saved with the same look up table and
+*  its buffer was not moved by the arena since
+*
+* Parameters:
+*  const uint16_t lut[]: look up table of the run
+*  uint16_t lut_length: number of look up table entries that will be run
+*
+*******************************************************************************/
+
+void background_start(const uint16_t lut[], uint16_t lut_length) {
+    capturing = false;
+    subtracting = false;
+    telemetry.background &= ~BACKGROUND_SUBTRACTED;
+    if (background_mode == BACKGROUND_OFF) {
+        return;
+    }
+    int16_t *samples = arena_adc_range(blank.buffer, 0, lut_length+1);
+    uint16_t lut_crc = helper_crc16((const uint8_t*)lut, 2*lut_length);
+    if (background_mode == BACKGROUND_CAPTURE) {
+        if (samples) {
+            background_clear();
+            blank.samples = samples;
+            blank.lut_length = lut_length;
+            blank.lut_crc = lut_crc;
+            capturing = true;
+        }
+    }
+    else if (blank.saved && (samples == blank.samples) && (lut_length == blank.lut_length) &&
+             (lut_crc == blank.lut_crc)) {
+        subtracting = true;
+        telemetry.background |= BACKGROUND_SUBTRACTED;
+    }
+}
+
+/******************************************************************************
+* Function Name: background_sample
+*******************************************************************************
+*
+* Summary:
+*  Save an ADC reading in the blank or take the blank off it, called by the
+*  voltammetry ADC isr.  The difference is limited to the int16_t range
+*
+* Parameters:
+*  int16_t reading: ADC reading
+*  uint16_t sample_index: where in the ADC buffer the reading goes
+*
+* Return:
+*  int16_t: reading to save in ADC buffer 0
+*
+*******************************************************************************/
+
+int16_t background_sample(int16_t reading, uint16_t sample_index) {
+    if (capturing) {
+        blank.samples[sample_index] = reading;
+    }
+    else if (subtracting) {
+        int32_t difference = (int32_t)reading - blank.samples[sample_index];
+        if (difference > INT16_MAX) {
+            difference = INT16_MAX;
+        }
+        else if (difference < INT16_MIN) {
+            difference = INT16_MIN;
+        }
+        return (int16_t)difference;
+    }
+    return reading;
+}
+
+/******************************************************************************
+* Function Name: background_run_done
+*******************************************************************************
+*
+* Summary:
+*  Finish the blank when the run that saved it is done, called by the DAC isr.
+*  Only 1 run is saved as the blank, the mode is turned off after it
+*
+*******************************************************************************/
+
+void background_run_done(void) {
+    if (capturing) {
+        blank.saved = true;
+        background_mode = BACKGROUND_OFF;
+        telemetry.background |= BACKGROUND_BLANK_SAVED;
+    }
+    capturing = false;
+    subtracting = false;
+}
+
+/******************************************************************************
+* Function Name: background_clear
+*******************************************************************************
+*
+* Summary:
+*  Forget the blank, called when its ADC buffer is used for something else
+*  such as an amperometry run or the arena is partitioned again
+*
+*******************************************************************************/
+
+void background_clear(void) {
+    uint8 interrupts = CyEnterCriticalSection();
+    blank.saved = false;
+    capturing = false;
+    subtracting = false;
+    telemetry.background &= ~BACKGROUND_BLANK_SAVED;
+    CyExitCriticalSection(interrupts);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,61 @@
+/*******************************************************************************
+* File Name: background.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to save a
+*  blank (background) voltammetry run in an ADC buffer and take it off the
+*  readings of the next runs with the same look up table in the ADC isr
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(BACKGROUND_H)
+#define BACKGROUND_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define BACKGROUND_OFF              0  // the readings are saved as they are
+#define BACKGROUND_CAPTURE          1  // the next run is saved as the blank
+#define BACKGROUND_SUBTRACT         2  // the blank is taken off the readings of the next runs
+
+// bits of telemetry.background
+#define BACKGROUND_BLANK_SAVED      0x01  // a blank is saved and its buffer has not been used since
+#define BACKGROUND_SUBTRACTED       0x02  // the blank was taken off the last run
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* The blank saved in an ADC buffer.  A run only has the blank taken off if it
+ * has the same look up table, checked with its length and CRC16, so the
+ * readings line up sample for sample */
+struct BackgroundBlank {
+    int16_t *samples;  // ADC buffer the blank is in
+    uint16_t lut_length;
+    uint16_t lut_crc;
+    uint8_t buffer;  // which ADC buffer
+    uint8_t saved;  // true (1) when the blank is complete
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8_t background_set(uint8_t mode, uint8_t buffer);
+void background_start(const uint16_t lut[], uint16_t lut_length);
+int16_t background_sample(int16_t reading, uint16_t sample_index);
+void background_run_done(void);
+void background_clear(void);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,207 @@
+/*******************************************************************************
+* File Name: block_stats.c
+*
+* Description:
+*  Send the mean, standard deviation, min, max and slope of each amperometry
+*  buffer instead of the readings.  The adcAmp isr only marks which buffers are
+*  full, the statistics are made in the main loop with integer math and sent
+*  in 32 bytes.  The readings stay in the buffer for the 'F' command until the
+*  buffer is filled again
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "block_stats.h"
+#include "arena.h"
+#include "telemetry.h"
+#include "usb_protocols.h"
+
+static uint8_t stats_enabled = false;
+static volatile uint16_t pending = 0;  // bit for each buffer filled and waiting for its statistics
+static uint32_t pending_block[ARENA_MAX_ADC_BUFFERS];  // block number of each pending buffer
+
+/***************************************
+*        Forward function references
+***************************************/
+static uint32_t block_stats_isqrt(uint64_t value);
+
+/******************************************************************************
+* Function Name: block_stats_set
+*******************************************************************************
+*
+* Summary:
+*  Choose if the statistics are sent instead of "DoneX" when an amperometry
+*  buffer is full
+*
+* Parameters:
+*  uint8_t enabled: true (1) to send the statistics, false (0) for "DoneX"
+*
+*******************************************************************************/
+
+void block_stats_set(uint8_t enabled) {
+    uint8 interrupts = CyEnterCriticalSection();
+    stats_enabled = enabled;
+    pending = 0;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: block_stats_block_filled
+*******************************************************************************
+*
+* Summary:
+*  Mark a full amperometry buffer to have its statistics sent by the main loop,
+*  called by the adcAmp isr
+*
+* Parameters:
+*  uint8_t adc_buffer: buffer that was filled
+*
+* Return:
+*  uint8_t: true (1) if the statistics will be sent, false (0) if the mode is
+*           off and the isr should send "DoneX"
+*
+*******************************************************************************/
+
+uint8_t block_stats_block_filled(uint8_t adc_buffer) {
+    if (!stats_enabled) {
+        return false;
+    }
+    pending |= 1 << adc_buffer;
+    pending_block[adc_buffer] = telemetry.buffers_filled;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: block_stats_service
+*******************************************************************************
+*
+* Summary:
+*  Make and send the statistics of the buffers that were filled, called by the
+*  main loop.  The buffer is counted as exported for the telemetry overruns
+*
+* Parameters:
+*  uint16_t count: readings in each amperometry buffer
+*
+*******************************************************************************/
+
+void block_stats_service(uint16_t count) {
+    for (uint8_t i = 0; (i < arena_adc_buffer_count) && pending; i++) {
+        uint16_t bit = 1 << i;
+        if (!(pending & bit)) {
+            continue;
+        }
+        struct BlockStats stats;
+        uint8 interrupts = CyEnterCriticalSection();
+        pending &= ~bit;
+        stats.block = pending_block[i];
+        CyExitCriticalSection(interrupts);
+        block_stats_compute(adc_buffers[i], count, &stats);
+        stats.adc_buffer = i;
+        stats.time_ms = telemetry_uptime_ms();
+        USB_Export_Data((uint8_t*)&stats, BLOCK_STATS_SIZE);
+        telemetry_buffer_exported(i);
+    }
+}
+
+/******************************************************************************
+* Function Name: block_stats_compute
+*******************************************************************************
+*
+* Summary:
+*  Make the statistics of a block of readings.  The sums fit in 64 bits for
+*  blocks up to 32768 readings.  The slope is fitted against the sample index
+*  centered on the middle of the block, with the weights 2*i - (count-1) so
+*  they stay integers
+*
+* Parameters:
+*  const int16_t samples[]: readings of the block
+*  uint16_t count: number of readings
+*  struct BlockStats *stats: where to put the statistics, block, adc_buffer and
+*                            time_ms are left for the caller
+*
+*******************************************************************************/
+
+void block_stats_compute(const int16_t samples[], uint16_t count, struct BlockStats *stats) {
+    stats->version = BLOCK_STATS_VERSION;
+    stats->count = count;
+    stats->mean_q16 = 0;
+    stats->std_q16 = 0;
+    stats->min = 0;
+    stats->max = 0;
+    stats->slope_q16 = 0;
+    stats->reserved = 0;
+    if (count == 0) {
+        return;
+    }
+    int64_t sum = 0;
+    uint64_t sum_squares = 0;
+    int64_t weighted_sum = 0;
+    int16_t min = samples[0];
+    int16_t max = samples[0];
+    for (uint16_t i = 0; i < count; i++) {
+        int32_t x = samples[i];
+        sum += x;
+        sum_squares += (uint64_t)(x * x);
+        weighted_sum += (int64_t)(2*(int32_t)i - (count - 1)) * x;
+        if (x < min) {
+            min = x;
+        }
+        if (x > max) {
+            max = x;
+        }
+    }
+    stats->min = min;
+    stats->max = max;
+    // round the mean to the nearest 1/65536 count
+    int64_t sum_q16 = sum * 65536;
+    stats->mean_q16 = (int32_t)((sum_q16 >= 0) ? (sum_q16 + count/2) / count : -((-sum_q16 + count/2) / count));
+    // count^2 * variance = count * sum of squares - sum^2, then divided by count in 2 steps to
+    // stay in 64 bits, the remainder of the first division is kept so short blocks stay accurate
+    uint64_t spread = count * sum_squares - (uint64_t)(sum * sum);
+    uint64_t variance_q16 = (((spread / count) << 16) + ((spread % count) << 16) / count) / count;
+    stats->std_q16 = block_stats_isqrt(variance_q16 << 16);
+    // sum of the squared weights is count * (count^2 - 1) / 3
+    int64_t weights = (int64_t)count * ((int64_t)count * count - 1) / 3;
+    if (weights) {
+        int64_t slope_q16 = (2 * weighted_sum * 65536) / weights;
+        if (slope_q16 > INT32_MAX) {
+            slope_q16 = INT32_MAX;
+        }
+        else if (slope_q16 < INT32_MIN) {
+            slope_q16 = INT32_MIN;
+        }
+        stats->slope_q16 = (int32_t)slope_q16;
+    }
+}
+
+/******************************************************************************
+* Function Name: block_stats_isqrt
+*******************************************************************************
+*
+* Summary:
+*  Integer square root, rounded down, 1 bit of the result at a time
+*
+*******************************************************************************/
+
+static uint32_t block_stats_isqrt(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)result;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,61 @@
+/*******************************************************************************
+* File Name: block_stats.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to send the
+*  statistics of each amperometry buffer instead of the readings, for long runs
+*  where the host only keeps a summary of each block
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(BLOCK_STATS_H)
+#define BLOCK_STATS_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define BLOCK_STATS_VERSION         1
+#define BLOCK_STATS_SIZE            32  // bytes of struct BlockStats sent to the host
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* Statistics of a filled amperometry buffer, in ADC counts and samples.  The
+ * fields are on their natural alignment so the struct is the 32 bytes sent to
+ * the host, little endian */
+struct BlockStats {
+    uint8_t version;  // BLOCK_STATS_VERSION
+    uint8_t adc_buffer;  // buffer the readings are in, they can still be read with 'F'
+    uint16_t count;  // readings in the block
+    uint32_t block;  // number of the block in the run, telemetry.buffers_filled
+    int32_t mean_q16;  // Q16.16
+    uint32_t std_q16;  // population standard deviation, Q16.16
+    int16_t min;
+    int16_t max;
+    int32_t slope_q16;  // least squares slope in counts per sample, Q16.16
+    uint32_t time_ms;  // uptime when the statistics were made
+    uint32_t reserved;
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void block_stats_set(uint8_t enabled);
+uint8_t block_stats_block_filled(uint8_t adc_buffer);
+void block_stats_service(uint16_t count);
+void block_stats_compute(const int16_t samples[], uint16_t count, struct BlockStats *stats);
+
+#endif
+/* [] END OF FILE */
@@ -10,23 +10,35 @@
 *********************************************************************************/
 
 #include <project.h>
-#include "math.h"
 #include <stdio.h>
 #include "stdlib.h"
 
 #include "calibrate.h"
+#include "data_export.h"
+#include "helper_functions.h"
+#include "power.h"
+#include "telemetry.h"
 #include "usb_protocols.h"
 
 //extern char LCD_str[];  // for debug
 const uint16_t calibrate_TIA_resistor_list[] = {20, 30, 40, 80, 120, 250, 500, 1000}; 
 uint16_t static ADC_value;
+uint8_t ADC_config_index = 2;  // main starts the ADC with configuration 2
+static struct CalibrateSettling settling = {SETTLE_TOLERANCE, SETTLE_STABLE_COUNT,
+                                            SETTLE_AVERAGE_COUNT, SETTLE_TIMEOUT_MS};
+// conversion of each calibration table entry, loaded from the EEPROM once by calibrate_load_table
+static struct CalibrateConversion conversions[CAL_TABLE_ENTRIES];
 
 /***************************************
 * Forward function references
 ***************************************/
 static void Calibrate_Hardware_Wakeup(void);
+static void calibrate_points(void);
+static int16_t calibrate_full_scale_IDAC(void);
 static void calibrate_step(uint16_t IDAC_value, uint8 IDAC_index);
+static int16_t calibrate_read_settled(void);
 static void Calibrate_Hardware_Sleep(void);
+static void calibrate_set_conversion(uint8_t entry_index, const uint8_t entry[]);
 
 /******************************************************************************
 * Function Name: calibrate_TIA
@@ -52,36 +64,476 @@ void calibrate_TIA(void) {
     IDAC_calibrate_SetValue(0);
     // start the hardware required
     Calibrate_Hardware_Wakeup();
-    CyDelay(100);
-    // decide what currents to use based on TIA resistor and ADC buffer settings
-    uint16_t resistor_value = calibrate_TIA_resistor_list[TIA_resistor_value_index];
-    uint var = 2;
+    ADC_SigDel_StartConvert();
+    calibrate_points();
+    Calibrate_Hardware_Sleep();
+    calibrate_save_entry();  // so the next session can read the table instead of calibrating
+    calibrate_update_conversion();
+    
+    USB_Export_Data(calibrate_array.usb, 20);
+}
+
+/******************************************************************************
+* Function Name: calibrate_sweep
+*******************************************************************************
+*
+* Summary:
+*  Calibrate every TIA resistor with every ADC buffer gain of the ADC configuration
+*  in use with the hardware kept awake the whole time.  Each calibration is saved
+*  in the EEPROM table and the results are sent in one transfer, the settings in
+*  use before the sweep are put back afterwards
+*
+* Global variables:
+*  uint8 TIA_resistor_value_index, ADC_buffer_index: changed during the sweep and restored
+*
+* Return:
+*  CAL_SWEEP_SIZE bytes are loaded into the USB IN ENDPOINT, the 20 bytes the 'B'
+*  command sends for each setting in the order of calibrate_table_index,
+*  i.e. ADC buffer gain*CAL_TIA_RESISTORS + TIA resistor
+*
+*******************************************************************************/
+
+void calibrate_sweep(void) {
+    uint8_t saved_resistor_index = TIA_resistor_value_index;
+    uint8_t saved_buffer_index = ADC_buffer_index;
+    uint8_t results[CAL_SWEEP_SIZE];
+    
+    IDAC_calibrate_Start();
+    IDAC_calibrate_SetValue(0);
+    Calibrate_Hardware_Wakeup();
+    ADC_SigDel_StartConvert();
+    for (uint8_t buffer_index = 0; buffer_index < CAL_ADC_GAINS; buffer_index++) {
+        ADC_buffer_index = buffer_index;
+        ADC_SigDel_SetBufferGain(buffer_index);
+        for (uint8_t resistor_index = 0; resistor_index < CAL_TIA_RESISTORS; resistor_index++) {
+            TIA_resistor_value_index = resistor_index;
+            TIA_SetResFB(resistor_index);
+            calibrate_points();
+            calibrate_save_entry();
+            uint16_t result_index = (buffer_index*CAL_TIA_RESISTORS + resistor_index)*CAL_DATA_SIZE;
+            for (uint8_t i = 0; i < CAL_DATA_SIZE; i++) {
+                results[result_index+i] = calibrate_array.usb[i];
+            }
+        }
+    }
+    Calibrate_Hardware_Sleep();
+    // put the settings the user selected back
+    TIA_resistor_value_index = saved_resistor_index;
+    TIA_SetResFB(saved_resistor_index);
+    ADC_buffer_index = saved_buffer_index;
+    ADC_SigDel_SetBufferGain(saved_buffer_index);
+    calibrate_update_conversion();
+    
+    USB_Export_Data(results, CAL_SWEEP_SIZE);
+}
+
+/******************************************************************************
+* Function Name: calibrate_points
+*******************************************************************************
+*
+* Summary:
+*  Measure the calibration points for the TIA resistor and ADC buffer gain in
+*  use, the hardware has to be awake and the ADC converting
+*
+* Global variables:
+*  uint8 TIA_resistor_value_index: index of whick TIA resistor to use
+*  uint8 ADC_buffer_index: which ADC buffer is used, gain = 2**ADC_buffer_index
+*  calibrate_array: the IDAC values and ADC readings are saved here
+*
+*******************************************************************************/
+
+static void calibrate_points(void) {
     uint16_t IDAC_setting = 0;
-    uint8 ADC_buffer_value = pow(var, ADC_buffer_index);
     // set input current to zero and read ADC
-    ADC_SigDel_StartConvert();
     calibrate_step(IDAC_setting, 2);
+    int transfer_int = calibrate_full_scale_IDAC();
+    // is not DRY but not sure how to fix
+    IDAC_calibrate_SetPolarity(IDAC_calibrate_SINK);
+    calibrate_step(transfer_int, 0);
+    calibrate_step(transfer_int/2, 1);
+    IDAC_calibrate_SetPolarity(IDAC_calibrate_SOURCE);
+    calibrate_step(transfer_int/2, 3);
+    calibrate_step(transfer_int, 4);
+    IDAC_calibrate_SetValue(0);
+}
+
+/******************************************************************************
+* Function Name: calibrate_full_scale_IDAC
+*******************************************************************************
+*
+* Summary:
+*  Find the largest IDAC value to use for the calibration, about 1 Volt at the ADC
+*
+* Global variables:
+*  uint8 TIA_resistor_value_index: index of whick TIA resistor to use
+*  uint8 ADC_buffer_index: which ADC buffer is used, gain = 2**ADC_buffer_index
+*
+* Return:
+*  int16_t: IDAC value, 1/8 uA per bit
+*
+*******************************************************************************/
+
+static int16_t calibrate_full_scale_IDAC(void) {
+    // decide what currents to use based on TIA resistor and ADC buffer settings
+    uint16_t resistor_value = calibrate_TIA_resistor_list[TIA_resistor_value_index];
+    uint8 ADC_buffer_value = 1 << ADC_buffer_index;
     // calculate the IDAC value needed to get a 1 Volt in the ADC
     // the 8000 is because the IDAC has a 1/8 uA per bit and 8000=1000mV/(1/8 uA per bit)
-    float32 transfer = 8000./(ADC_buffer_value*resistor_value);
-    int transfer_int = (int) transfer;
+    int transfer_int = 8000 / (ADC_buffer_value*resistor_value);
     if (transfer_int > 250) {  // the TIA needs too much current, reduce needs by half.  Is needed for the 20k resistor setting
         transfer_int /= 2;
     }
     //    LCD_Position(0,0);
 //    sprintf(LCD_str, "in:%d |%d| ", resistor_value, ADC_buffer_value);
 //    LCD_PrintString(LCD_str);
-    // is not DRY but not sure how to fix
+    return transfer_int;
+}
+
+/******************************************************************************
+* Function Name: calibrate_n_points
+*******************************************************************************
+*
+* Summary:
+*  Calibrate the TIA / ADC with points spaced evenly from the largest sink
+*  current to the largest source current and fit a line to them on the device.
+*  The fit is used for the picoamp export until the TIA or ADC settings change
+*
+* Parameters:
+*  uint8_t points: number of calibration points, CAL_MIN_POINTS to CAL_MAX_POINTS
+*
+* Return:
+*  the CAL_FIT_SIZE bytes of struct CalibrateFit are loaded into the USB IN ENDPOINT
+*
+*******************************************************************************/
+
+void calibrate_n_points(uint8_t points) {
+    int16_t IDAC_values[CAL_MAX_POINTS];  // negative values sink current
+    int16_t ADC_values[CAL_MAX_POINTS];
+    struct CalibrateFit fit;
+    if (points < CAL_MIN_POINTS) {
+        points = CAL_MIN_POINTS;
+    }
+    if (points > CAL_MAX_POINTS) {
+        points = CAL_MAX_POINTS;
+    }
+    
+    IDAC_calibrate_Start();
+    IDAC_calibrate_SetValue(0);
+    Calibrate_Hardware_Wakeup();
+    ADC_SigDel_StartConvert();
+    int32_t full_scale = calibrate_full_scale_IDAC();
     IDAC_calibrate_SetPolarity(IDAC_calibrate_SINK);
-    calibrate_step(transfer_int, 0);
-    calibrate_step(transfer_int/2, 1);
-    IDAC_calibrate_SetPolarity(IDAC_calibrate_SOURCE);
-    calibrate_step(transfer_int/2, 3);
-    calibrate_step(transfer_int, 4);
+    // go from the largest sink current to the largest source current so each step is small
+    for (uint8_t i = 0; i < points; i++) {
+        int16_t value = (full_scale*(2*i - (points-1))) / (points-1);
+        if (value >= 0) {
+            IDAC_calibrate_SetPolarity(IDAC_calibrate_SOURCE);
+            IDAC_calibrate_SetValue(value);
+        }
+        else {
+            IDAC_calibrate_SetValue(-value);
+        }
+        IDAC_values[i] = value;
+        ADC_values[i] = calibrate_read_settled();
+    }
     IDAC_calibrate_SetValue(0);
+    IDAC_calibrate_SetPolarity(IDAC_calibrate_SOURCE);
     Calibrate_Hardware_Sleep();
     
-    USB_Export_Data(calibrate_array.usb, 20);
+    calibrate_fit_points(IDAC_values, ADC_values, points, &fit);
+    if (fit.valid) {
+        export_set_calibration(fit.pA_per_count_q16, fit.offset_pA);
+    }
+    USB_Export_Data((uint8_t*)&fit, CAL_FIT_SIZE);
+}
+
+/******************************************************************************
+* Function Name: calibrate_fit_points
+*******************************************************************************
+*
+* Summary:
+*  Least squares fit of the calibration currents against the ADC counts with
+*  only integer math, so current = counts * slope + offset.  The largest
+*  difference between a calibration current and the line is saved to show how
+*  linear the TIA / ADC is
+*
+* Parameters:
+*  const int16_t IDAC_values[]: IDAC setting of each point, negative values sink current
+*  const int16_t ADC_values[]: ADC reading of each point
+*  uint8_t points: number of points
+*  struct CalibrateFit *fit: the results are put here
+*
+*******************************************************************************/
+
+void calibrate_fit_points(const int16_t IDAC_values[], const int16_t ADC_values[], uint8_t points,
+                          struct CalibrateFit *fit) {
+    int64_t sum_counts = 0;
+    int64_t sum_pA = 0;
+    int64_t sum_counts2 = 0;
+    int64_t sum_counts_pA = 0;
+    fit->pA_per_count_q16 = 0;
+    fit->offset_pA = 0;
+    fit->max_residual_pA = 0;
+    fit->points = points;
+    fit->valid = false;
+    fit->max_residual_index = 0;
+    fit->version = CAL_FIT_VERSION;
+    for (uint8_t i = 0; i < points; i++) {
+        int64_t pA = (int64_t)IDAC_values[i] * CAL_IDAC_PICOAMPS_PER_BIT;
+        int64_t counts = ADC_values[i];
+        sum_counts += counts;
+        sum_pA += pA;
+        sum_counts2 += counts * counts;
+        sum_counts_pA += counts * pA;
+    }
+    int64_t denominator = points*sum_counts2 - sum_counts*sum_counts;
+    if (denominator == 0) {  // the ADC readings were all the same
+        return;
+    }
+    int64_t numerator = points*sum_counts_pA - sum_counts*sum_pA;
+    int64_t slope_q16 = (numerator * 65536) / denominator;
+    int64_t offset_q16 = sum_pA * 65536 - slope_q16 * sum_counts;
+    fit->pA_per_count_q16 = (int32_t)slope_q16;
+    int64_t divisor = (int64_t)points * 65536;  // round halves away from 0 so negative offsets are not pulled up
+    fit->offset_pA = (int32_t)((offset_q16 >= 0) ? (offset_q16 + divisor/2) / divisor : -((-offset_q16 + divisor/2) / divisor));
+    fit->valid = true;
+    for (uint8_t i = 0; i < points; i++) {
+        int64_t line_pA = (((int64_t)ADC_values[i] * fit->pA_per_count_q16 + 32768) >> 16) + fit->offset_pA;
+        int64_t residual = (int64_t)IDAC_values[i] * CAL_IDAC_PICOAMPS_PER_BIT - line_pA;
+        if (residual < 0) {
+            residual = -residual;
+        }
+        if (residual > fit->max_residual_pA) {
+            fit->max_residual_pA = (int32_t)residual;
+            fit->max_residual_index = i;
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: calibrate_fit_line
+*******************************************************************************
+*
+* Summary:
+*  Fit a line to a calibration in the calibrate_array layout, the first
+*  CAL_SINK_POINTS points sink current from the TIA and are negative
+*
+* Parameters:
+*  const int16_t cal_data[]: calibration in the calibrate_array layout, the IDAC
+*                            values and then the ADC readings
+*  int32_t *pA_per_count_q16: slope in pA per ADC count, Q16.16 fixed point
+*  int32_t *offset_pA: current in pA at 0 ADC counts
+*
+* Return:
+*  true (1) if the fit worked, false (0) if the ADC readings were all the same
+*
+*******************************************************************************/
+
+uint8_t calibrate_fit_line(const int16_t cal_data[], int32_t *pA_per_count_q16, int32_t *offset_pA) {
+    int16_t IDAC_values[Number_calibration_points];
+    struct CalibrateFit fit;
+    for (uint8_t i = 0; i < Number_calibration_points; i++) {
+        IDAC_values[i] = cal_data[i];
+        if (i < CAL_SINK_POINTS) {
+            IDAC_values[i] = -IDAC_values[i];
+        }
+    }
+    calibrate_fit_points(IDAC_values, &cal_data[Number_calibration_points], Number_calibration_points, &fit);
+    if (!fit.valid) {
+        return false;
+    }
+    *pA_per_count_q16 = fit.pA_per_count_q16;
+    *offset_pA = fit.offset_pA;
+    return true;
+}
+
+/******************************************************************************
+* Function Name: calibrate_nominal_pA_per_count_q16
+*******************************************************************************
+*
+* Summary:
+*  Current per ADC count from the nominal TIA resistor, ADC buffer gain and
+*  ADC reference, for when there is no calibration for the settings.  The full
+*  scale is 2^(bits-1) counts for the resolution of the ADC configuration
+*
+* Parameters:
+*  uint8_t resistor_index: TIA resistor index, 0-7
+*  uint8_t buffer_index: ADC buffer gain index, 0-3
+*  uint8_t adc_config: ADC configuration, 1 (+-2.048 V) or 2 (+-1.024 V)
+*
+* Return:
+*  int32_t: pA per ADC count, Q16.16 fixed point
+*
+*******************************************************************************/
+
+int32_t calibrate_nominal_pA_per_count_q16(uint8_t resistor_index, uint8_t buffer_index, uint8_t adc_config) {
+    uint64_t vref_mV = (adc_config == 1) ? 2048 : 1024;
+    uint32_t resistor_kohms = calibrate_TIA_resistor_list[resistor_index % CAL_TIA_RESISTORS];
+    uint64_t full_scale_counts = (uint64_t)1 << (export_adc_resolution(adc_config) - 1);
+    // pA per count = vref_mV * 1e6 / (full scale counts * gain * kohms)
+    return (int32_t)((vref_mV * 1000000 * 65536) /
+                     (full_scale_counts * ((uint32_t)1 << (buffer_index % CAL_ADC_GAINS)) * resistor_kohms));
+}
+
+/******************************************************************************
+* Function Name: calibrate_load_table
+*******************************************************************************
+*
+* Summary:
+*  Read the calibration table from the EEPROM and keep the conversion of each
+*  entry in RAM, called once at startup.  calibrate_save_entry keeps the RAM
+*  copy up to date after that
+*
+*******************************************************************************/
+
+void calibrate_load_table(void) {
+    uint8_t entry[CAL_ENTRY_SIZE];
+    for (uint8_t entry_index = 0; entry_index < CAL_TABLE_ENTRIES; entry_index++) {
+        helper_Read_EEPROM(entry, CAL_TABLE_ADDRESS + entry_index*CAL_ENTRY_SIZE, CAL_ENTRY_SIZE);
+        calibrate_set_conversion(entry_index, entry);
+    }
+}
+
+/******************************************************************************
+* Function Name: calibrate_set_conversion
+*******************************************************************************
+*
+* Summary:
+*  Set the RAM conversion of a calibration table entry to the line fitted to
+*  its calibration, or to the nominal values if the entry was never saved
+*
+* Parameters:
+*  uint8_t entry_index: which table entry, see calibrate_table_index
+*  const uint8_t entry[]: the CAL_ENTRY_SIZE bytes of the entry
+*
+*******************************************************************************/
+
+static void calibrate_set_conversion(uint8_t entry_index, const uint8_t entry[]) {
+    struct CalibrateConversion *conversion = &conversions[entry_index];
+    conversion->pA_per_count_q16 = calibrate_nominal_pA_per_count_q16(
+        entry_index % CAL_TIA_RESISTORS, (entry_index / CAL_TIA_RESISTORS) % CAL_ADC_GAINS,
+        entry_index / (CAL_TIA_RESISTORS*CAL_ADC_GAINS) + 1);
+    conversion->offset_pA = 0;
+    uint16_t saved_crc = entry[CAL_CRC_INDEX] | (entry[CAL_CRC_INDEX+1] << 8);
+    if ((entry[CAL_VERSION_INDEX] == CAL_TABLE_VERSION) && (entry[CAL_ENTRY_INDEX_INDEX] == entry_index) &&
+        (helper_crc16(entry, CAL_CRC_INDEX) == saved_crc)) {
+        union calibrate_data_usb_union cal_points;  // copy so the data is 16-bit aligned
+        for (uint8_t i = 0; i < CAL_DATA_SIZE; i++) {
+            cal_points.usb[i] = entry[i];
+        }
+        calibrate_fit_line(cal_points.data, &conversion->pA_per_count_q16, &conversion->offset_pA);
+    }
+}
+
+/******************************************************************************
+* Function Name: calibrate_update_conversion
+*******************************************************************************
+*
+* Summary:
+*  Set the ADC count to current conversion used by the picoamp export format to
+*  the calibration table entry for the settings in use, or to the nominal values
+*  if those settings were never calibrated.  Call this after the TIA or ADC
+*  settings are changed, only the copy of the table in RAM is read
+*
+* Global variables:
+*  uint8 TIA_resistor_value_index, ADC_buffer_index, ADC_config_index: settings in use
+*
+*******************************************************************************/
+
+void calibrate_update_conversion(void) {
+    uint8_t entry_index = calibrate_table_index(TIA_resistor_value_index, ADC_buffer_index,
+                                                ADC_config_index);
+    if (entry_index >= CAL_TABLE_ENTRIES) {
+        export_set_calibration(calibrate_nominal_pA_per_count_q16(TIA_resistor_value_index,
+                                                                  ADC_buffer_index, ADC_config_index), 0);
+        return;
+    }
+    export_set_calibration(conversions[entry_index].pA_per_count_q16, conversions[entry_index].offset_pA);
+}
+
+/******************************************************************************
+* Function Name: calibrate_table_index
+*******************************************************************************
+*
+* Summary:
+*  Find the entry in the calibration table for a TIA and ADC setting
+*
+* Parameters:
+*  uint8_t resistor_index: TIA resistor index, 0-7
+*  uint8_t buffer_index: ADC buffer gain index, 0-3
+*  uint8_t adc_config: ADC configuration, 1 or 2
+*
+* Return:
+*  uint8_t: index of the entry, CAL_TABLE_ENTRIES if the settings are not valid
+*
+*******************************************************************************/
+
+uint8_t calibrate_table_index(uint8_t resistor_index, uint8_t buffer_index, uint8_t adc_config) {
+    if ((resistor_index >= CAL_TIA_RESISTORS) || (buffer_index >= CAL_ADC_GAINS) ||
+        (adc_config == 0) || (adc_config > CAL_ADC_CONFIGS)) {
+        return CAL_TABLE_ENTRIES;
+    }
+    return ((adc_config-1)*CAL_ADC_GAINS + buffer_index)*CAL_TIA_RESISTORS + resistor_index;
+}
+
+/******************************************************************************
+* Function Name: calibrate_save_entry
+*******************************************************************************
+*
+* Summary:
+*  Save the last calibration in calibrate_array to the EEPROM calibration table
+*  entry of the TIA and ADC settings in use, and to the copy of the table in RAM
+*
+* Global variables:
+*  uint8 TIA_resistor_value_index, ADC_buffer_index, ADC_config_index: settings in use
+*  calibrate_array: last calibration results
+*
+* Return:
+*  uint8_t: CYRET_SUCCESS if the entry was written
+*
+*******************************************************************************/
+
+uint8_t calibrate_save_entry(void) {
+    uint8_t entry_index = calibrate_table_index(TIA_resistor_value_index, ADC_buffer_index,
+                                                ADC_config_index);
+    if (entry_index >= CAL_TABLE_ENTRIES) {
+        return CYRET_BAD_PARAM;
+    }
+    uint8_t entry[CAL_ENTRY_SIZE];
+    for (uint8_t i = 0; i < CAL_DATA_SIZE; i++) {
+        entry[i] = calibrate_array.usb[i];
+    }
+    entry[CAL_VERSION_INDEX] = CAL_TABLE_VERSION;
+    entry[CAL_ENTRY_INDEX_INDEX] = entry_index;
+    uint16_t crc = helper_crc16(entry, CAL_CRC_INDEX);
+    entry[CAL_CRC_INDEX] = crc & 0xFF;
+    entry[CAL_CRC_INDEX+1] = crc >> 8;
+    calibrate_set_conversion(entry_index, entry);
+    return helper_Write_EEPROM(entry, CAL_TABLE_ADDRESS + entry_index*CAL_ENTRY_SIZE,
+                               CAL_ENTRY_SIZE);
+}
+
+/******************************************************************************
+* Function Name: calibrate_export_table
+*******************************************************************************
+*
+* Summary:
+*  Send the whole calibration table in the EEPROM to the USB in one transfer of
+*  CAL_TABLE_SIZE bytes.  Entries that were never saved have a bad CRC, the host
+*  should check the version and CRC of each entry
+*
+*******************************************************************************/
+
+void calibrate_export_table(void) {
+    uint8_t packet[MAX_BUFFER_SIZE];
+    for (uint16_t i = 0; i < CAL_TABLE_SIZE; i += MAX_BUFFER_SIZE) {
+        uint16_t size = CAL_TABLE_SIZE - i;
+        if (size > MAX_BUFFER_SIZE) {
+            size = MAX_BUFFER_SIZE;
+        }
+        helper_Read_EEPROM(packet, CAL_TABLE_ADDRESS + i, size);
+        USB_Export_Data(packet, size);
+    }
 }
 
 /******************************************************************************
@@ -103,12 +555,104 @@ void calibrate_TIA(void) {
 
 static void calibrate_step(uint16_t IDAC_value, uint8 IDAC_index) {
     IDAC_calibrate_SetValue(IDAC_value);
-    CyDelay(100);  // allow the ADC to settle
-    ADC_value = ADC_SigDel_GetResult16();
+    ADC_value = calibrate_read_settled();  // wait for the TIA and ADC to settle
     calibrate_array.data[IDAC_index] = IDAC_value;
     calibrate_array.data[IDAC_index+5] = ADC_value;  // 5 because of the way the array is set up
 }
 
+/******************************************************************************
+* Function Name: calibrate_read_settled
+*******************************************************************************
+*
+* Summary:
+*  Watch the ADC conversions until they stay within the settling tolerance of
+*  the first reading for the stable count, starting over from the latest reading
+*  when one is outside the tolerance.  Then average the next readings.  If the
+*  timeout is reached the average is taken without waiting anymore
+*
+* Global variables:
+*  settling: settings set with calibrate_set_settling
+*
+* Return:
+*  int16_t: average ADC reading after it settled
+*
+*******************************************************************************/
+
+static int16_t calibrate_read_settled(void) {
+    uint32_t start_us = telemetry_time_us();
+    uint32_t timeout_us = (uint32_t)settling.timeout_ms * 1000;
+    uint8_t timed_out = false;
+    int16_t reference = 0;
+    uint8_t stable = 0;
+    while ((stable <= settling.stable_count) && !timed_out) {
+        while (!ADC_SigDel_IsEndConversion(ADC_SigDel_RETURN_STATUS)) {
+            if (telemetry_time_us() - start_us > timeout_us) {
+                timed_out = true;
+                break;
+            }
+        }
+        int16_t reading = ADC_SigDel_GetResult16();
+        if ((stable == 0) || (abs(reading - reference) > settling.tolerance)) {
+            reference = reading;  // start over from this reading
+            stable = 1;
+        }
+        else {
+            stable++;
+        }
+        if (telemetry_time_us() - start_us > timeout_us) {
+            timed_out = true;
+        }
+    }
+    int32_t sum = 0;
+    for (uint8_t i = 0; i < settling.average_count; i++) {
+        if (!timed_out) {  // don't wait for more conversions if the ADC is stuck
+            while (!ADC_SigDel_IsEndConversion(ADC_SigDel_RETURN_STATUS)) {
+                if (telemetry_time_us() - start_us > timeout_us + 1000) {
+                    timed_out = true;
+                    break;
+                }
+            }
+        }
+        sum += ADC_SigDel_GetResult16();
+    }
+    // round to the nearest count
+    if (sum >= 0) {
+        return (sum + settling.average_count/2) / settling.average_count;
+    }
+    return (sum - settling.average_count/2) / settling.average_count;
+}
+
+/******************************************************************************
+* Function Name: calibrate_set_settling
+*******************************************************************************
+*
+* Summary:
+*  Change how calibrate_step decides the ADC has settled, see struct
+*  CalibrateSettling.  Values that are out of range are changed to the closest
+*  value that works
+*
+* Parameters:
+*  uint16_t tolerance: ADC counts the readings have to stay within
+*  uint8_t stable_count: readings in a row that have to be within the tolerance
+*  uint8_t average_count: readings to average after settling, 1 to SETTLE_MAX_AVERAGE
+*  uint16_t timeout_ms: longest time to wait for each calibration point
+*
+*******************************************************************************/
+
+void calibrate_set_settling(uint16_t tolerance, uint8_t stable_count, uint8_t average_count,
+                            uint16_t timeout_ms) {
+    if (average_count == 0) {
+        average_count = 1;
+    }
+    if (average_count > SETTLE_MAX_AVERAGE) {
+        average_count = SETTLE_MAX_AVERAGE;
+    }
+    settling.tolerance = tolerance;
+    settling.stable_count = stable_count;
+    settling.average_count = average_count;
+    settling.timeout_ms = timeout_ms;
+}
+
 /******************************************************************************
 * Function Name: Calibrate_Hardware_Wakeup
 *******************************************************************************
@@ -121,9 +665,7 @@ static void calibrate_step(uint16_t IDAC_value, uint8 IDAC_index) {
 
 static void Calibrate_Hardware_Wakeup(void) {
     AMux_TIA_input_Select(AMux_TIA_calibrat_ch);
-    TIA_Wakeup();
-    VDAC_TIA_Wakeup();
-    ADC_SigDel_Wakeup();
+    power_acquire(POWER_HOLDER_CALIBRATE, POWER_MEASURE_BLOCKS);
 }
 
 /******************************************************************************
@@ -131,16 +673,14 @@ static void Calibrate_Hardware_Wakeup(void) {
 *******************************************************************************
 *
 * Summary:
-*  Put to sleep all the hardware needed for the calibration routine, stop  
+*  Let go of the hardware needed for the calibration routine so it can sleep, stop  
 *  the IDAC, and set the AMux to the correct channel
 *
 *******************************************************************************/
 
 static void Calibrate_Hardware_Sleep(void) {
     AMux_TIA_input_Select(AMux_TIA_measure_ch);
-    TIA_Sleep();
-    VDAC_TIA_Sleep();
-    ADC_SigDel_Sleep();
+    power_release(POWER_HOLDER_CALIBRATE, POWER_MEASURE_BLOCKS);
     IDAC_calibrate_Stop();
 }
 
@@ -15,7 +15,6 @@
 
 #include <project.h>
 #include "cytypes.h"
-#include "math.h"
 #include "stdio.h"  // gets rid of the type errors
     
 /**************************************
@@ -25,6 +24,40 @@
 #define AMux_TIA_calibrat_ch 0
 #define AMux_TIA_measure_ch 1    
 #define Number_calibration_points 5
+
+/* Calibration table in the EEPROM with an entry for each TIA resistor, ADC buffer gain
+ * and ADC configuration.  Each entry is the 20 bytes of calibrate_array, then the table
+ * version, the entry index and a CRC16 of the first 22 bytes (little endian) */
+#define CAL_TABLE_VERSION       1
+#define CAL_TIA_RESISTORS       8
+#define CAL_ADC_GAINS           4
+#define CAL_ADC_CONFIGS         2
+#define CAL_TABLE_ENTRIES       (CAL_TIA_RESISTORS*CAL_ADC_GAINS*CAL_ADC_CONFIGS)
+#define CAL_DATA_SIZE           (4*Number_calibration_points)
+#define CAL_ENTRY_SIZE          24
+#define CAL_TABLE_SIZE          (CAL_TABLE_ENTRIES*CAL_ENTRY_SIZE)
+#define CAL_TABLE_ADDRESS       32  // EEPROM rows 0 and 1 are kept for the device settings
+#define CAL_VERSION_INDEX       20  // where in an entry the version, entry index and CRC are
+#define CAL_ENTRY_INDEX_INDEX   21
+#define CAL_CRC_INDEX           22
+#define CAL_SWEEP_SIZE          (CAL_TIA_RESISTORS*CAL_ADC_GAINS*CAL_DATA_SIZE)  // bytes the 'b' command sends
+
+// the calibration IDAC is 1/8 uA per bit
+#define CAL_IDAC_PICOAMPS_PER_BIT   125000
+#define CAL_SINK_POINTS             2  // the first 2 calibration points sink current
+
+// N point calibration with the 'n' command
+#define CAL_MIN_POINTS          3
+#define CAL_MAX_POINTS          64
+#define CAL_FIT_VERSION         1
+#define CAL_FIT_SIZE            16  // bytes of struct CalibrateFit the 'n' command sends
+
+// default settling detection, the timeout is the fixed delay that was used before
+#define SETTLE_TOLERANCE        8  // ADC counts
+#define SETTLE_STABLE_COUNT     4
+#define SETTLE_AVERAGE_COUNT    8
+#define SETTLE_TIMEOUT_MS       100
+#define SETTLE_MAX_AVERAGE      64
   
     
 union calibrate_data_usb_union {
@@ -38,14 +71,44 @@ lowest IDAC value, ADC reading for highest IDAC value, ADC reading for 2ndhighes
 ADC reading 0 IDAC input, ADC reading for 2nd lowest IDAC value, ADC reading for lowest IDAC value]
 */
 
+/* How calibrate_step decides the TIA / ADC has settled after the IDAC is changed,
+ * the readings have to stay within tolerance of the first reading for stable_count
+ * readings in a row, then average_count readings are averaged */
+struct CalibrateSettling {
+    uint16_t tolerance;  // ADC counts
+    uint8_t stable_count;
+    uint8_t average_count;
+    uint16_t timeout_ms;  // take the readings anyways after this long
+};
+
+/* Result of an N point calibration, current = counts * pA_per_count + offset_pA.
+ * The fields are on their natural alignment so the struct is the 16 bytes sent
+ * to the host, little endian */
+struct CalibrateFit {
+    int32_t pA_per_count_q16;  // Q16.16 fixed point
+    int32_t offset_pA;
+    int32_t max_residual_pA;  // largest difference between a calibration current and the line
+    uint8_t points;
+    uint8_t max_residual_index;  // which point had the largest residual
+    uint8_t valid;  // false (0) if the ADC readings were all the same
+    uint8_t version;  // CAL_FIT_VERSION
+};
+
+/* ADC count to current conversion of a calibration table entry, kept in RAM so
+ * changing the TIA or ADC settings does not read the EEPROM */
+struct CalibrateConversion {
+    int32_t pA_per_count_q16;  // Q16.16 fixed point
+    int32_t offset_pA;
+};
+
 /***************************************
 * Global variables identifier 
 ***************************************/
 
 uint8_t TIA_resistor_value_index;
 uint8_t ADC_buffer_index;
-extern float32 uA_per_adc_count;
-extern float32 R_analog_route;
+extern const uint16_t calibrate_TIA_resistor_list[];  // TIA resistors in kohms
+extern uint8_t ADC_config_index;  // ADC configuration selected, 1 or 2
 
     
 extern char LCD_str[];  // for debug
@@ -55,6 +118,19 @@ extern char LCD_str[];  // for debug
 *        Function Prototypes
 ***************************************/  
 void calibrate_TIA(void);
+void calibrate_sweep(void);
+void calibrate_set_settling(uint16_t tolerance, uint8_t stable_count, uint8_t average_count,
+                            uint16_t timeout_ms);
+void calibrate_n_points(uint8_t points);
+void calibrate_fit_points(const int16_t IDAC_values[], const int16_t ADC_values[], uint8_t points,
+                          struct CalibrateFit *fit);
+uint8_t calibrate_fit_line(const int16_t cal_data[], int32_t *pA_per_count_q16, int32_t *offset_pA);
+int32_t calibrate_nominal_pA_per_count_q16(uint8_t resistor_index, uint8_t buffer_index, uint8_t adc_config);
+void calibrate_load_table(void);
+void calibrate_update_conversion(void);
+uint8_t calibrate_table_index(uint8_t resistor_index, uint8_t buffer_index, uint8_t adc_config);
+uint8_t calibrate_save_entry(void);
+void calibrate_export_table(void);
 
 #endif
 /* [] END OF FILE */
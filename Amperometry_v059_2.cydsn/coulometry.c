@@ -0,0 +1,155 @@
+/*******************************************************************************
+* File Name: coulometry.c
+*
+* Description:
+*  Integrate the current of a pulse run for chronocoulometry.  The ADC isr
+*  averages the readings at the baseline potential, then keeps a 64-bit running
+*  sum of each reading minus that baseline from when the pulse starts.  The sum
+*  is saved every samples_per_point readings so the host only reads the charge
+*  trace, and the baseline is in Q16.16 so the isr only adds and never divides
+*  per sample
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "coulometry.h"
+#include "usb_protocols.h"
+
+static struct CoulometryTrace trace = {COULOMETRY_VERSION};
+static uint16_t samples_per_point = 0;  // 0 when chronocoulometry is off
+static uint16_t baseline_value;  // DAC value of the baseline potential
+static uint8_t integrating = false;  // set when the pulse starts
+static int64_t baseline_sum;
+static int64_t charge_q16;
+static uint16_t point_count;  // readings since the last saved point
+
+/******************************************************************************
+* Function Name: coulometry_set
+*******************************************************************************
+*
+* Summary:
+*  Turn chronocoulometry on or off for the next runs started with 'R'
+*
+* Parameters:
+*  uint16_t samples_per_point: readings between saved charge points, 0 turns
+*                              chronocoulometry off
+*
+*******************************************************************************/
+
+void coulometry_set(uint16_t _samples_per_point) {
+    uint8 interrupts = CyEnterCriticalSection();
+    samples_per_point = _samples_per_point;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: coulometry_start
+*******************************************************************************
+*
+* Summary:
+*  Clear the charge trace, called when a run starts
+*
+* Parameters:
+*  uint16_t first_value: first look up table value of the run, the baseline potential
+*
+*******************************************************************************/
+
+void coulometry_start(uint16_t first_value) {
+    uint8 interrupts = CyEnterCriticalSection();
+    baseline_value = first_value;
+    integrating = false;
+    baseline_sum = 0;
+    charge_q16 = 0;
+    point_count = 0;
+    trace.dropped = false;
+    trace.points = 0;
+    trace.samples_per_point = samples_per_point;
+    trace.baseline_samples = 0;
+    trace.baseline_q16 = 0;
+    trace.samples_integrated = 0;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: coulometry_sample
+*******************************************************************************
+*
+* Summary:
+*  Add an ADC reading to the baseline or the charge, called by the ADC isr.
+*  The pulse starts the first time the DAC is not at the baseline value, the
+*  charge keeps being integrated after the DAC goes back to the baseline
+*
+* Parameters:
+*  int16_t reading: ADC reading
+*  uint16_t dac_value: value the DAC had while the reading was taken
+*
+*******************************************************************************/
+
+void coulometry_sample(int16_t reading, uint16_t dac_value) {
+    if (samples_per_point == 0) {
+        return;
+    }
+    if (!integrating) {
+        if (dac_value == baseline_value) {
+            if (trace.baseline_samples < 0xFFFF) {
+                baseline_sum += reading;
+                trace.baseline_samples++;
+            }
+            return;
+        }
+        integrating = true;
+        if (trace.baseline_samples) {  // only divide once, when the pulse starts
+            trace.baseline_q16 = (int32_t)((baseline_sum << COULOMETRY_FRACTION_BITS) / trace.baseline_samples);
+        }
+    }
+    charge_q16 += ((int64_t)reading << COULOMETRY_FRACTION_BITS) - trace.baseline_q16;
+    trace.samples_integrated++;
+    point_count++;
+    if (point_count >= samples_per_point) {
+        point_count = 0;
+        if (trace.points < COULOMETRY_MAX_POINTS) {
+            trace.charge_q16[trace.points] = charge_q16;
+            trace.points++;
+        }
+        else {
+            trace.dropped = true;
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: coulometry_get_trace
+*******************************************************************************
+*
+* Summary:
+*  Get the charge trace of the last run
+*
+* Return:
+*  const struct CoulometryTrace*: the charge trace
+*
+*******************************************************************************/
+
+const struct CoulometryTrace* coulometry_get_trace(void) {
+    return &trace;
+}
+
+/******************************************************************************
+* Function Name: coulometry_export
+*******************************************************************************
+*
+* Summary:
+*  Send the header and the saved points of the charge trace to the USB, the
+*  'J' command
+*
+*******************************************************************************/
+
+void coulometry_export(void) {
+    uint8 interrupts = CyEnterCriticalSection();
+    uint16_t points = trace.points;
+    CyExitCriticalSection(interrupts);
+    USB_Export_Data((uint8_t*)&trace, COULOMETRY_HEADER_SIZE + 8*points);
+}
+
+/* [] END OF FILE */
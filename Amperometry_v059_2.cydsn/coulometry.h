@@ -0,0 +1,63 @@
+/*******************************************************************************
+* File Name: coulometry.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to integrate
+*  the current of a pulse (chronocoulometry) run in the ADC isr, so the host
+*  can read the charge at a reduced rate instead of every current sample
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(COULOMETRY_H)
+#define COULOMETRY_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define COULOMETRY_VERSION          1
+#define COULOMETRY_MAX_POINTS       128  // charge points saved per run, 8 bytes each
+#define COULOMETRY_HEADER_SIZE      16
+#define COULOMETRY_FRACTION_BITS    16  // the charge is in ADC counts * samples, Q48.16
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* Charge trace of the last run the 'J' command sends, only the header and the
+ * saved points are sent.  The baseline is the average reading while the DAC was
+ * at the first look up table value, the charge is integrated from the first
+ * sample the look up table changes and a point is saved every samples_per_point.
+ * The fields are on their natural alignment so the header is 16 bytes */
+struct CoulometryTrace {
+    uint8_t version;  // COULOMETRY_VERSION
+    uint8_t dropped;  // true (1) if there were more points than COULOMETRY_MAX_POINTS
+    uint16_t points;  // charge points saved
+    uint16_t samples_per_point;
+    uint16_t baseline_samples;  // readings averaged into the baseline
+    int32_t baseline_q16;  // ADC counts, Q16.16
+    uint32_t samples_integrated;
+    int64_t charge_q16[COULOMETRY_MAX_POINTS];  // running integral of the reading - baseline
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void coulometry_set(uint16_t samples_per_point);
+void coulometry_start(uint16_t first_value);
+void coulometry_sample(int16_t reading, uint16_t dac_value);
+const struct CoulometryTrace* coulometry_get_trace(void);
+void coulometry_export(void);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,397 @@
+/*******************************************************************************
+* File Name: data_export.c
+*
+* Description:
+*  Export the ADC data to the USB in the format the host has selected.
+*  The data can be sent as raw 16-bit numbers, packed at the resolution the
+*  Delta Sigma ADC is configured for, so fast low resolution scans send
+*  proportionally fewer bytes, or converted to calibrated currents in pA.
+*  Square wave voltammetry runs can also send the difference of the forward
+*  and reverse reading of each step instead of both readings
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "data_export.h"
+
+static uint8_t export_format = EXPORT_FORMAT_RAW16;
+static uint8_t export_bits = EXPORT_MAX_BITS;  // bits per sample of the ADC configuration in use
+static int32_t pA_per_count_q16 = 65536;  // set by the calibration, Q16.16 fixed point
+static int32_t offset_pA = 0;
+// int32_t so the converted currents are aligned, +1 for the header byte of the packed format
+static int32_t export_buffer[EXPORT_PACK_BUFFER_SIZE/4 + 1];
+static uint8_t *pack_buffer = (uint8_t*)export_buffer;
+
+/******************************************************************************
+* Function Name: export_set_format
+*******************************************************************************
+*
+* Summary:
+*  Select how the ADC data is exported, unknown formats fall back to raw 16-bit data
+*
+* Parameters:
+*  uint8_t format: EXPORT_FORMAT_RAW16, EXPORT_FORMAT_PACKED, EXPORT_FORMAT_PICOAMPS,
+*                  EXPORT_FORMAT_SWV_DIFFERENCE or EXPORT_FORMAT_SWV_ALL
+*
+*******************************************************************************/
+
+void export_set_format(uint8_t format) {
+    if (format <= EXPORT_FORMAT_SWV_ALL) {
+        export_format = format;
+    }
+    else {
+        export_format = EXPORT_FORMAT_RAW16;
+    }
+}
+
+/******************************************************************************
+* Function Name: export_get_format
+*******************************************************************************
+*
+* Summary:
+*  Get the format the ADC data is exported in
+*
+* Return:
+*  uint8_t: format selected with export_set_format
+*
+*******************************************************************************/
+
+uint8_t export_get_format(void) {
+    return export_format;
+}
+
+/******************************************************************************
+* Function Name: export_set_resolution
+*******************************************************************************
+*
+* Summary:
+*  Update the number of bits the packed format uses, call this every time the
+*  ADC configuration is changed with ADC_SigDel_SelectConfiguration
+*
+* Parameters:
+*  uint8_t adc_config: ADC configuration that was selected, 1 or 2
+*
+*******************************************************************************/
+
+void export_set_resolution(uint8_t adc_config) {
+    export_bits = export_adc_resolution(adc_config);
+}
+
+/******************************************************************************
+* Function Name: export_set_calibration
+*******************************************************************************
+*
+* Summary:
+*  Set the conversion from ADC counts to current used by the picoamp format,
+*  current = counts * pA_per_count + offset.  See calibrate_update_conversion
+*
+* Parameters:
+*  int32_t pA_per_count_q16: pA per ADC count, Q16.16 fixed point
+*  int32_t offset_pA: current at 0 ADC counts
+*
+*******************************************************************************/
+
+void export_set_calibration(int32_t _pA_per_count_q16, int32_t _offset_pA) {
+    pA_per_count_q16 = _pA_per_count_q16;
+    offset_pA = _offset_pA;
+}
+
+/******************************************************************************
+* Function Name: export_counts_to_pA
+*******************************************************************************
+*
+* Summary:
+*  Convert an ADC reading to current with integer math only, a 32x32 bit
+*  multiply to 64 bits and a shift, so it is cheap enough to do for every sample
+*
+* Parameters:
+*  int16_t counts: ADC reading
+*
+* Return:
+*  int32_t: current in pA, rounded to the nearest pA
+*
+*******************************************************************************/
+
+int32_t export_counts_to_pA(int16_t counts) {
+    return (int32_t)(((int64_t)counts * pA_per_count_q16 + 32768) >> 16) + offset_pA;
+}
+
+/******************************************************************************
+* Function Name: export_convert_to_pA
+*******************************************************************************
+*
+* Summary:
+*  Convert a block of ADC readings to currents
+*
+* Parameters:
+*  const int16_t samples[]: ADC readings to convert
+*  uint16_t count: number of samples to convert
+*  int32_t currents[]: array to put the currents in pA in
+*
+*******************************************************************************/
+
+void export_convert_to_pA(const int16_t samples[], uint16_t count, int32_t currents[]) {
+    for (uint16_t i = 0; i < count; i++) {
+        currents[i] = export_counts_to_pA(samples[i]);
+    }
+}
+
+/******************************************************************************
+* Function Name: export_adc_resolution
+*******************************************************************************
+*
+* Summary:
+*  Look up the resolution of an ADC configuration
+*
+* Parameters:
+*  uint8_t adc_config: ADC configuration, 1 or 2
+*
+* Return:
+*  uint8_t: number of bits the ADC gives for that configuration, 16 if the
+*  configuration is not known
+*
+*******************************************************************************/
+
+uint8_t export_adc_resolution(uint8_t adc_config) {
+    uint8_t bits = EXPORT_MAX_BITS;
+    if (adc_config == 1) {
+        bits = ADC_SigDel_CFG1_RESOLUTION;
+    }
+    else if (adc_config == 2) {
+        bits = ADC_SigDel_CFG2_RESOLUTION;
+    }
+    if ((bits == 0) || (bits > EXPORT_MAX_BITS)) {  // the 20-bit modes are only read 16 bits at a time
+        bits = EXPORT_MAX_BITS;
+    }
+    return bits;
+}
+
+/******************************************************************************
+* Function Name: export_pack_samples
+*******************************************************************************
+*
+* Summary:
+*  Pack the lowest bits of each sample into a little endian bit stream, the first
+*  sample goes in the lowest bits of the first byte.  The host sign extends
+*  each sample back to 16 bits
+*
+* Parameters:
+*  const int16_t samples[]: ADC readings to pack
+*  uint16_t count: number of samples to pack
+*  uint8_t bits: bits to keep of each sample, 1 to 16
+*  uint8_t packed[]: array to put the packed data in, needs (count*bits+7)/8 bytes
+*
+* Return:
+*  uint16_t: number of bytes put in packed
+*
+*******************************************************************************/
+
+uint16_t export_pack_samples(const int16_t samples[], uint16_t count, uint8_t bits, uint8_t packed[]) {
+    uint32_t mask = (1UL << bits) - 1;
+    uint32_t accumulator = 0;
+    uint8_t bits_held = 0;
+    uint16_t num_bytes = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        accumulator |= ((uint32_t)(uint16_t)samples[i] & mask) << bits_held;
+        bits_held += bits;
+        while (bits_held >= 8) {
+            packed[num_bytes] = (uint8_t)accumulator;
+            num_bytes++;
+            accumulator >>= 8;
+            bits_held -= 8;
+        }
+    }
+    if (bits_held) {  // put the left over bits in the last byte
+        packed[num_bytes] = (uint8_t)accumulator;
+        num_bytes++;
+    }
+    return num_bytes;
+}
+
+/******************************************************************************
+* Function Name: export_samples
+*******************************************************************************
+*
+* Summary:
+*  Send ADC samples to the USB in the selected export format.
+*  The packed format sends a header byte with the number of bits per sample and
+*  then packs the data in blocks so only a small buffer is needed, the picoamp
+*  format is also converted in blocks.  The blocks are sent as 1 transfer on the
+*  streaming endpoint.  The square wave formats only make sense
+*  for a voltammetry run, see export_run_samples, other data is sent as raw 16-bit
+*
+* Parameters:
+*  const int16_t samples[]: ADC readings to export
+*  uint16_t count: number of samples to export
+*
+*******************************************************************************/
+
+void export_samples(const int16_t samples[], uint16_t count) {
+    if ((export_format == EXPORT_FORMAT_RAW16) || (export_format == EXPORT_FORMAT_SWV_DIFFERENCE) ||
+        (export_format == EXPORT_FORMAT_SWV_ALL)) {
+        USB_Export_Sample_Data((uint8_t*)samples, 2*count);
+        return;
+    }
+    if (export_format == EXPORT_FORMAT_PICOAMPS) {
+        for (uint16_t i = 0; i < count; i += EXPORT_PICOAMPS_BLOCK_SIZE) {
+            uint16_t samples_to_convert = count - i;
+            if (samples_to_convert > EXPORT_PICOAMPS_BLOCK_SIZE) {
+                samples_to_convert = EXPORT_PICOAMPS_BLOCK_SIZE;
+            }
+            export_convert_to_pA(&samples[i], samples_to_convert, export_buffer);
+            USB_Export_Sample_Block((uint8_t*)export_buffer, 4*samples_to_convert);
+        }
+        USB_Export_Sample_End();
+        return;
+    }
+    uint16_t block_size = EXPORT_PACK_GROUPS_PER_PACKET * EXPORT_PACK_GROUP_SIZE;
+    uint16_t header_size = 1;
+    pack_buffer[0] = export_bits;
+    for (uint16_t i = 0; i < count; i += block_size) {
+        uint16_t samples_to_pack = count - i;
+        if (samples_to_pack > block_size) {
+            samples_to_pack = block_size;
+        }
+        uint16_t num_bytes = export_pack_samples(&samples[i], samples_to_pack, export_bits,
+                                                 &pack_buffer[header_size]);
+        USB_Export_Sample_Block(pack_buffer, num_bytes + header_size);
+        header_size = 0;  // only the first block has the header
+    }
+    if (count == 0) {  // still tell the host the resolution
+        USB_Export_Sample_Block(pack_buffer, 1);
+    }
+    USB_Export_Sample_End();
+}
+
+/******************************************************************************
+* Function Name: export_marked_samples
+*******************************************************************************
+*
+* Summary:
+*  Send ADC readings that end with the 0xC000 end of run marker, for the 'E' and
+*  'F' commands.  The packed format leaves the marker out, packed at less than
+*  16 bits it would look like a reading of 0, the host knows how many readings
+*  to expect.  The other formats send the marker after the readings
+*
+* Parameters:
+*  const int16_t samples[]: ADC readings to export, with the marker at samples[count]
+*  uint16_t count: number of readings to export, without the marker
+*
+*******************************************************************************/
+
+void export_marked_samples(const int16_t samples[], uint16_t count) {
+    if (export_format == EXPORT_FORMAT_PACKED) {
+        export_samples(samples, count);
+    }
+    else {
+        export_samples(samples, count+1);
+    }
+}
+
+/******************************************************************************
+* Function Name: export_swv_steps
+*******************************************************************************
+*
+* Summary:
+*  Get how many square wave steps of a run can be combined.  LUT_make_swv_line
+*  puts the forward (value + pulse_height) and reverse (value - pulse_height)
+*  of each step in pairs from the start of the look up table.  The ADC reading
+*  taken while the DAC holds look up table entry i is sample i+1, so a pair
+*  starts at sample 1, the last look up table entry is never read and an
+*  unpaired entry at the end is dropped
+*
+* Parameters:
+*  uint16_t lut_length: number of look up table entries that were run
+*
+* Return:
+*  uint16_t: number of forward / reverse steps
+*
+*******************************************************************************/
+
+uint16_t export_swv_steps(uint16_t lut_length) {
+    if (lut_length == 0) {
+        return 0;
+    }
+    return (lut_length - 1) / 2;
+}
+
+/******************************************************************************
+* Function Name: export_swv_combine
+*******************************************************************************
+*
+* Summary:
+*  Combine the forward and reverse readings of square wave steps.  The
+*  difference is limited to the int16_t range
+*
+* Parameters:
+*  const int16_t samples[]: forward then reverse reading of each step
+*  uint16_t steps: number of steps to combine
+*  uint8_t format: EXPORT_FORMAT_SWV_DIFFERENCE for only the difference of each
+*                  step, EXPORT_FORMAT_SWV_ALL for the forward, reverse and difference
+*  int16_t combined[]: array to put the results in, needs steps or 3*steps spaces
+*
+* Return:
+*  uint16_t: number of values put in combined
+*
+*******************************************************************************/
+
+uint16_t export_swv_combine(const int16_t samples[], uint16_t steps, uint8_t format, int16_t combined[]) {
+    uint16_t num_values = 0;
+    for (uint16_t i = 0; i < steps; i++) {
+        int16_t forward = samples[2*i];
+        int16_t reverse = samples[2*i + 1];
+        int32_t difference = (int32_t)forward - reverse;
+        if (difference > INT16_MAX) {
+            difference = INT16_MAX;
+        }
+        else if (difference < INT16_MIN) {
+            difference = INT16_MIN;
+        }
+        if (format == EXPORT_FORMAT_SWV_ALL) {
+            combined[num_values++] = forward;
+            combined[num_values++] = reverse;
+        }
+        combined[num_values++] = (int16_t)difference;
+    }
+    return num_values;
+}
+
+/******************************************************************************
+* Function Name: export_run_samples
+*******************************************************************************
+*
+* Summary:
+*  Send the ADC readings of a voltammetry run, the 'E' command.  With a square
+*  wave format the steps are combined in blocks and the end of run marker is
+*  not sent, the host gets the number of steps from the look up table length,
+*  see export_swv_steps.  The other formats send the readings with
+*  export_marked_samples
+*
+* Parameters:
+*  const int16_t samples[]: ADC readings of the run, lut_length+1 with the end marker
+*  uint16_t lut_length: number of look up table entries that were run
+*
+*******************************************************************************/
+
+void export_run_samples(const int16_t samples[], uint16_t lut_length) {
+    if ((export_format != EXPORT_FORMAT_SWV_DIFFERENCE) && (export_format != EXPORT_FORMAT_SWV_ALL)) {
+        export_marked_samples(samples, lut_length);
+        return;
+    }
+    uint16_t steps = export_swv_steps(lut_length);
+    const int16_t *pairs = &samples[1];
+    for (uint16_t i = 0; i < steps; i += EXPORT_SWV_BLOCK_SIZE) {
+        uint16_t steps_to_combine = steps - i;
+        if (steps_to_combine > EXPORT_SWV_BLOCK_SIZE) {
+            steps_to_combine = EXPORT_SWV_BLOCK_SIZE;
+        }
+        uint16_t num_values = export_swv_combine(&pairs[2*i], steps_to_combine, export_format,
+                                                 (int16_t*)export_buffer);
+        USB_Export_Sample_Block((uint8_t*)export_buffer, 2*num_values);
+    }
+    USB_Export_Sample_End();
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,62 @@
+/*******************************************************************************
+* File Name: data_export.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to
+*  export the ADC data in the different formats the host can select
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(DATA_EXPORT_H)
+#define DATA_EXPORT_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+#include "usb_protocols.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define EXPORT_FORMAT_RAW16             0  // 2 bytes per sample, little endian int16
+#define EXPORT_FORMAT_PACKED            1  // 1 header byte with the bits per sample, then a packed bit stream
+#define EXPORT_FORMAT_PICOAMPS          2  // 4 bytes per sample, little endian int32 of the current in pA
+// square wave voltammetry, the forward and reverse readings of each step are combined on the device
+#define EXPORT_FORMAT_SWV_DIFFERENCE    3  // 2 bytes per step, int16 of forward - reverse
+#define EXPORT_FORMAT_SWV_ALL           4  // 6 bytes per step, int16 of forward, reverse and forward - reverse
+
+#define EXPORT_MAX_BITS                 16
+// samples are packed 32 at a time so every group ends on a byte boundary for any resolution
+#define EXPORT_PACK_GROUP_SIZE          32
+#define EXPORT_PACK_GROUPS_PER_PACKET   8
+#define EXPORT_PACK_BUFFER_SIZE         (EXPORT_PACK_GROUPS_PER_PACKET * EXPORT_PACK_GROUP_SIZE * EXPORT_MAX_BITS / 8)
+// the currents are converted in blocks that use the same buffer as the packed format
+#define EXPORT_PICOAMPS_BLOCK_SIZE      (EXPORT_PACK_BUFFER_SIZE / 4)
+#define EXPORT_SWV_BLOCK_SIZE           (EXPORT_PACK_BUFFER_SIZE / 6)  // steps combined at a time
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void export_set_format(uint8_t format);
+uint8_t export_get_format(void);
+void export_set_resolution(uint8_t adc_config);
+uint8_t export_adc_resolution(uint8_t adc_config);
+void export_set_calibration(int32_t pA_per_count_q16, int32_t offset_pA);
+int32_t export_counts_to_pA(int16_t counts);
+void export_convert_to_pA(const int16_t samples[], uint16_t count, int32_t currents[]);
+uint16_t export_pack_samples(const int16_t samples[], uint16_t count, uint8_t bits, uint8_t packed[]);
+void export_samples(const int16_t samples[], uint16_t count);
+void export_marked_samples(const int16_t samples[], uint16_t count);
+uint16_t export_swv_steps(uint16_t lut_length);
+uint16_t export_swv_combine(const int16_t samples[], uint16_t steps, uint8_t format, int16_t combined[]);
+void export_run_samples(const int16_t samples[], uint16_t lut_length);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,151 @@
+/*******************************************************************************
+* File Name: decimate.c
+*
+* Description:
+*  Decimate the amperometry readings in the ADC isr, only every ratio-th
+*  filtered reading is saved in the ADC buffers.  The boxcar saves the average of
+*  each block of readings, the CIC filter is 3 boxcars in a row so it lets less
+*  of the noise above the new sample rate through.  Both use integer math only
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "decimate.h"
+
+static struct DecimateFilter filter = {DECIMATE_OFF, 1, 0, 0, {0}, {0}, 1, DECIMATE_CIC_ORDER - 1};
+
+/***************************************
+*        Forward function references
+***************************************/
+static int16_t decimate_divide(int64_t sum, uint64_t divisor);
+
+/******************************************************************************
+* Function Name: decimate_set
+*******************************************************************************
+*
+* Summary:
+*  Select the filter and how many readings are combined into each saved data
+*  point, used by the next amperometry run
+*
+* Parameters:
+*  uint8_t type: DECIMATE_OFF, DECIMATE_BOXCAR or DECIMATE_CIC, unknown types turn
+*                the filter off
+*  uint16_t ratio: readings per saved data point, up to DECIMATE_MAX_RATIO, 0 or 1
+*                  turns the filter off
+*
+*******************************************************************************/
+
+void decimate_set(uint8_t type, uint16_t ratio) {
+    if (ratio > DECIMATE_MAX_RATIO) {
+        ratio = DECIMATE_MAX_RATIO;
+    }
+    if ((ratio <= 1) || ((type != DECIMATE_BOXCAR) && (type != DECIMATE_CIC))) {
+        type = DECIMATE_OFF;
+        ratio = 1;
+    }
+    uint8 interrupts = CyEnterCriticalSection();
+    filter.type = type;
+    filter.ratio = ratio;
+    filter.gain = (uint64_t)ratio * ratio * ratio;
+    CyExitCriticalSection(interrupts);
+    decimate_reset();
+}
+
+/******************************************************************************
+* Function Name: decimate_reset
+*******************************************************************************
+*
+* Summary:
+*  Clear the filter, called when an amperometry run starts.  The first
+*  DECIMATE_CIC_ORDER-1 CIC outputs after it would be made partly of the zeros
+*  the filter starts with, so they are not saved
+*
+*******************************************************************************/
+
+void decimate_reset(void) {
+    uint8 interrupts = CyEnterCriticalSection();
+    filter.count = 0;
+    filter.sum = 0;
+    for (uint8_t i = 0; i < DECIMATE_CIC_ORDER; i++) {
+        filter.integrators[i] = 0;
+        filter.comb_delays[i] = 0;
+    }
+    filter.filling = DECIMATE_CIC_ORDER - 1;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: decimate_sample
+*******************************************************************************
+*
+* Summary:
+*  Put a reading through the filter, called by the amperometry ADC isr
+*
+* Parameters:
+*  int16_t reading: ADC reading
+*  int16_t *output: where to put the data point to save
+*
+* Return:
+*  uint8_t: true (1) if output has a data point to save, false (0) if the
+*           filter needs more readings
+*
+*******************************************************************************/
+
+uint8_t decimate_sample(int16_t reading, int16_t *output) {
+    if (filter.type == DECIMATE_OFF) {
+        *output = reading;
+        return true;
+    }
+    filter.count++;
+    if (filter.type == DECIMATE_BOXCAR) {
+        filter.sum += reading;
+        if (filter.count < filter.ratio) {
+            return false;
+        }
+        *output = decimate_divide(filter.sum, filter.ratio);
+        filter.sum = 0;
+        filter.count = 0;
+        return true;
+    }
+    uint64_t value = (uint64_t)(int64_t)reading;
+    for (uint8_t i = 0; i < DECIMATE_CIC_ORDER; i++) {
+        filter.integrators[i] += value;
+        value = filter.integrators[i];
+    }
+    if (filter.count < filter.ratio) {
+        return false;
+    }
+    filter.count = 0;
+    for (uint8_t i = 0; i < DECIMATE_CIC_ORDER; i++) {
+        uint64_t delayed = filter.comb_delays[i];
+        filter.comb_delays[i] = value;
+        value -= delayed;
+    }
+    if (filter.filling) {  // the combs still have the zeros of the reset in them
+        filter.filling--;
+        return false;
+    }
+    *output = decimate_divide((int64_t)value, filter.gain);
+    return true;
+}
+
+/******************************************************************************
+* Function Name: decimate_divide
+*******************************************************************************
+*
+* Summary:
+*  Divide the filter sum by its gain, rounded to the nearest count
+*
+*******************************************************************************/
+
+static int16_t decimate_divide(int64_t sum, uint64_t divisor) {
+    int64_t half = (int64_t)(divisor / 2);
+    if (sum < 0) {
+        return (int16_t)(-((-sum + half) / (int64_t)divisor));
+    }
+    return (int16_t)((sum + half) / (int64_t)divisor);
+}
+
+/* [] END OF FILE */
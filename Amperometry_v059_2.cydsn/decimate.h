@@ -0,0 +1,63 @@
+/*******************************************************************************
+* File Name: decimate.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to average
+*  down the amperometry readings before they are saved, so a long run can save
+*  1 data point a second instead of every Delta Sigma ADC conversion
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(DECIMATE_H)
+#define DECIMATE_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define DECIMATE_OFF                0  // save every reading
+#define DECIMATE_BOXCAR             1  // save the average of each ratio readings
+#define DECIMATE_CIC                2  // save every ratio-th output of a 3rd order CIC (sinc^3) filter
+
+#define DECIMATE_CIC_ORDER          3
+/* The CIC gain is ratio^3, with 16-bit readings the integrators need
+ * 16 + 3*log2(ratio) bits so the ratio is kept to 12 bits to stay in 64 bits */
+#define DECIMATE_MAX_RATIO          4096
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* State of the filter, the CIC integrators run on every reading and the combs
+ * on every ratio-th.  They are unsigned so they can wrap around, the CIC output
+ * is still correct as long as it fits in 64 bits */
+struct DecimateFilter {
+    uint8_t type;  // DECIMATE_xxx
+    uint16_t ratio;  // readings per saved data point
+    uint16_t count;  // readings since the last saved data point
+    int32_t sum;  // boxcar sum
+    uint64_t integrators[DECIMATE_CIC_ORDER];
+    uint64_t comb_delays[DECIMATE_CIC_ORDER];
+    uint64_t gain;  // ratio^3
+    uint8_t filling;  // comb outputs left to drop after a reset, the filter has not filled yet
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void decimate_set(uint8_t type, uint16_t ratio);
+void decimate_reset(void);
+uint8_t decimate_sample(int16_t reading, int16_t *output);
+
+#endif
+/* [] END OF FILE */
@@ -23,7 +23,10 @@
 #define EXPORT_LUT                      'l'
 #define EXPORT_STREAMING_DATA           'F'
 #define EXPORT_ADC_ARRAY                'E'
+#define EXPORT_ADC_RANGE                'e'
 #define CALIBRATE_TIA_ADC               'B'
+#define CALIBRATE_SWEEP                 'b'
+#define CALIBRATE_N_POINTS              'n'
 #define SET_PWM_TIMER_COMPARE           'C'
 #define SET_PWM_TIMER_PERIOD            'T'
 #define SET_TIA_ADC                     'A'
@@ -34,12 +37,28 @@
 #define CHANGE_NUMBER_ELECTRODES        'L'
 #define CHRONOAMPEROMETRY_HACK          'Q'
 #define MAKE_LOOK_UP_TABLE              'S'
+#define MAKE_LOOK_UP_TABLE_MV           'v'
 #define SET_DAC_VALUE                   'D'
 #define RUN_AMPEROMETRY                 'M'
 #define START_HARDWARE                  'H'
 #define SHORT_TIA                       's'
 #define STOP_SHORTING_TIA               'd'
 #define DPV_LUT                         'G'
+#define SET_EXPORT_FORMAT               'O'
+#define SET_DATA_ROUTE                  'u'
+#define EXPORT_STATUS                   'Y'
+#define PARTITION_ARENA                 'P'
+#define EXPORT_CALIBRATION_TABLE        'k'
+#define SET_CALIBRATION_SETTLING        'c'
+#define SET_AUTORANGE                   'a'
+#define EXPORT_AUTORANGE_LOG            'w'
+#define SET_WAKEUP_SETTLING             'W'
+#define SET_DECIMATION                  'f'
+#define SET_PEAK_DETECTION              'p'
+#define SET_CHRONOCOULOMETRY            'q'
+#define EXPORT_CHARGE                   'J'
+#define SET_BACKGROUND                  'K'
+#define SET_BLOCK_STATS                 'Z'
     
 // index of start of different parts of input string
 #define INDEX_START_VALUE               2
@@ -53,14 +72,43 @@
 #define INDEX_SWV_TIMER_VALUE           23
 #define INDEX_SWV_SWEEP_TYPE            28
 #define INDEX_SWV_START_VOLT_TYPE       29
+// Ranged export options
+#define INDEX_EXPORT_CHANNEL            2
+#define INDEX_EXPORT_OFFSET             4
+#define INDEX_EXPORT_COUNT              9
+// Arena partition options
+#define INDEX_ARENA_LUT_SIZE            2
+#define INDEX_ARENA_BUFFER_COUNT        8
+#define INDEX_ARENA_BUFFER_SIZE         11
+// Calibration settling options
+#define INDEX_SETTLE_TOLERANCE          2
+#define INDEX_SETTLE_STABLE_COUNT       7
+#define INDEX_SETTLE_AVERAGE_COUNT      10
+#define INDEX_SETTLE_TIMEOUT            13
+// Wake up settling options
+#define INDEX_WAKEUP_MIN_SETTLE         2
+#define INDEX_WAKEUP_MAX_SETTLE         8
+#define INDEX_WAKEUP_KEEP_WARM          14
+// Amperometry decimation options
+#define INDEX_DECIMATE_TYPE             2
+#define INDEX_DECIMATE_RATIO            4
+// Peak detection options
+#define INDEX_PEAKS_MODE                2
+#define INDEX_PEAKS_WINDOW              4
+#define INDEX_PEAKS_THRESHOLD           7
+#define INDEX_COULOMETRY_POINTS         2
+// Background subtraction options
+#define INDEX_BACKGROUND_MODE           2
+#define INDEX_BACKGROUND_BUFFER         4
+#define INDEX_BLOCK_STATS_MODE          2
 
 
 /**************************************
 *           ADC Constants
 **************************************/  
     
-// define how big to make the arrays for the lut for dac and how big
-// to make the adc data array     
+// default size of the look up table for the dac and the adc data buffers,
+// the SRAM for them is partitioned at run time, see arena.h
 #define MAX_LUT_SIZE 5000
 #define ADC_CHANNELS 4
  
@@ -72,6 +120,7 @@
 #define false                       0
     
 #define VIRTUAL_GROUND              2048  // TODO: make variable
+#define PWM_ISR_CLOCK_HZ            240000  // clock of PWM_isr that times the DAC and ADC isrs
 
 // Define the AMux channels
 #define two_electrode_config_ch     0
@@ -87,8 +136,14 @@
 #define VDAC_NOT_SET 0
 #define VDAC_IS_VDAC 1
 #define VDAC_IS_DVDAC 2
+#define VDAC_IS_MIDAC 3
+#define VDAC_IS_PIDAC 4
     
 #define VDAC_ADDRESS 0
+#define CONFIG_ADDRESS 0  // settings block, EEPROM rows 0 and 1, see struct DeviceConfig
+#define CONFIG_SIZE 32
+#define CONFIG_CRC_INDEX 30
+#define CONFIG_VERSION 1
     
 #define EEPROM_READ_TEMPERATURE_CORRECT        0
     
@@ -109,23 +164,11 @@ uint16_t dac_ground_value;  // value to load in the DAC
     
 /* Make global variables needed for the DAC/ADC interrupt service routines */
 uint16_t lut_value;  // value need to load DAC
-// add 5 to the lut to add a buffer cause a few functions go over the MAX_LUT_SIZE
-// by 1, and will use MAX_LUT_SIZE to check for over runs
-uint16_t waveform_lut[MAX_LUT_SIZE+5];  // look up table to store waveform for variable potential experiments
-union waveform_lut_union {
-    uint8_t usb[2*(MAX_LUT_SIZE+5)];
-    int16_t data[MAX_LUT_SIZE+5];
-};
+// the look up table (waveform_lut) and adc buffers (adc_buffers) are in arena.h
     
 uint16_t lut_index;  // look up table index
 
 /* Global structs */
-
-union data_usb_union {
-    uint8_t usb[2*MAX_LUT_SIZE];
-    int16_t data[MAX_LUT_SIZE];
-};
-union data_usb_union ADC_array[ADC_CHANNELS];  // allocate space to put adc measurements
     
 struct TIAMux {  // not used currently
     uint8_t use_extra_resistor;
@@ -10,15 +10,67 @@
  * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
 *********************************************************************************/
 
+#include <string.h>
 #include "helper_functions.h"
+#include "power.h"
+
+struct DeviceConfig device_config;
+
+/******************************************************************************
+* Function Name: helper_load_config
+*******************************************************************************
+*
+* Summary:
+*  Read the device settings from the EEPROM into device_config, called once at
+*  startup so the other functions use the copy in RAM.  If the CRC does not
+*  match, e.g. the firmware before this only saved the voltage source byte, the
+*  voltage source byte is kept and the other settings are set to their defaults.
+*  The EEPROM is not written until a setting is changed
+*
+* Global variables:
+*  device_config: settings loaded
+*
+*******************************************************************************/
+
+void helper_load_config(void) {
+    helper_Read_EEPROM((uint8_t*)&device_config, CONFIG_ADDRESS, CONFIG_SIZE);
+    if ((device_config.version == CONFIG_VERSION) &&
+        (device_config.crc == helper_crc16((uint8_t*)&device_config, CONFIG_CRC_INDEX))) {
+        return;
+    }
+    uint8_t voltage_source = device_config.voltage_source;
+    memset(&device_config, 0, CONFIG_SIZE);
+    if (voltage_source <= DAC_LAST_VOLTAGE_SOURCE) {
+        device_config.voltage_source = voltage_source;
+    }
+    device_config.version = CONFIG_VERSION;
+    device_config.crc = helper_crc16((uint8_t*)&device_config, CONFIG_CRC_INDEX);
+}
+
+/******************************************************************************
+* Function Name: helper_save_config
+*******************************************************************************
+*
+* Summary:
+*  Update the CRC of device_config and write it to the EEPROM, call after a
+*  setting is changed
+*
+* Return:
+*  CYRET_SUCCESS if the EEPROM rows were written
+*
+*******************************************************************************/
+
+uint8_t helper_save_config(void) {
+    device_config.crc = helper_crc16((uint8_t*)&device_config, CONFIG_CRC_INDEX);
+    return helper_Write_EEPROM((uint8_t*)&device_config, CONFIG_ADDRESS, CONFIG_SIZE);
+}
 
 /******************************************************************************
 * Function Name: helper_check_voltage_source
 *******************************************************************************
 *
 * Summary:
-*  Look in the EEPROM to for what Voltage source is selected
-  # TODO: dont look in eeprom first, check selected_voltage_source before going to the eeprom
+*  Get what Voltage source is selected from the settings loaded from the EEPROM
 *
 * Parameters:
 *
@@ -28,15 +80,16 @@
 *                     so 8-bit VDAC should be used
 *  VDAC_IS_DVDAC [2] - user has indicated and external capacitor is installed
 *                      so the dithering VDAC (DVDAC) should be set
+*  VDAC_IS_MIDAC [3] - 12-bit PWM dithered current DAC into a load resistor
+*  VDAC_IS_PIDAC [4] - 11-bit parallel current DACs into a load resistor
 *
 * Global variables:
-*  OUT_ENDPOINT:  number that is the endpoint coming out of the computer
+*  device_config: settings loaded by helper_load_config
 *
 *******************************************************************************/
 
 uint8_t helper_check_voltage_source(void) {
-    // start eeprom and read the value at voltage source address
-    return helper_Readbyte_EEPROM(VDAC_ADDRESS);
+    return device_config.voltage_source;
 }
 
 /******************************************************************************
@@ -45,33 +98,41 @@ uint8_t helper_check_voltage_source(void) {
 *
 * Summary:
 *  Set the voltage source.  Connects the analog mux to the correct channel and 
-*  stops the other voltage source if it was on and starts and puts to sleep the DAC
+*  stops the voltage source that was in use and starts and puts to sleep the DAC.
+*  The EEPROM is only written if the voltage source is changed.  Voltage sources
+*  the firmware was not built with are refused and nothing is changed, as is any
+*  change while a run or the timer holds the DAC in the power manager
 *
 * Parameters:
 *  uint8 voltage_source: which voltage source has been selected
 *
 * Global variables:
 *  selected_voltage_source:  which DAC is to be used
+*  device_config: settings saved in the EEPROM
+*
+* Return:
+*  true (1) if the voltage source was set, false (0) if it was refused
 *
 *******************************************************************************/
 
-void helper_set_voltage_source(uint8_t voltage_source) {
-    selected_voltage_source = voltage_source;
-    helper_Writebyte_EEPROM(voltage_source, VDAC_ADDRESS);
-    
-    if (selected_voltage_source == VDAC_IS_DVDAC) {
-        VDAC_source_Stop();  // incase the other DAC is on, turn it off
-        //LCD_Position(1,0);
-        //LCD_PrintString("DVDAC AMux");
-        
+uint8_t helper_set_voltage_source(uint8_t voltage_source) {
+    if (voltage_source > DAC_LAST_VOLTAGE_SOURCE) {  // e.g. the MIDAC and PIDAC, see DAC_CURRENT_DACS_ENABLED
+        return false;
+    }
+    if (power_held(POWER_DAC)) {  // restarting it would put the DAC to sleep under its holder
+        return false;
     }
-    else {
-        DVDAC_Stop();  // incase the other DAC is on, turn it off
-        //LCD_Position(1,0);
-        //LCD_PrintString("VDAC AMux");
+    selected_voltage_source = voltage_source;
+    if (device_config.voltage_source != voltage_source) {
+        device_config.voltage_source = voltage_source;
+        helper_save_config();
     }
+    
+    power_sleep_idle();  // a DAC kept warm after a run is put to sleep before it is changed
+    DAC_Stop();  // incase another DAC is on, turn it off
     DAC_Start();
     DAC_Sleep();
+    return true;
 }
 
 
@@ -125,6 +186,106 @@ uint8_t helper_Readbyte_EEPROM(uint16_t address) {
     return data;
 }
 
+/******************************************************************************
+* Function Name: helper_Write_EEPROM
+*******************************************************************************
+*
+* Summary:
+*    Write a block of bytes to the eeprom a row at a time, the bytes in the rows
+*    that are not part of the block are kept.  Much faster than writing each
+*    byte as the eeprom writes a whole row for every write
+*
+* Parameters:
+*     data: the bytes to write in
+*     address: the address to write the first byte at
+*     length: number of bytes to write
+*
+* Return:
+*     CYRET_SUCCESS if all the rows were written
+*
+*******************************************************************************/
+
+uint8_t helper_Write_EEPROM(const uint8_t data[], uint16_t address, uint16_t length) {
+    uint8_t row_data[CYDEV_EEPROM_ROW_SIZE];
+    uint8_t write_results = CYRET_SUCCESS;
+    EEPROM_Start();
+    CyDelayUs(10);
+    EEPROM_UpdateTemperature();
+    uint16_t i = 0;
+    while (i < length) {
+        uint16_t row = (address + i) / CYDEV_EEPROM_ROW_SIZE;
+        uint16_t row_start = row * CYDEV_EEPROM_ROW_SIZE;
+        for (uint8_t j = 0; j < CYDEV_EEPROM_ROW_SIZE; j++) {
+            row_data[j] = EEPROM_ReadByte(row_start + j);
+        }
+        while ((i < length) && (address + i < row_start + CYDEV_EEPROM_ROW_SIZE)) {
+            row_data[address + i - row_start] = data[i];
+            i++;
+        }
+        write_results |= EEPROM_Write(row_data, row);
+    }
+    EEPROM_Stop();
+    return write_results;
+}
+
+/******************************************************************************
+* Function Name: helper_Read_EEPROM
+*******************************************************************************
+*
+* Summary:
+*    Start the eepromm and read a block of bytes from it
+*
+* Parameters:
+*     data: array to put the bytes in
+*     address: the address of the first byte to read
+*     length: number of bytes to read
+*
+*******************************************************************************/
+
+void helper_Read_EEPROM(uint8_t data[], uint16_t address, uint16_t length) {
+    EEPROM_Start();
+    CyDelayUs(10);
+    EEPROM_UpdateTemperature();
+    CyDelayUs(10);
+    for (uint16_t i = 0; i < length; i++) {
+        data[i] = EEPROM_ReadByte(address + i);
+    }
+    EEPROM_Stop();
+}
+
+/******************************************************************************
+* Function Name: helper_crc16
+*******************************************************************************
+*
+* Summary:
+*    Calculate the CRC-16/CCITT-FALSE (polynomial 0x1021, start value 0xFFFF) of
+*    a block of bytes, this is the same as binascii.crc_hqx(data, 0xFFFF) in python
+*
+* Parameters:
+*     data: bytes to calculate the CRC of
+*     length: number of bytes
+*
+* Return:
+*     the CRC
+*
+*******************************************************************************/
+
+uint16_t helper_crc16(const uint8_t data[], uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x8000) {
+                crc = (crc << 1) ^ 0x1021;
+            }
+            else {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
+
 /******************************************************************************
 * Function Name: helper_HardwareSetup
 *******************************************************************************
@@ -173,30 +334,7 @@ void helper_HardwareStart(void){  // start all the components that have to be on
 }
 
 /******************************************************************************
-* Function Name: helper_HardwareWakeup
-*******************************************************************************
-*
-* Summary:
-*    Start all the hardware needed for an experiment.
-*
-*******************************************************************************/
-
-void helper_HardwareWakeup(void){  // wakeup all the components that have to be on for a reading
-    ADC_SigDel_Wakeup();
-    TIA_Wakeup();
-    VDAC_TIA_Wakeup();
-    DAC_Wakeup();
-    CyDelay(1);
-    DAC_SetValue(lut_value);
-    CyDelay(10);
-    Opamp_Aux_Wakeup();
-    
-    PWM_isr_Wakeup();
-    
-}
-
-/******************************************************************************
-* Function Name: helper_HardwareWakeup
+* Function Name: helper_HardwareSleep
 *******************************************************************************
 *
 * Summary:
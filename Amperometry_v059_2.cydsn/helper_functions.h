@@ -18,11 +18,27 @@
 #include "globals.h"
 #include "DAC.h"
     
+/***************************************
+*        Structs
+***************************************/
+
+/* Device settings kept in EEPROM rows 0 and 1, loaded into RAM once at startup.
+ * The voltage source stays at byte 0 (VDAC_ADDRESS) where the firmware saved it
+ * before.  The fields are on their natural alignment so the struct is the
+ * CONFIG_SIZE bytes in the EEPROM, little endian */
+struct DeviceConfig {
+    uint8_t voltage_source;  // VDAC_IS_VDAC, VDAC_IS_DVDAC, ...
+    uint8_t version;  // CONFIG_VERSION
+    uint8_t reserved[28];  // for more settings, e.g. the default TIA range
+    uint16_t crc;  // CRC16 of the first CONFIG_CRC_INDEX bytes
+};
+
 /***************************************
 *        Variables
 ***************************************/     
     
 extern uint8_t selected_voltage_source;
+extern struct DeviceConfig device_config;
 //extern struct RunParams run_params;
     
     
@@ -30,15 +46,19 @@ extern uint8_t selected_voltage_source;
 *        Function Prototypes
 ***************************************/ 
 
+void helper_load_config(void);
+uint8_t helper_save_config(void);
 uint8_t helper_check_voltage_source(void);
-void helper_set_voltage_source(uint8_t selected_voltage_source);
+uint8_t helper_set_voltage_source(uint8_t selected_voltage_source);
 uint8_t helper_Writebyte_EEPROM(uint8_t data, uint16_t address);
 uint8_t helper_Readbyte_EEPROM(uint16_t address);
+uint8_t helper_Write_EEPROM(const uint8_t data[], uint16_t address, uint16_t length);
+void helper_Read_EEPROM(uint8_t data[], uint16_t address, uint16_t length);
+uint16_t helper_crc16(const uint8_t data[], uint16_t length);
 
 void helper_HardwareSetup(void);
 void helper_HardwareStart(void);
 void helper_HardwareSleep(void);
-void helper_HardwareWakeup(void);
 
 
 #endif
@@ -207,7 +207,7 @@ uint16_t LUT_make_line(uint16_t start, uint16_t end, uint16_t index) {
             waveform_lut[index] = value;
             index ++;
             //printf("l: %i, %i\n", index, value);
-            if (index >= MAX_LUT_SIZE) {
+            if (index >= arena_lut_size) {
                 return index;
             }
         }
@@ -217,7 +217,7 @@ uint16_t LUT_make_line(uint16_t start, uint16_t end, uint16_t index) {
             waveform_lut[index] = value;
             index ++;
             //printf("b: %i, %i\n", index, value);
-            if (index >= MAX_LUT_SIZE) {
+            if (index >= arena_lut_size) {
                 return index;
             }
         }
@@ -254,7 +254,7 @@ uint16_t LUT_make_swv_line(uint16_t start, uint16_t end, uint16_t pulse_inc,
                            uint16_t pulse_height, uint16_t index) {
     printf("making swv linefrom: %i to %i \n", start, end);
     printf("inc: %i height: %i \n", pulse_inc, pulse_height);
-    if (index > MAX_LUT_SIZE) {
+    if (index > arena_lut_size) {
         return index;
     }
     // uint16_t half_pulse = pulse_height / 2;
@@ -265,7 +265,7 @@ uint16_t LUT_make_swv_line(uint16_t start, uint16_t end, uint16_t pulse_inc,
             waveform_lut[index] = value - pulse_height;
             index ++;
             printf("a: %i, %i\n", index, value);
-            if (index > MAX_LUT_SIZE) {
+            if (index > arena_lut_size) {
                return index;
             }
         }
@@ -277,7 +277,7 @@ uint16_t LUT_make_swv_line(uint16_t start, uint16_t end, uint16_t pulse_inc,
             waveform_lut[index] = value - pulse_height;
             index ++;
             printf("b: %i, %i\n", index, value);
-            if (index > MAX_LUT_SIZE) {
+            if (index > arena_lut_size) {
                 return index;
             }
         }
@@ -356,15 +356,15 @@ uint16_t LUT_make_dpv_depr(uint16_t start, uint16_t end, uint16_t height,
 
 void LUT_MakePulse(uint16_t base, uint16_t pulse) {
     int _lut_index = 0;
-    while (_lut_index < 1000) {
+    while ((_lut_index < 1000) && (_lut_index < arena_lut_size)) {
         waveform_lut[_lut_index] = base;
         _lut_index++;
     }
-    while (_lut_index < 2000) {
+    while ((_lut_index < 2000) && (_lut_index < arena_lut_size)) {
         waveform_lut[_lut_index] = pulse;
         _lut_index++;
     }
-    while (_lut_index < 4000) {
+    while ((_lut_index < 4000) && (_lut_index < arena_lut_size)) {
         waveform_lut[_lut_index] = base;
         _lut_index++;
     }
@@ -409,4 +409,53 @@ uint16_t LUT_Convert2Dec(const uint8_t array[], const uint8_t len){
     return num;
 }
 
+/******************************************************************************
+* Function Name: LUT_Convert2Signed
+*******************************************************************************
+*
+* Summary:
+*  Convert a sign ('+' or '-') followed by decimal digits into a number
+*
+* Parameters:
+*  const uint8_t array[]: the sign then len-1 digits
+*  const uint8_t len: number of chars, including the sign
+*
+* Return:
+*  int16_t: the number
+*
+*******************************************************************************/
+
+int16_t LUT_Convert2Signed(const uint8_t array[], const uint8_t len) {
+    int16_t num = LUT_Convert2Dec(&array[1], len-1);
+    if (array[0] == '-') {
+        return -num;
+    }
+    return num;
+}
+
+/******************************************************************************
+* Function Name: LUT_scan_rate_to_period
+*******************************************************************************
+*
+* Summary:
+*  Get the PWM_isr period that makes a look up table, that steps 1 DAC bit
+*  each isr, sweep at a scan rate
+*
+* Parameters:
+*  uint16_t mV_per_s: scan rate
+*  uint8_t mv_per_bit: millivolts of 1 bit of the DAC in use
+*
+* Return:
+*  uint32_t: PWM period, rounded.  0 if the scan rate is 0, the caller has to
+*            check it fits in the 16-bit PWM
+*
+*******************************************************************************/
+
+uint32_t LUT_scan_rate_to_period(uint16_t mV_per_s, uint8_t mv_per_bit) {
+    if (mV_per_s == 0) {
+        return 0;
+    }
+    return ((uint32_t)PWM_ISR_CLOCK_HZ * mv_per_bit + mV_per_s/2) / mV_per_s;
+}
+
 /* [] END OF FILE */
@@ -17,6 +17,7 @@
 #include "stdio.h"  // remove after testing
     
 // Local files
+#include "arena.h"
 #include "globals.h"
 #include "helper_functions.h"
 
@@ -41,13 +42,14 @@ uint16_t LUT_make_swv_line(uint16_t start, uint16_t end, uint16_t pulse_inc,
                          uint16_t pulse_height, uint16_t index);
 struct RunParams LUT_make_run_params(const uint8_t data_buffer[], struct RunParams *run_params);
 uint16_t LUT_Convert2Dec(const uint8_t array[], const uint8_t len);
+int16_t LUT_Convert2Signed(const uint8_t array[], const uint8_t len);
+uint32_t LUT_scan_rate_to_period(uint16_t mV_per_s, uint8_t mv_per_bit);
 
 
 /***************************************
 * Global variables external identifier
 ***************************************/
 extern uint16_t lut_value;  // value need to load DAC
-extern uint16_t waveform_lut[];
 extern uint16_t dac_ground_value;  // value to load in the DAC
 
     
@@ -15,11 +15,21 @@
 #include "stdlib.h"
 
 // local files
+#include "arena.h"
+#include "autorange.h"
+#include "background.h"
+#include "block_stats.h"
 #include "calibrate.h"
+#include "coulometry.h"
 #include "DAC.h"
+#include "data_export.h"
+#include "decimate.h"
 #include "globals.h"
 #include "helper_functions.h"
 #include "lut_protocols.h"
+#include "peaks.h"
+#include "power.h"
+#include "telemetry.h"
 #include "usb_protocols.h"
 #include "user_selections.h"
 
@@ -53,38 +63,96 @@ uint16_t buffer_size_bytes;  // number of bytes of data stored to export for amp
 // for amperometry experiments, how many data points to save before exporting the adc buffer
 uint16_t buffer_size_data_pts = 4000;  // prevent the isr from firing by initializing to 4000
 uint16_t dac_value_hold = 0;
+volatile uint8_t run_done = false;  // set by the DAC isr so the main loop can finish the run
 
 
-CY_ISR(dacInterrupt)
+/* The look up table has been put out, stop the run.  Called by the DAC isrs */
+static void dac_run_done(void) {
+    isr_adc_Disable();
+    isr_dac_Disable();
+    adc_buffers[0][lut_index] = 0xC000;  // mark that the data array is done
+    power_release(POWER_HOLDER_RUN, POWER_RUN_BLOCKS);  // kept warm in case another run starts
+    autorange_stop();
+    background_run_done();
+    lut_index = 0; 
+    USB_Export_Data((uint8_t*)"Done", 5); // calls a function in an isr but only after the current isr has been disabled
+    run_done = true;
+}
+
+/* There is a DAC isr for each DAC so the isr calls the DAC directly instead of
+ * checking which DAC is used every sample, DAC_Start picks the isr to use */
+CY_ISR(dacInterruptVdac)
+{
+    VDAC_source_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) { // all the data points have been given
+        dac_run_done();
+    }
+    lut_value = waveform_lut[lut_index];
+}
+
+CY_ISR(dacInterruptDvdac)
+{
+    DVDAC_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) { // all the data points have been given
+        dac_run_done();
+    }
+    lut_value = waveform_lut[lut_index];
+}
+
+#if DAC_CURRENT_DACS_ENABLED
+CY_ISR(dacInterruptMidac)
 {
-    DAC_SetValue(lut_value);
+    MIDAC_source_SetValue(lut_value);
     lut_index++;
     if (lut_index >= lut_length) { // all the data points have been given
-        isr_adc_Disable();
-        isr_dac_Disable();
-        ADC_array[0].data[lut_index] = 0xC000;  // mark that the data array is done
-        helper_HardwareSleep();
-        lut_index = 0; 
-        USB_Export_Data((uint8_t*)"Done", 5); // calls a function in an isr but only after the current isr has been disabled
+        dac_run_done();
     }
     lut_value = waveform_lut[lut_index];
 }
+
+CY_ISR(dacInterruptPidac)
+{
+    PIDAC_source_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) { // all the data points have been given
+        dac_run_done();
+    }
+    lut_value = waveform_lut[lut_index];
+}
+#endif
+
 CY_ISR(adcInterrupt){
-    ADC_array[0].data[lut_index] = ADC_SigDel_GetResult16(); 
+    int16_t reading = ADC_SigDel_GetResult16();
+    adc_buffers[0][lut_index] = background_sample(reading, lut_index); 
+    telemetry.samples_acquired++;
+    autorange_sample(reading, 0, lut_index);
+    // the DAC is still at the look up table value before lut_index, see export_swv_steps
+    coulometry_sample(adc_buffers[0][lut_index], waveform_lut[lut_index ? lut_index-1 : 0]);
 }
 
 CY_ISR(adcAmpInterrupt){
-    ADC_array[adc_recording_channel].data[lut_index] = ADC_SigDel_GetResult16(); 
+    int16_t reading;
+    if (!decimate_sample(ADC_SigDel_GetResult16(), &reading)) {
+        return;  // the filter needs more readings for the next data point
+    }
+    adc_buffers[adc_recording_channel][lut_index] = reading; 
+    autorange_sample(adc_buffers[adc_recording_channel][lut_index], adc_recording_channel, lut_index);
     lut_index++;  
+    telemetry.samples_acquired++;
     if (lut_index >= buffer_size_data_pts) {
-        ADC_array[adc_recording_channel].data[lut_index] = 0xC000; 
+        adc_buffers[adc_recording_channel][lut_index] = 0xC000; 
         // counter += 1;  // for debug
         lut_index = 0;
         adc_hold = adc_recording_channel;
-        adc_recording_channel = (adc_recording_channel + 1) % ADC_CHANNELS;
+        telemetry_buffer_filled(adc_hold);
+        adc_recording_channel = (adc_recording_channel + 1) % arena_adc_buffer_count;
         
-        sprintf(usb_str, "Done%d", adc_hold);  // tell the user the data is ready to pick up and which channel its on
-        USB_Export_Data((uint8_t*)usb_str, 6);  // use the 'F' command to retreive the data
+        if (!block_stats_block_filled(adc_hold)) {  // the main loop sends the statistics instead
+            sprintf(usb_str, "Done%d", adc_hold);  // tell the user the data is ready to pick up and which channel its on
+            USB_Export_Data((uint8_t*)usb_str, 6);  // use the 'F' command to retreive the data
+        }
     }
 }
 
@@ -95,12 +163,18 @@ int main() {
 //    LCD_ClearDisplay();
 //    LCD_PrintString("DPV1");
     
+    arena_partition(MAX_LUT_SIZE, ADC_CHANNELS, MAX_LUT_SIZE);  // same layout as the old fixed arrays
     USBUART_Start(0, USBUART_5V_OPERATION);
+    telemetry_start();
+    helper_load_config();  // the only EEPROM read of the settings, DAC_Start uses the copy in RAM
     helper_HardwareSetup();
     ADC_SigDel_SelectConfiguration(2, DO_NOT_RESTART_ADC);
+    export_set_resolution(2);
+    calibrate_load_table();  // the only EEPROM read of the calibrations, 'A' uses the copy in RAM
+    calibrate_update_conversion();  // load the calibration of the starting TIA and ADC settings
     while(!USBUART_GetConfiguration());  
     
-    isr_dac_StartEx(dacInterrupt);
+    isr_dac_StartEx(dac_ops->isr);  // the isr for the DAC helper_HardwareSetup started
     isr_dac_Disable();  // disable interrupt until a voltage signal needs to be given
     isr_adc_StartEx(adcInterrupt);
     isr_adc_Disable();
@@ -115,6 +189,12 @@ int main() {
     
     for(;;) {
         //CyWdtClear();
+        power_service();  // put the analog blocks to sleep after the last run
+        if (run_done) {  // send the peaks of the run if the host asked for them
+            run_done = false;
+            peaks_run_done(adc_buffers[0], waveform_lut, lut_length);
+        }
+        block_stats_service(buffer_size_data_pts);  // send the statistics of the filled amperometry buffers
 
         if (Input_Flag == false) {  // make sure any input has already been dealt with
             Input_Flag = USB_CheckInput(OUT_Data_Buffer);  // check if there is a response from the computer
@@ -128,22 +208,50 @@ int main() {
                 
             case EXPORT_STREAMING_DATA: ; // 'F' User wants to export streaming data         
                 uint8 user_ch1 = OUT_Data_Buffer[1]-'0';
-                USB_Export_Data(&ADC_array[user_ch1].usb[0], buffer_size_bytes); 
+                int16_t *amp_samples = arena_adc_range(user_ch1, 0, buffer_size_bytes / 2);
+                if (amp_samples && buffer_size_bytes) {  // buffer_size_bytes is 0 until 'M' sets it
+                    export_marked_samples(amp_samples, buffer_size_bytes / 2 - 1);  // the last sample is the 0xC000 marker
+                    telemetry_buffer_exported(user_ch1);
+                }
+                else {
+                    USB_Export_Data((uint8*)"Error Exporting", 16);
+                }
                 break;
                 
             case EXPORT_ADC_ARRAY: ; // 'E' User wants to export the data, the user can choose what ADC array to export
                 uint8 user_ch = OUT_Data_Buffer[1]-'0';
-                if (user_ch <= ADC_CHANNELS) { // check for buffer overflow
-                    // 2*(lut_length+2) because the data is 2 times as long as it has to 
-                    // be sent as 8-bits and the data is 16 bit, +1 is for the 0xC000 finished signal
-                    USB_Export_Data(&ADC_array[user_ch].usb[0], 2*(lut_length+1));  
-                    ADC_array[user_ch].data[0] = lut_length;
+                int16_t *cv_samples = arena_adc_range(user_ch, 0, lut_length+1);
+                if (cv_samples) { // check for buffer overflow
+                    // lut_length+1 samples, +1 is for the 0xC000 finished signal
+                    export_run_samples(cv_samples, lut_length);
+                    telemetry_buffer_exported(user_ch);
+                    cv_samples[0] = lut_length;
                     //USB_Export_Data(&ADC_array[user_ch].usb[0], 2*(lut_length+1));  
                 }
                 else {
                     USB_Export_Data((uint8*)"Error Exporting", 16);
                 }
                 break;
+            case EXPORT_ADC_RANGE: ; // 'e' export only part of an ADC array, e.g. the samples not read yet
+                user_export_adc_range(OUT_Data_Buffer);
+                break;
+            case SET_EXPORT_FORMAT: ; // 'O' choose if the ADC data is exported as 16-bit or packed numbers
+                if (autorange_enabled() && (OUT_Data_Buffer[2]-'0' == EXPORT_FORMAT_PICOAMPS)) {
+                    USB_Export_Data((uint8*)"Error Autorange", 16);  // the pA would use the 'A' range for every sample
+                }
+                else {
+                    export_set_format(OUT_Data_Buffer[2]-'0');
+                }
+                break;
+            case SET_DATA_ROUTE: ; // 'u' choose if the ADC data is sent through the CDC or the streaming endpoint
+                user_set_data_route(OUT_Data_Buffer);
+                break;
+            case EXPORT_STATUS: ; // 'Y' send the telemetry counters, can be used during a run
+                user_export_status();
+                break;
+            case PARTITION_ARENA: ; // 'P' split the SRAM between the look up table and the adc buffers
+                user_partition_arena(OUT_Data_Buffer);
+                break;
             case EXPORT_LUT: ; // 'l' expport Look up table
                 user_export_lut(OUT_Data_Buffer);
                 break;
@@ -153,6 +261,63 @@ int main() {
             case CALIBRATE_TIA_ADC: ; // 'B' calibrate the TIA / ADC current measuring circuit
                 calibrate_TIA();
                 break;
+            case CALIBRATE_SWEEP: ; // 'b' calibrate every TIA resistor and ADC buffer gain in one run
+                calibrate_sweep();
+                break;
+            case CALIBRATE_N_POINTS: ; // 'n' calibrate with more points and fit a line on the device
+                calibrate_n_points(LUT_Convert2Dec(&OUT_Data_Buffer[2], 2));
+                break;
+            case SET_CALIBRATION_SETTLING: ; // 'c' set how the calibration decides the ADC has settled
+                calibrate_set_settling(LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_SETTLE_TOLERANCE], 4),
+                                       LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_SETTLE_STABLE_COUNT], 2),
+                                       LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_SETTLE_AVERAGE_COUNT], 2),
+                                       LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_SETTLE_TIMEOUT], 4));
+                break;
+            case SET_WAKEUP_SETTLING: ; // 'W' set how long the electrode settles before a run and the hardware stays warm after
+                power_set_settling(LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_WAKEUP_MIN_SETTLE], 5),
+                                   LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_WAKEUP_MAX_SETTLE], 5),
+                                   LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_WAKEUP_KEEP_WARM], 5));
+                break;
+            case SET_BACKGROUND: ; // 'K' save a blank run or take it off the next runs
+                user_set_background(OUT_Data_Buffer);
+                break;
+            case SET_CHRONOCOULOMETRY: ; // 'q' integrate the current of the next runs, for a 'Q' pulse
+                coulometry_set(LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_COULOMETRY_POINTS], 5));
+                break;
+            case EXPORT_CHARGE: ; // 'J' send the charge trace of the last run
+                coulometry_export();
+                break;
+            case SET_PEAK_DETECTION: ; // 'p' choose if the peaks of each voltammetry run are sent after it is done
+                if (autorange_enabled() && ((OUT_Data_Buffer[INDEX_PEAKS_MODE]-'0' == PEAKS_SUMMARY) ||
+                                            (OUT_Data_Buffer[INDEX_PEAKS_MODE]-'0' == PEAKS_SUMMARY_AND_DATA))) {
+                    USB_Export_Data((uint8*)"Error Autorange", 16);  // the peak currents use the 'A' range
+                }
+                else {
+                    peaks_set(OUT_Data_Buffer[INDEX_PEAKS_MODE]-'0', LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_PEAKS_WINDOW], 2),
+                              LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_PEAKS_THRESHOLD], 5));
+                }
+                break;
+            case SET_BLOCK_STATS: ; // 'Z' send the statistics of each amperometry buffer instead of "DoneX"
+                block_stats_set(OUT_Data_Buffer[INDEX_BLOCK_STATS_MODE]-'0');
+                break;
+            case SET_DECIMATION: ; // 'f' average the amperometry readings down before they are saved
+                decimate_set(OUT_Data_Buffer[INDEX_DECIMATE_TYPE]-'0',
+                             LUT_Convert2Dec(&OUT_Data_Buffer[INDEX_DECIMATE_RATIO], 4));
+                break;
+            case SET_AUTORANGE: ; // 'a' turn the automatic TIA / ADC gain ranging on or off
+                if ((OUT_Data_Buffer[2] == '1') && ((export_get_format() == EXPORT_FORMAT_PICOAMPS) || peaks_enabled())) {
+                    USB_Export_Data((uint8*)"Error Autorange", 16);  // turn off the pA format and the peaks first
+                }
+                else {
+                    autorange_enable(OUT_Data_Buffer[2] == '1');
+                }
+                break;
+            case EXPORT_AUTORANGE_LOG: ; // 'w' send the range changes of the last run
+                autorange_export_log();
+                break;
+            case EXPORT_CALIBRATION_TABLE: ; // 'k' send the calibration table saved in the EEPROM
+                calibrate_export_table();
+                break;
             case SET_PWM_TIMER_COMPARE: ;  // 'C' change the compare value of the PWM to start the adc isr
                 PWM_isr_WriteCompare(LUT_Convert2Dec(&OUT_Data_Buffer[2], 5));
                 break;
@@ -185,6 +350,9 @@ int main() {
             case MAKE_LOOK_UP_TABLE: ; // 'S' make a look up table (lut) for a cyclic voltammetry experiment
                 lut_length = user_lookup_table_maker(OUT_Data_Buffer);
                 break; 
+            case MAKE_LOOK_UP_TABLE_MV: ; // 'v' make a cyclic voltammetry look up table from mV and mV/s
+                lut_length = user_lookup_table_maker_mV(OUT_Data_Buffer);
+                break;
             case SET_DAC_VALUE: ; // 'D' set the dac value
                 DAC_SetValue(LUT_Convert2Dec(&OUT_Data_Buffer[2], 4));
                 break;
@@ -194,7 +362,7 @@ int main() {
                 buffer_size_bytes = 2*(buffer_size_data_pts + 1); // add 1 bit for the termination code and double size for bytes from uint16 data
                 break;
             case START_HARDWARE: ; // 'H' Start all of the hardware, used to start ASV run
-                helper_HardwareWakeup();
+                power_wakeup_run(lut_value);
                 break;
             case SHORT_TIA: ;  // 's' user wants to short the TIA
                 AMux_TIA_input_Connect(2);
@@ -0,0 +1,245 @@
+/*******************************************************************************
+* File Name: peaks.c
+*
+* Description:
+*  Find the peaks of a voltammetry run after it is done.  The run is split into
+*  sweeps where the look up table changes direction, each sweep is smoothed with
+*  a moving average and the peaks are found with a threshold so the noise does
+*  not count as a peak: a peak is only saved once the current has come back down
+*  by the threshold after it.  Meant for the cyclic voltammetry and linear sweep
+*  look up tables, the steps of a square wave look up table are too short to count
+*  as sweeps
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "peaks.h"
+#include "DAC.h"
+#include "data_export.h"
+#include "usb_protocols.h"
+
+static uint8_t peaks_mode = PEAKS_OFF;
+static uint8_t window = PEAKS_DEFAULT_WINDOW;
+static uint16_t threshold = PEAKS_DEFAULT_THRESHOLD;
+static struct PeaksSummary summary;
+
+/***************************************
+*        Forward function references
+***************************************/
+static void peaks_find_in_sweep(const int16_t samples[], const uint16_t lut[], uint16_t start,
+                                uint16_t end, int8_t direction, struct PeaksSummary *summary);
+
+/******************************************************************************
+* Function Name: peaks_set
+*******************************************************************************
+*
+* Summary:
+*  Set what is sent after a voltammetry run and how the peaks are found
+*
+* Parameters:
+*  uint8_t mode: PEAKS_OFF, PEAKS_SUMMARY or PEAKS_SUMMARY_AND_DATA, unknown modes
+*                turn it off
+*  uint8_t window: data points in the moving average, made odd and limited to
+*                  PEAKS_MAX_WINDOW so it is centered on a data point
+*  uint16_t threshold: ADC counts the smoothed current has to fall after a peak
+*
+*******************************************************************************/
+
+void peaks_set(uint8_t mode, uint8_t _window, uint16_t _threshold) {
+    if (mode > PEAKS_SUMMARY_AND_DATA) {
+        mode = PEAKS_OFF;
+    }
+    if (_window > PEAKS_MAX_WINDOW) {
+        _window = PEAKS_MAX_WINDOW;
+    }
+    if ((_window % 2) == 0) {
+        _window++;
+    }
+    peaks_mode = mode;
+    window = _window;
+    threshold = _threshold;
+}
+
+/******************************************************************************
+* Function Name: peaks_enabled
+*******************************************************************************
+*
+* Summary:
+*  Check if the peaks are found after each voltammetry run
+*
+* Return:
+*  uint8_t: true (1) if the mode is not PEAKS_OFF
+*
+*******************************************************************************/
+
+uint8_t peaks_enabled(void) {
+    return (peaks_mode != PEAKS_OFF);
+}
+
+/******************************************************************************
+* Function Name: peaks_find
+*******************************************************************************
+*
+* Summary:
+*  Find the peaks of a cyclic voltammetry or linear sweep run.  Other look up
+*  tables, e.g. square wave, turn around every step so each step is a sweep too
+*  short to smooth, they give no peaks and the sweeps stop counting at 255.
+*  The ADC reading taken while the DAC
+*  holds look up table entry i is sample i+1, see export_swv_steps, so the
+*  samples are read from 1 to lut_length-1.  The potential and current of each
+*  peak are not filled in, see peaks_run_done
+*
+* Parameters:
+*  const int16_t samples[]: ADC buffer of the run
+*  const uint16_t lut[]: look up table of the run
+*  uint16_t lut_length: number of look up table entries that were run
+*  struct PeaksSummary *summary: where to put the peaks
+*
+*******************************************************************************/
+
+void peaks_find(const int16_t samples[], const uint16_t lut[], uint16_t lut_length,
+                struct PeaksSummary *summary) {
+    summary->version = PEAKS_VERSION;
+    summary->count = 0;
+    summary->sweeps = 0;
+    summary->dropped = 0;
+    if (lut_length < 3) {
+        return;
+    }
+    uint16_t start = 1;
+    int8_t direction = 0;
+    for (uint16_t i = 2; i < lut_length; i++) {
+        int8_t step = 0;
+        if (lut[i-1] > lut[i-2]) {
+            step = 1;
+        }
+        else if (lut[i-1] < lut[i-2]) {
+            step = -1;
+        }
+        if ((step != 0) && (direction != 0) && (step != direction)) {  // the sweep turned around
+            peaks_find_in_sweep(samples, lut, start, i, direction, summary);
+            start = i;
+        }
+        if (step != 0) {
+            direction = step;
+        }
+    }
+    peaks_find_in_sweep(samples, lut, start, lut_length, direction, summary);
+}
+
+/******************************************************************************
+* Function Name: peaks_run_done
+*******************************************************************************
+*
+* Summary:
+*  Send the peak summary of a voltammetry run, and the data of the run if the
+*  host asked for it, called by the main loop after the DAC isr ends the run.
+*  The potentials are converted with the DAC in use and the currents with the
+*  same calibration as the picoamp export format
+*
+* Parameters:
+*  const int16_t samples[]: ADC buffer of the run
+*  const uint16_t lut[]: look up table of the run
+*  uint16_t lut_length: number of look up table entries that were run
+*
+*******************************************************************************/
+
+void peaks_run_done(const int16_t samples[], const uint16_t lut[], uint16_t lut_length) {
+    if (peaks_mode == PEAKS_OFF) {
+        return;
+    }
+    peaks_find(samples, lut, lut_length, &summary);
+    for (uint8_t i = 0; i < summary.count; i++) {
+        struct PeaksEntry *peak = &summary.peaks[i];
+        peak->potential_mV = ((int16_t)peak->dac_value - (int16_t)dac_ops->ground_value) * dac_ops->mv_per_bit;
+        peak->current_pA = export_counts_to_pA(peak->counts);
+    }
+    USB_Export_Data((uint8_t*)&summary, PEAKS_HEADER_SIZE + summary.count*PEAKS_ENTRY_SIZE);
+    if (peaks_mode == PEAKS_SUMMARY_AND_DATA) {
+        export_run_samples(samples, lut_length);
+    }
+}
+
+/******************************************************************************
+* Function Name: peaks_find_in_sweep
+*******************************************************************************
+*
+* Summary:
+*  Find the peaks of one sweep.  A sweep to lower DAC values is flipped so its
+*  peaks are minimums.  The moving average is kept as a sum so the threshold is
+*  compared in the same units without a divide for every data point
+*
+* Parameters:
+*  const int16_t samples[]: ADC buffer of the run
+*  const uint16_t lut[]: look up table of the run
+*  uint16_t start: first sample of the sweep
+*  uint16_t end: sample after the sweep
+*  int8_t direction: 1 for a sweep to higher DAC values, -1 for lower
+*  struct PeaksSummary *summary: where to put the peaks
+*
+*******************************************************************************/
+
+static void peaks_find_in_sweep(const int16_t samples[], const uint16_t lut[], uint16_t start,
+                                uint16_t end, int8_t direction, struct PeaksSummary *summary) {
+    uint8_t sweep = summary->sweeps;
+    if (summary->sweeps < 0xFF) {  // a square wave or pulse table turns around every step
+        summary->sweeps++;
+    }
+    if (end - start < window) {  // too short to smooth
+        return;
+    }
+    uint8_t half = window / 2;
+    int32_t sum_threshold = (int32_t)threshold * window;
+    int32_t sum = 0;
+    for (uint16_t i = start; i < start + window; i++) {
+        sum += samples[i];
+    }
+    uint8_t looking_for_peak = false;  // the current has to rise by the threshold before a peak
+    int32_t extreme = direction * sum;
+    uint16_t extreme_index = start + half;
+    for (uint16_t center = start + half; center + half < end; center++) {
+        if (center > start + half) {
+            sum += samples[center + half] - samples[center - half - 1];
+        }
+        int32_t value = direction * sum;
+        if (looking_for_peak) {
+            if (value > extreme) {
+                extreme = value;
+                extreme_index = center;
+            }
+            else if (value < extreme - sum_threshold) {
+                if (summary->count < PEAKS_MAX) {
+                    struct PeaksEntry *peak = &summary->peaks[summary->count];
+                    int32_t smoothed = direction * extreme;
+                    peak->sample_index = extreme_index;
+                    peak->dac_value = lut[extreme_index - 1];
+                    // round the average to the nearest count
+                    peak->counts = (smoothed >= 0) ? (smoothed + half) / window : -((-smoothed + half) / window);
+                    peak->sweep = sweep;
+                    peak->direction = direction;
+                    peak->potential_mV = 0;
+                    peak->current_pA = 0;
+                    peak->reserved = 0;
+                    summary->count++;
+                }
+                else if (summary->dropped < 0xFF) {
+                    summary->dropped++;
+                }
+                looking_for_peak = false;
+                extreme = value;
+            }
+        }
+        else if (value < extreme) {
+            extreme = value;
+        }
+        else if (value > extreme + sum_threshold) {
+            looking_for_peak = true;
+            extreme = value;
+            extreme_index = center;
+        }
+    }
+}
+
+/* [] END OF FILE */
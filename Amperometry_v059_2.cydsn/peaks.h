@@ -0,0 +1,77 @@
+/*******************************************************************************
+* File Name: peaks.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to find the
+*  peaks of a cyclic voltammetry or linear sweep run on the device, so a
+*  screening run only has to send the peak potentials and currents
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(PEAKS_H)
+#define PEAKS_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+#include "globals.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define PEAKS_OFF                   0  // nothing is sent after a run
+#define PEAKS_SUMMARY               1  // the peak summary is sent after "Done"
+#define PEAKS_SUMMARY_AND_DATA      2  // the summary then the data of the run, like the 'E' command
+
+#define PEAKS_VERSION               1
+#define PEAKS_MAX                   16
+#define PEAKS_MAX_WINDOW            31  // longest moving average, in data points
+#define PEAKS_DEFAULT_WINDOW        5
+#define PEAKS_DEFAULT_THRESHOLD     64  // ADC counts
+#define PEAKS_HEADER_SIZE           4
+#define PEAKS_ENTRY_SIZE            16
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* A peak, the smoothed current is a maximum of a sweep to higher DAC values
+ * or a minimum of a sweep to lower DAC values.  The fields are on their
+ * natural alignment so each entry is the 16 bytes sent to the host */
+struct PeaksEntry {
+    uint16_t sample_index;  // where in ADC buffer 0 the peak is
+    uint16_t dac_value;  // look up table value the peak was measured at
+    int16_t potential_mV;
+    int16_t counts;  // smoothed ADC reading
+    int32_t current_pA;  // smoothed reading converted like the picoamp export format
+    uint8_t sweep;  // which sweep of the run, from 0, 255 for every sweep after 254
+    int8_t direction;  // 1 for a sweep to higher DAC values, -1 for lower
+    uint16_t reserved;
+};
+
+/* What the host gets after a run, only the header and the count entries are sent */
+struct PeaksSummary {
+    uint8_t version;  // PEAKS_VERSION
+    uint8_t count;  // peaks found
+    uint8_t sweeps;  // sweeps in the run, up to 255
+    uint8_t dropped;  // peaks that did not fit
+    struct PeaksEntry peaks[PEAKS_MAX];
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void peaks_set(uint8_t mode, uint8_t window, uint16_t threshold);
+uint8_t peaks_enabled(void);
+void peaks_find(const int16_t samples[], const uint16_t lut[], uint16_t lut_length,
+                struct PeaksSummary *summary);
+void peaks_run_done(const int16_t samples[], const uint16_t lut[], uint16_t lut_length);
+
+#endif
+/* [] END OF FILE */
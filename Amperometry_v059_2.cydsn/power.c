@@ -0,0 +1,309 @@
+/*******************************************************************************
+* File Name: power.c
+*
+* Description:
+*  Power the analog blocks.  Each block has a set of holders, the parts of the
+*  firmware (a run, the calibration, ...) that need it, it is woken when the
+*  first holder acquires it and put to sleep when no one has held it for
+*  keep_warm_ms, so back to back runs do not sleep and wake the analog chain.
+*  
+*  Wake up the analog blocks for a run.  The blocks that do not depend on each
+*  other are woken at the same time and the ADC starts converting while the
+*  electrode settles, so the wake up takes about the longest settle time instead
+*  of the sum of them.  The time it took is put in the telemetry for the host
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <stdlib.h>
+#include "power.h"
+#include "DAC.h"
+#include "telemetry.h"
+
+/* functions of each block, in the order of the POWER_xxx bits */
+struct PowerBlock {
+    void (*wakeup)(void);
+    void (*sleep)(void);
+};
+
+static const struct PowerBlock power_blocks[POWER_BLOCKS] = {
+    {ADC_SigDel_Wakeup, ADC_SigDel_Sleep},
+    {TIA_Wakeup, TIA_Sleep},
+    {VDAC_TIA_Wakeup, VDAC_TIA_Sleep},
+    {DAC_Wakeup, DAC_Sleep},
+    {Opamp_Aux_Wakeup, Opamp_Aux_Sleep},
+    {PWM_isr_Wakeup, PWM_isr_Sleep}
+};
+
+static struct PowerTiming timing = {POWER_DAC_SETTLE_US, POWER_MIN_SETTLE_MS, POWER_MAX_SETTLE_MS,
+                                    POWER_KEEP_WARM_MS};
+static uint8_t holders[POWER_BLOCKS];  // POWER_HOLDER_xxx bits of each block
+static uint8_t awake = 0;  // POWER_xxx bits of the blocks that are woken
+static uint32_t released_us;  // when a block was last released
+
+/***************************************
+* Forward function references
+***************************************/
+static void power_wait_until(uint32_t start_us, uint32_t wait_us);
+static uint8_t power_wait_adc(void);
+
+/******************************************************************************
+* Function Name: power_acquire
+*******************************************************************************
+*
+* Summary:
+*  Hold blocks awake, the blocks that are asleep are woken.  Can be called from
+*  an isr
+*
+* Parameters:
+*  uint8_t holder: POWER_HOLDER_xxx of the part of the firmware that needs the blocks
+*  uint8_t blocks: POWER_xxx bits of the blocks
+*
+* Return:
+*  uint8_t: POWER_xxx bits of the blocks that were asleep and had to be woken
+*
+*******************************************************************************/
+
+uint8_t power_acquire(uint8_t holder, uint8_t blocks) {
+    uint8_t woken = 0;
+    uint8 interrupts = CyEnterCriticalSection();
+    for (uint8_t i = 0; i < POWER_BLOCKS; i++) {
+        uint8_t bit = 1 << i;
+        if (blocks & bit) {
+            holders[i] |= holder;
+            if (!(awake & bit)) {
+                power_blocks[i].wakeup();
+                woken |= bit;
+            }
+        }
+    }
+    awake |= blocks;
+    telemetry.powered_blocks = awake;
+    CyExitCriticalSection(interrupts);
+    return woken;
+}
+
+/******************************************************************************
+* Function Name: power_release
+*******************************************************************************
+*
+* Summary:
+*  Let go of blocks.  The blocks no one else holds stay awake for keep_warm_ms
+*  in case another run starts, power_service puts them to sleep after that.  Can
+*  be called from an isr
+*
+* Parameters:
+*  uint8_t holder: POWER_HOLDER_xxx that acquired the blocks
+*  uint8_t blocks: POWER_xxx bits of the blocks
+*
+*******************************************************************************/
+
+void power_release(uint8_t holder, uint8_t blocks) {
+    uint8 interrupts = CyEnterCriticalSection();
+    for (uint8_t i = 0; i < POWER_BLOCKS; i++) {
+        if (blocks & (1 << i)) {
+            holders[i] &= ~holder;
+        }
+    }
+    released_us = telemetry_time_us();
+    CyExitCriticalSection(interrupts);
+    if (timing.keep_warm_ms == 0) {
+        power_sleep_idle();
+    }
+}
+
+/******************************************************************************
+* Function Name: power_service
+*******************************************************************************
+*
+* Summary:
+*  Put to sleep the blocks no one has held for keep_warm_ms, called by the main loop
+*
+*******************************************************************************/
+
+void power_service(void) {
+    uint8 interrupts = CyEnterCriticalSection();
+    uint32_t idle_us = telemetry_time_us() - released_us;
+    CyExitCriticalSection(interrupts);
+    if (idle_us >= (uint32_t)timing.keep_warm_ms * 1000) {
+        power_sleep_idle();
+    }
+}
+
+/******************************************************************************
+* Function Name: power_sleep_idle
+*******************************************************************************
+*
+* Summary:
+*  Put to sleep the blocks that are awake and that no one holds now
+*
+*******************************************************************************/
+
+void power_sleep_idle(void) {
+    uint8 interrupts = CyEnterCriticalSection();
+    for (uint8_t i = 0; i < POWER_BLOCKS; i++) {
+        uint8_t bit = 1 << i;
+        if ((awake & bit) && (holders[i] == 0)) {
+            power_blocks[i].sleep();
+            awake &= ~bit;
+        }
+    }
+    telemetry.powered_blocks = awake;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: power_awake
+*******************************************************************************
+*
+* Summary:
+*  Get which blocks are awake
+*
+* Return:
+*  uint8_t: POWER_xxx bits of the blocks that are awake
+*
+*******************************************************************************/
+
+uint8_t power_awake(void) {
+    return awake;
+}
+
+/******************************************************************************
+* Function Name: power_held
+*******************************************************************************
+*
+* Summary:
+*  Get which of the blocks someone holds, a held block must not be stopped or
+*  put to sleep outside of the power manager
+*
+* Parameters:
+*  uint8_t blocks: POWER_xxx bits of the blocks to check
+*
+* Return:
+*  uint8_t: POWER_xxx bits of the blocks that are held
+*
+*******************************************************************************/
+
+uint8_t power_held(uint8_t blocks) {
+    uint8_t held = 0;
+    uint8 interrupts = CyEnterCriticalSection();
+    for (uint8_t i = 0; i < POWER_BLOCKS; i++) {
+        if ((blocks & (1 << i)) && holders[i]) {
+            held |= 1 << i;
+        }
+    }
+    CyExitCriticalSection(interrupts);
+    return held;
+}
+
+/******************************************************************************
+* Function Name: power_set_settling
+*******************************************************************************
+*
+* Summary:
+*  Set how long the electrode settles at the first voltage of a run and how long
+*  the blocks are kept warm after a run
+*
+* Parameters:
+*  uint16_t min_settle_ms: time the electrode always settles
+*  uint16_t max_settle_ms: longest time to wait for the current to stop changing,
+*                          the same as min_settle_ms for a fixed settle time
+*  uint16_t keep_warm_ms: time released blocks stay awake, 0 to sleep them right away
+*
+*******************************************************************************/
+
+void power_set_settling(uint16_t min_settle_ms, uint16_t max_settle_ms, uint16_t keep_warm_ms) {
+    if (max_settle_ms < min_settle_ms) {
+        max_settle_ms = min_settle_ms;
+    }
+    timing.min_settle_ms = min_settle_ms;
+    timing.max_settle_ms = max_settle_ms;
+    timing.keep_warm_ms = keep_warm_ms;
+}
+
+/******************************************************************************
+* Function Name: power_wakeup_run
+*******************************************************************************
+*
+* Summary:
+*  Wake up the hardware for a run and set the DAC to the first voltage.  The aux
+*  opamp is woken after the DAC output settles so the cell only sees the first
+*  voltage, then the ADC and electrode settle at the same time.  Returns when an
+*  ADC conversion is ready and the electrode has settled.  The blocks are held
+*  by POWER_HOLDER_RUN until the run releases them
+*
+* Parameters:
+*  uint16_t dac_value: value to put in the DAC
+*
+* Return:
+*  uint32_t: time the wake up took in microseconds, also saved in telemetry.start_latency_us
+*
+*******************************************************************************/
+
+uint32_t power_wakeup_run(uint16_t dac_value) {
+    uint32_t start_us = telemetry_time_us();
+    power_acquire(POWER_HOLDER_RUN, POWER_RUN_BLOCKS & ~POWER_OPAMP_AUX);
+    DAC_SetValue(dac_value);
+    ADC_SigDel_StartConvert();  // the first conversions are made while the electrode settles
+    if (!(awake & POWER_OPAMP_AUX)) {  // skipped if the cell is still driven from the last run
+        power_wait_until(start_us, timing.dac_settle_us);
+    }
+    power_acquire(POWER_HOLDER_RUN, POWER_OPAMP_AUX);
+
+    uint32_t settle_start_us = telemetry_time_us();
+    power_wait_until(settle_start_us, (uint32_t)timing.min_settle_ms * 1000);
+    uint8_t adc_ready = power_wait_adc();
+    if (timing.max_settle_ms > timing.min_settle_ms) {  // wait for the current to stop changing
+        int16_t last_reading = ADC_SigDel_GetResult16();
+        while (adc_ready &&
+               (telemetry_time_us() - settle_start_us < (uint32_t)timing.max_settle_ms * 1000)) {
+            adc_ready = power_wait_adc();
+            int16_t reading = ADC_SigDel_GetResult16();
+            if (abs(reading - last_reading) <= POWER_SETTLE_TOLERANCE) {
+                break;
+            }
+            last_reading = reading;
+        }
+    }
+    telemetry.start_latency_us = telemetry_time_us() - start_us;
+    return telemetry.start_latency_us;
+}
+
+/******************************************************************************
+* Function Name: power_wait_until
+*******************************************************************************
+*
+* Summary:
+*  Wait until wait_us has passed since start_us
+*
+*******************************************************************************/
+
+static void power_wait_until(uint32_t start_us, uint32_t wait_us) {
+    while (telemetry_time_us() - start_us < wait_us);
+}
+
+/******************************************************************************
+* Function Name: power_wait_adc
+*******************************************************************************
+*
+* Summary:
+*  Wait for the ADC to finish a conversion
+*
+* Return:
+*  true (1) if a conversion is ready, false (0) if the ADC timed out
+*
+*******************************************************************************/
+
+static uint8_t power_wait_adc(void) {
+    uint32_t start_us = telemetry_time_us();
+    while (!ADC_SigDel_IsEndConversion(ADC_SigDel_RETURN_STATUS)) {
+        if (telemetry_time_us() - start_us > POWER_ADC_TIMEOUT_US) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* [] END OF FILE */
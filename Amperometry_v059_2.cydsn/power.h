@@ -0,0 +1,78 @@
+/*******************************************************************************
+* File Name: power.h
+*
+* Description:
+*  This file contains the function prototypes and constants used to keep track of
+*  which analog blocks are powered and which parts of the firmware need them, and
+*  to wake up the analog blocks for a run.  The blocks are woken together and the
+*  sequencer waits on settle times and the ADC instead of a chain of fixed delays
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(POWER_H)
+#define POWER_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+/**************************************
+*      Constants
+**************************************/
+
+#define POWER_DAC_SETTLE_US         1000  // DAC output settles before the aux opamp drives the cell
+#define POWER_MIN_SETTLE_MS         20  // the electrode settles at the first voltage at least this long
+#define POWER_MAX_SETTLE_MS         20  // then waits up to this long for the current to stop changing
+#define POWER_SETTLE_TOLERANCE      8  // ADC counts between readings that is counted as settled
+#define POWER_ADC_TIMEOUT_US        5000  // longest wait for an ADC conversion
+#define POWER_KEEP_WARM_MS          1000  // blocks no one holds are put to sleep after this long
+
+// blocks, bits of the power masks
+#define POWER_ADC                   0x01
+#define POWER_TIA                   0x02
+#define POWER_VDAC_TIA              0x04
+#define POWER_DAC                   0x08
+#define POWER_OPAMP_AUX             0x10
+#define POWER_PWM                   0x20
+#define POWER_BLOCKS                6
+#define POWER_RUN_BLOCKS            0x3F  // every block, used by CV and amperometry runs
+#define POWER_MEASURE_BLOCKS        (POWER_ADC | POWER_TIA | POWER_VDAC_TIA)  // current measuring chain
+
+// parts of the firmware that hold blocks awake, bits of each block's holders
+#define POWER_HOLDER_RUN            0x01
+#define POWER_HOLDER_CALIBRATE      0x02
+#define POWER_HOLDER_TIMER          0x04  // writing the PWM registers
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* How long power_wakeup_run lets the electrode settle and how long released
+ * blocks are kept warm.  If max_settle_ms is longer than min_settle_ms the
+ * readings are watched after min_settle_ms and the run starts when 2 readings
+ * in a row are within POWER_SETTLE_TOLERANCE */
+struct PowerTiming {
+    uint16_t dac_settle_us;
+    uint16_t min_settle_ms;
+    uint16_t max_settle_ms;
+    uint16_t keep_warm_ms;  // how long blocks stay awake after they are released
+};
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+uint8_t power_acquire(uint8_t holder, uint8_t blocks);
+void power_release(uint8_t holder, uint8_t blocks);
+void power_service(void);
+void power_sleep_idle(void);
+uint8_t power_awake(void);
+uint8_t power_held(uint8_t blocks);
+void power_set_settling(uint16_t min_settle_ms, uint16_t max_settle_ms, uint16_t keep_warm_ms);
+uint32_t power_wakeup_run(uint16_t dac_value);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,190 @@
+/*******************************************************************************
+* File Name: telemetry.c
+*
+* Description:
+*  Counters of what the device has done so the host can check on a device
+*  without stopping its run.  The counters are updated by the isrs and the USB
+*  functions and sent to the host as a single 64 byte packet.  The counters that
+*  both the isrs and the main loop change are only changed in a critical section,
+*  samples_acquired is only changed by the adc isrs
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "telemetry.h"
+
+struct Telemetry telemetry = {.version = TELEMETRY_VERSION};
+static uint32_t uptime_ms = 0;  // updated by the SysTick interrupt
+
+static void telemetry_systick(void) {
+    uptime_ms++;
+}
+
+/******************************************************************************
+* Function Name: telemetry_start
+*******************************************************************************
+*
+* Summary:
+*  Start the SysTick timer with a 1 ms period to use as the time base
+*
+*******************************************************************************/
+
+void telemetry_start(void) {
+    CySysTickStart();
+    CySysTickSetCallback(TELEMETRY_SYSTICK_CALLBACK, telemetry_systick);
+}
+
+/******************************************************************************
+* Function Name: telemetry_time_us
+*******************************************************************************
+*
+* Summary:
+*  Get the time since telemetry_start was called, the milliseconds come from the
+*  SysTick interrupt and the microseconds from the SysTick counter
+*
+* Return:
+*  uint32_t: time in microseconds, rolls over after about 71 minutes
+*
+*******************************************************************************/
+
+uint32_t telemetry_time_us(void) {
+    uint32_t ms;
+    uint32_t count;
+    do {  // read again if the SysTick interrupt happened in between
+        ms = uptime_ms;
+        count = CySysTickGetValue();
+    } while (ms != uptime_ms);
+    uint32_t reload = CySysTickGetReload();
+    // the SysTick counts down from the reload value
+    return 1000*ms + ((reload - count) * 1000) / (reload + 1);
+}
+
+/******************************************************************************
+* Function Name: telemetry_uptime_ms
+*******************************************************************************
+*
+* Summary:
+*  Get the milliseconds since telemetry_start was called
+*
+* Return:
+*  uint32_t: time in milliseconds, rolls over after about 49 days
+*
+*******************************************************************************/
+
+uint32_t telemetry_uptime_ms(void) {
+    return uptime_ms;
+}
+
+/******************************************************************************
+* Function Name: telemetry_usb_blocked
+*******************************************************************************
+*
+* Summary:
+*  Add the time since start_us to the time spent waiting for the USB.  Can be
+*  called from an isr
+*
+* Parameters:
+*  uint32_t start_us: telemetry_time_us when the wait started
+*
+*******************************************************************************/
+
+void telemetry_usb_blocked(uint32_t start_us) {
+    uint32_t blocked_us = telemetry_time_us() - start_us;
+    uint8 interrupts = CyEnterCriticalSection();
+    telemetry.usb_blocked_us += blocked_us;
+    if (blocked_us > telemetry.usb_max_blocked_us) {
+        telemetry.usb_max_blocked_us = blocked_us;
+    }
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: telemetry_usb_sent
+*******************************************************************************
+*
+* Summary:
+*  Count a packet sent to the host.  Can be called from an isr
+*
+* Parameters:
+*  uint16_t size: bytes in the packet
+*
+*******************************************************************************/
+
+void telemetry_usb_sent(uint16_t size) {
+    uint8 interrupts = CyEnterCriticalSection();
+    telemetry.usb_bytes_sent += size;
+    telemetry.usb_packets_sent++;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: telemetry_buffer_filled
+*******************************************************************************
+*
+* Summary:
+*  Record that an amperometry buffer is full, if the buffer was not exported
+*  since the last time it was filled the host missed that data so count an overrun.
+*  Called from the adcAmp isr
+*
+* Parameters:
+*  uint8_t channel: adc_buffers channel that was filled
+*
+*******************************************************************************/
+
+void telemetry_buffer_filled(uint8_t channel) {
+    uint16_t channel_bit = 1 << channel;
+    uint8 interrupts = CyEnterCriticalSection();
+    telemetry.buffers_filled++;
+    if (telemetry.unread_buffers & channel_bit) {
+        telemetry.overruns++;
+    }
+    telemetry.unread_buffers |= channel_bit;
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: telemetry_buffer_exported
+*******************************************************************************
+*
+* Summary:
+*  Record that an ADC buffer was sent to the host
+*
+* Parameters:
+*  uint8_t channel: adc_buffers channel that was exported
+*
+*******************************************************************************/
+
+void telemetry_buffer_exported(uint8_t channel) {
+    uint8 interrupts = CyEnterCriticalSection();
+    telemetry.buffers_exported++;
+    telemetry.unread_buffers &= ~(1 << channel);
+    CyExitCriticalSection(interrupts);
+}
+
+/******************************************************************************
+* Function Name: telemetry_snapshot
+*******************************************************************************
+*
+* Summary:
+*  Copy the counters into a packet to send to the host.  The caller fills in the
+*  fields that belong to main (lut_index, isr_states ...) before calling this.
+*  The copy is made in a critical section so the counters agree with each other
+*
+* Parameters:
+*  uint8_t packet[]: array of TELEMETRY_PACKET_SIZE bytes to put the counters in
+*
+*******************************************************************************/
+
+void telemetry_snapshot(uint8_t packet[]) {
+    uint8 interrupts = CyEnterCriticalSection();
+    telemetry.uptime_ms = uptime_ms;
+    uint8_t *counters = (uint8_t*)&telemetry;
+    for (uint8_t i = 0; i < TELEMETRY_PACKET_SIZE; i++) {
+        packet[i] = counters[i];
+    }
+    CyExitCriticalSection(interrupts);
+}
+
+/* [] END OF FILE */
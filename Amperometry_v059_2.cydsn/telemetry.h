@@ -0,0 +1,78 @@
+/*******************************************************************************
+* File Name: telemetry.h
+*
+* Description:
+*  This file contains the counters, function prototypes and constants used to
+*  report the health of the device to the host while an experiment is running
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#if !defined(TELEMETRY_H)
+#define TELEMETRY_H
+
+#include <project.h>
+#include "cytypes.h"
+#include "stdio.h"  // gets rid of the type errors
+
+/**************************************
+*      Constants
+**************************************/
+
+#define TELEMETRY_VERSION               1
+#define TELEMETRY_PACKET_SIZE           64  // the status is sent in 1 full speed USB packet
+#define TELEMETRY_SYSTICK_CALLBACK      0  // SysTick callback slot used for the millisecond counter
+
+// bits of isr_states
+#define TELEMETRY_ISR_DAC               0x01
+#define TELEMETRY_ISR_ADC               0x02
+#define TELEMETRY_ISR_ADC_AMP           0x04
+
+/**************************************
+*      Global structs
+**************************************/
+
+/* All the fields are on their natural alignment so the struct is the same
+ * as the 64 bytes the host reads, little endian like the rest of the data */
+struct Telemetry {
+    uint8_t version;  // TELEMETRY_VERSION, changed when the layout changes
+    uint8_t isr_states;  // TELEMETRY_ISR_xxx bits of the isrs that are enabled
+    uint16_t lut_index;
+    uint16_t lut_length;
+    uint16_t buffer_size_data_pts;  // samples in each amperometry buffer
+    uint32_t uptime_ms;
+    uint32_t samples_acquired;  // ADC readings saved by the isrs
+    uint32_t buffers_filled;  // amperometry buffers that were filled
+    uint32_t buffers_exported;
+    uint32_t overruns;  // amperometry buffers filled again before the host read them
+    uint32_t usb_bytes_sent;
+    uint32_t usb_packets_sent;
+    uint32_t usb_blocked_us;  // total time spent waiting for the USB to be ready
+    uint32_t usb_max_blocked_us;  // longest single wait for the USB
+    uint16_t unread_buffers;  // bit for each amperometry buffer filled and not exported yet
+    uint8_t adc_recording_channel;
+    uint8_t powered_blocks;  // POWER_xxx bits of the analog blocks that are awake
+    uint32_t start_latency_us;  // time power_wakeup_run took to start the last run
+    uint8_t background;  // BACKGROUND_xxx bits, if a blank is saved and was taken off the last run
+    uint8_t reserved[11];  // pad to TELEMETRY_PACKET_SIZE
+};
+
+extern struct Telemetry telemetry;
+
+/***************************************
+*        Function Prototypes
+***************************************/
+
+void telemetry_start(void);
+uint32_t telemetry_time_us(void);
+uint32_t telemetry_uptime_ms(void);
+void telemetry_usb_blocked(uint32_t start_us);
+void telemetry_usb_sent(uint16_t size);
+void telemetry_buffer_filled(uint8_t channel);
+void telemetry_buffer_exported(uint8_t channel);
+void telemetry_snapshot(uint8_t packet[]);
+
+#endif
+/* [] END OF FILE */
@@ -13,10 +13,21 @@
 
 #include <project.h>
 #include "usb_protocols.h"
+#include "telemetry.h"
 #include "stdio.h"
 #include "stdlib.h"
 extern char LCD_str[];  // for debug
 
+static uint8_t data_route = USB_ROUTE_CDC;  // where the sample data is sent
+// end of the data written to the streaming endpoint that does not fill a packet yet
+static uint8_t stream_packet[MAX_BUFFER_SIZE];
+static uint8_t stream_packet_size = 0;
+
+/***************************************
+*        Forward function references
+***************************************/
+static void USB_Stream_Packet(const uint8_t packet[], uint16_t size);
+
 /******************************************************************************
 * Function Name: USB_CheckInput
 *******************************************************************************
@@ -66,10 +77,206 @@ void USB_Export_Data(uint8 array[], uint16_t size) {
         if (size_to_send > MAX_BUFFER_SIZE) {
             size_to_send = MAX_BUFFER_SIZE;
         }
-        while(USBUART_CDCIsReady() == 0)
-        {
+        if (USBUART_CDCIsReady() == 0) {
+            uint32_t wait_start = telemetry_time_us();
+            while(USBUART_CDCIsReady() == 0)
+            {
+            }
+            telemetry_usb_blocked(wait_start);
         }
         USBUART_PutData(&array[i], size_to_send);
+        telemetry_usb_sent(size_to_send);
+    }
+}
+
+/******************************************************************************
+* Function Name: USB_Stream_Data
+*******************************************************************************
+*
+* Summary:
+*  Send a buffer through the vendor specific bulk IN endpoint (STREAMING_ENDPOINT)
+*  in full size packets as 1 transfer.  This skips the per call overhead of the
+*  CDC API so the data rate is only limited by the USB full speed bus.  If the
+*  last packet is full a zero length packet is sent so the host knows the
+*  transfer is finished.
+*
+* Parameters:
+*  uint8 array: array of data to export
+*  uint16_t size: the number of bytes to send in the array
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+
+void USB_Stream_Data(uint8_t array[], uint16_t size) {
+    USB_Stream_Write(array, size);
+    USB_Stream_End();
+}
+
+/******************************************************************************
+* Function Name: USB_Stream_Write
+*******************************************************************************
+*
+* Summary:
+*  Add data to the transfer on the streaming endpoint.  Only full packets are
+*  sent, the bytes left over are held until the next call fills the packet or
+*  USB_Stream_End finishes the transfer, so data made in blocks is still 1 transfer
+*
+* Parameters:
+*  const uint8_t array[]: array of data to add to the transfer
+*  uint16_t size: the number of bytes in the array
+*
+*******************************************************************************/
+
+void USB_Stream_Write(const uint8_t array[], uint16_t size) {
+    uint16_t i = 0;
+    while (i < size) {
+        if ((stream_packet_size == 0) && (size - i >= MAX_BUFFER_SIZE)) {
+            USB_Stream_Packet(&array[i], MAX_BUFFER_SIZE);  // nothing held, send straight from the array
+            i += MAX_BUFFER_SIZE;
+            continue;
+        }
+        stream_packet[stream_packet_size] = array[i];
+        stream_packet_size++;
+        i++;
+        if (stream_packet_size == MAX_BUFFER_SIZE) {
+            USB_Stream_Packet(stream_packet, MAX_BUFFER_SIZE);
+            stream_packet_size = 0;
+        }
+    }
+}
+
+/******************************************************************************
+* Function Name: USB_Stream_End
+*******************************************************************************
+*
+* Summary:
+*  Finish the transfer on the streaming endpoint with the bytes that are held
+*  as a short packet, or a zero length packet if the last packet was full
+*
+*******************************************************************************/
+
+void USB_Stream_End(void) {
+    USB_Stream_Packet(stream_packet, stream_packet_size);
+    stream_packet_size = 0;
+}
+
+/******************************************************************************
+* Function Name: USB_Stream_Packet
+*******************************************************************************
+*
+* Summary:
+*  Wait for the streaming endpoint to be empty and load a packet into it
+*
+* Parameters:
+*  const uint8_t packet[]: data of the packet
+*  uint16_t size: bytes in the packet, 0 to MAX_BUFFER_SIZE
+*
+*******************************************************************************/
+
+static void USB_Stream_Packet(const uint8_t packet[], uint16_t size) {
+    if (USBUART_GetEPState(STREAMING_ENDPOINT) != USBUART_IN_BUFFER_EMPTY) {
+        uint32_t wait_start = telemetry_time_us();
+        while(USBUART_GetEPState(STREAMING_ENDPOINT) != USBUART_IN_BUFFER_EMPTY)
+        {
+        }
+        telemetry_usb_blocked(wait_start);
+    }
+    USBUART_LoadInEP(STREAMING_ENDPOINT, packet, size);
+    if (size) {
+        telemetry_usb_sent(size);
+    }
+}
+
+/******************************************************************************
+* Function Name: USB_Set_Data_Route
+*******************************************************************************
+*
+* Summary:
+*  Choose if the sample data is sent through the CDC or the streaming endpoint
+*
+* Parameters:
+*  uint8 route: USB_ROUTE_CDC or USB_ROUTE_STREAMING_ENDPOINT
+*
+* Return:
+*  the route that is used, the CDC if the streaming endpoint is not in the
+*  USB descriptor
+*
+*******************************************************************************/
+
+uint8_t USB_Set_Data_Route(uint8_t route) {
+    if ((route == USB_ROUTE_STREAMING_ENDPOINT) && USB_STREAMING_ENDPOINT_ENABLED) {
+        data_route = USB_ROUTE_STREAMING_ENDPOINT;
+    }
+    else {
+        data_route = USB_ROUTE_CDC;
+    }
+    return data_route;
+}
+
+/******************************************************************************
+* Function Name: USB_Export_Sample_Data
+*******************************************************************************
+*
+* Summary:
+*  Send sample data through the route selected with USB_Set_Data_Route
+*
+* Parameters:
+*  uint8 array array: array of data to export
+*  uint16_t size: the number of bytes to send in the array
+*
+* Return:
+*  None
+*
+*******************************************************************************/
+
+void USB_Export_Sample_Data(uint8_t array[], uint16_t size) {
+    if (data_route == USB_ROUTE_STREAMING_ENDPOINT) {
+        USB_Stream_Data(array, size);
+    }
+    else {
+        USB_Export_Data(array, size);
+    }
+}
+
+/******************************************************************************
+* Function Name: USB_Export_Sample_Block
+*******************************************************************************
+*
+* Summary:
+*  Send a block of sample data that is part of a longer export through the route
+*  selected with USB_Set_Data_Route.  On the streaming endpoint the blocks are
+*  joined into 1 transfer, call USB_Export_Sample_End after the last block
+*
+* Parameters:
+*  uint8 array array: array of data to export
+*  uint16_t size: the number of bytes to send in the array
+*
+*******************************************************************************/
+
+void USB_Export_Sample_Block(uint8_t array[], uint16_t size) {
+    if (data_route == USB_ROUTE_STREAMING_ENDPOINT) {
+        USB_Stream_Write(array, size);
+    }
+    else {
+        USB_Export_Data(array, size);
+    }
+}
+
+/******************************************************************************
+* Function Name: USB_Export_Sample_End
+*******************************************************************************
+*
+* Summary:
+*  Finish an export sent with USB_Export_Sample_Block, the CDC has no transfers
+*  to finish
+*
+*******************************************************************************/
+
+void USB_Export_Sample_End(void) {
+    if (data_route == USB_ROUTE_STREAMING_ENDPOINT) {
+        USB_Stream_End();
     }
 }
 
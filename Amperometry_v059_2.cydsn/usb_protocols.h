@@ -24,8 +24,21 @@
     
 #define IN_ENDPOINT 0X01
 #define OUT_ENDPOINT 0x02
-#define STREAMING_ENDPOINT 0x03
+// The CDC interfaces of the USBUART use endpoints 1-3, so the vendor specific
+// bulk IN endpoint for the sample data is after them
+#define STREAMING_ENDPOINT 0x04
 #define MAX_BUFFER_SIZE 64
+    
+// The USBUART descriptor in the TopDesign has a vendor specific interface (interface 2) with
+// the bulk IN endpoint STREAMING_ENDPOINT, set to 0 for a descriptor without it so all data
+// goes through the CDC
+#if !defined(USB_STREAMING_ENDPOINT_ENABLED)
+#define USB_STREAMING_ENDPOINT_ENABLED 1
+#endif
+    
+// Where the sample data is sent, commands and messages always use the CDC
+#define USB_ROUTE_CDC 0
+#define USB_ROUTE_STREAMING_ENDPOINT 1
 #define true 1
 #define false 0
     
@@ -43,6 +56,13 @@ extern uint8_t USB_deviceAdress;
     
 uint8_t USB_CheckInput(uint8_t buffer[]);
 void USB_Export_Data(uint8_t array[], uint16_t size);
+void USB_Stream_Data(uint8_t array[], uint16_t size);
+void USB_Stream_Write(const uint8_t array[], uint16_t size);
+void USB_Stream_End(void);
+uint8_t USB_Set_Data_Route(uint8_t route);
+void USB_Export_Sample_Data(uint8_t array[], uint16_t size);
+void USB_Export_Sample_Block(uint8_t array[], uint16_t size);
+void USB_Export_Sample_End(void);
 
 #endif
 
@@ -16,6 +16,12 @@
 #include "user_selections.h"
 extern char LCD_str[];  // for debug
 
+/***************************************
+* Forward function references
+***************************************/
+static uint16_t user_make_cv_lut(uint16_t start_dac_value, uint16_t end_dac_value, uint16_t timer_period,
+                                 uint8_t sweep_type, uint8_t start_volt_type);
+
 
 /******************************************************************************
 * Function Name: user_setup_TIA_ADC
@@ -36,6 +42,7 @@ extern char LCD_str[];  // for debug
 * Global variables: - found in calibrate.h and used by calibrate.c
 *  uint8 TIA_resistor_value_index: index of whick TIA resistor to use, Supplied by USB input
 *  uint8 ADC_buffer_index: which ADC buffer is used, gain = 2**ADC_buffer_index
+*  uint8 ADC_config_index: which ADC configuration is used
 *
 * Return:
 *  array of 20 bytes is loaded into the USB in endpoint (into the computer)
@@ -46,6 +53,8 @@ void user_setup_TIA_ADC(uint8_t data_buffer[]) {
     uint8_t adc_config = data_buffer[2]-'0';
     if (adc_config == 1 || adc_config == 2) {
         ADC_SigDel_SelectConfiguration(adc_config, DO_NOT_RESTART_ADC); 
+        ADC_config_index = adc_config;
+        export_set_resolution(adc_config);  // packed exports use the resolution of the new configuration
     }
     TIA_resistor_value_index = data_buffer[4]-'0';
     if (TIA_resistor_value_index >= 0 || TIA_resistor_value_index <= 7) {
@@ -64,19 +73,184 @@ void user_setup_TIA_ADC(uint8_t data_buffer[]) {
     else {
         AMux_TIA_resistor_bypass_Disconnect(0);
     }
+    calibrate_update_conversion();  // the picoamp export uses the calibration of the new settings
 }
 
 
 void user_export_lut(uint8_t data_buffer[]) {
     uint16_t length = LUT_Convert2Dec(&data_buffer[2], 4);
-
-    USB_Export_Data(&waveform_lut, length);
+    if (length > 2*(arena_lut_size + ARENA_LUT_PAD)) {  // don't send past the end of the look up table
+        length = 2*(arena_lut_size + ARENA_LUT_PAD);
+    }
+    USB_Export_Data((uint8_t*)waveform_lut, length);
 }
 
-void user_export_lut_length() {
+void user_export_lut_length(void) {
     USB_Export_Data(&lut_length, 2);
 }
 
+/******************************************************************************
+* Function Name: user_export_adc_range
+*******************************************************************************
+*
+* Summary:
+*  Export part of an ADC array so the host can fetch only the samples it has not
+*  read yet, or re-request a range that was corrupted, instead of the whole buffer
+*
+* Parameters:
+*  uint8 data_buffer[]: array of chars with the channel and range to export
+*  input is e|X|OOOO|NNNN: where
+*  X - which ADC buffer to export, 0 to arena_adc_buffer_count-1
+*  OOOO - uint16_t index of the first data point to export
+*  NNNN - uint16_t number of data points to export
+*
+* Global variables:
+*  adc_buffers: arrays the adc data is stored in
+*
+* Return:
+*  NNNN data points of the ADC array are loaded into the USB in the export format
+*  selected with 'O', or an error string if the range is outside of the ADC array
+*
+*******************************************************************************/
+
+void user_export_adc_range(uint8_t data_buffer[]) {
+    uint8_t channel = data_buffer[INDEX_EXPORT_CHANNEL]-'0';
+    uint16_t offset = LUT_Convert2Dec(&data_buffer[INDEX_EXPORT_OFFSET], 4);
+    uint16_t count = LUT_Convert2Dec(&data_buffer[INDEX_EXPORT_COUNT], 4);
+    int16_t *samples = arena_adc_range(channel, offset, count);
+    if (samples == 0) {
+        USB_Export_Data((uint8_t*)"Error Exporting", 16);
+        return;
+    }
+    export_samples(samples, count);
+}
+
+
+/******************************************************************************
+* Function Name: user_set_data_route
+*******************************************************************************
+*
+* Summary:
+*  Choose if the ADC data exports are sent through the USBUART CDC or the bulk
+*  streaming endpoint, commands and messages are always on the CDC
+*
+* Parameters:
+*  uint8 data_buffer[]: array of chars with the route to use
+*  input is u|X: where X is '0' for the CDC or '1' for the streaming endpoint
+*
+* Return:
+*  "uX" is sent back through the CDC where X is the route used, so the host
+*  knows if the streaming endpoint is available
+*
+*******************************************************************************/
+
+void user_set_data_route(uint8_t data_buffer[]) {
+    uint8_t export_array[2];
+    export_array[0] = 'u';
+    export_array[1] = USB_Set_Data_Route(data_buffer[2]-'0') + '0';
+    USB_Export_Data(export_array, 2);
+}
+
+/******************************************************************************
+* Function Name: user_export_status
+*******************************************************************************
+*
+* Summary:
+*  Send the telemetry counters to the host in 1 packet without stopping a run
+*  that is in progress, see struct Telemetry in telemetry.h for the layout
+*
+*******************************************************************************/
+
+void user_export_status(void) {
+    uint8_t packet[TELEMETRY_PACKET_SIZE];
+    telemetry.lut_index = lut_index;
+    telemetry.lut_length = lut_length;
+    telemetry.buffer_size_data_pts = buffer_size_data_pts;
+    telemetry.adc_recording_channel = adc_recording_channel;
+    telemetry.isr_states = 0;
+    if (isr_dac_GetState()) {
+        telemetry.isr_states |= TELEMETRY_ISR_DAC;
+    }
+    if (isr_adc_GetState()) {
+        telemetry.isr_states |= TELEMETRY_ISR_ADC;
+    }
+    if (isr_adcAmp_GetState()) {
+        telemetry.isr_states |= TELEMETRY_ISR_ADC_AMP;
+    }
+    telemetry_snapshot(packet);
+    USB_Export_Data(packet, TELEMETRY_PACKET_SIZE);
+}
+
+/******************************************************************************
+* Function Name: user_partition_arena
+*******************************************************************************
+*
+* Summary:
+*  Split the SRAM arena between the look up table and the ADC buffers, e.g.
+*  a few long buffers for a slow cyclic voltammetry or many short ones for fast
+*  amperometry.  Not allowed while an experiment is running
+*
+* Parameters:
+*  uint8 data_buffer[]: array of chars with the partition to use
+*  input is P|LLLLL|NN|SSSSS: where
+*  LLLLL - most entries the look up table can have
+*  NN - number of ADC buffers, 01 to ARENA_MAX_ADC_BUFFERS
+*  SSSSS - samples each ADC buffer can hold
+*
+* Return:
+*  "P1" is sent back if the arena was partitioned, "P0" if the partition does
+*  not fit or an experiment is running and the old partition is kept
+*
+*******************************************************************************/
+
+void user_partition_arena(uint8_t data_buffer[]) {
+    uint16_t lut_size = LUT_Convert2Dec(&data_buffer[INDEX_ARENA_LUT_SIZE], 5);
+    uint8_t buffer_count = LUT_Convert2Dec(&data_buffer[INDEX_ARENA_BUFFER_COUNT], 2);
+    uint16_t buffer_size = LUT_Convert2Dec(&data_buffer[INDEX_ARENA_BUFFER_SIZE], 5);
+    uint8_t export_array[2] = {'P', '0'};
+    if (!isr_dac_GetState() && !isr_adc_GetState() && !isr_adcAmp_GetState()) {
+        if (arena_partition(lut_size, buffer_count, buffer_size)) {
+            export_array[1] = '1';
+            if (lut_length > arena_lut_size) {  // only the start of the look up table is kept
+                lut_length = arena_lut_size;
+            }
+            background_clear();  // the buffers may have moved
+        }
+    }
+    USB_Export_Data(export_array, 2);
+}
+
+/******************************************************************************
+* Function Name: user_set_background
+*******************************************************************************
+*
+* Summary:
+*  Save the next voltammetry run as the blank or take the blank off the next runs,
+*  see background.c
+* 
+* Parameters:
+*  uint8 data_buffer[]: array of chars from the user
+*  input is K|M|BB: where
+*  M - '0' off, '1' save the next run as the blank, '2' take the blank off the next runs
+*  BB - ADC buffer to save the blank in, only used when M is '1'
+*
+* Return:
+*  "K1" is sent back if the mode was set, "K0" if the buffer does not exist or an
+*  experiment is running
+*
+*******************************************************************************/
+
+void user_set_background(uint8_t data_buffer[]) {
+    uint8_t mode = data_buffer[INDEX_BACKGROUND_MODE]-'0';
+    uint8_t buffer = LUT_Convert2Dec(&data_buffer[INDEX_BACKGROUND_BUFFER], 2);
+    uint8_t export_array[2] = {'K', '0'};
+    if (!isr_dac_GetState() && !isr_adc_GetState() && !isr_adcAmp_GetState()) {
+        if (background_set(mode, buffer)) {
+            export_array[1] = '1';
+        }
+    }
+    USB_Export_Data(export_array, 2);
+}
 
 /******************************************************************************
 * Function Name: user_voltage_source_funcs
@@ -88,7 +262,8 @@ void user_export_lut_length() {
 * Parameters:
 *  uint8 data_buffer[]: array of chars used to setup the DAC or to read the DAC settings
 *  input is VXY: where X is either 'R' or 'S' for read or set
-*  Y is '0' or '1'
+*  Y is the voltage source, "Error Voltage Source" is sent if the firmware was
+*  not built with it
 *
 * Return:
 *  export the DAC information to the USB, or set the DAC source depending on user input
@@ -103,9 +278,13 @@ void user_voltage_source_funcs(uint8_t data_buffer[]) {
         USB_Export_Data(export_array, 2);
     }
     else if (data_buffer[1] == 'S') {  // User wants to set the voltage source
-        helper_set_voltage_source(data_buffer[2]-'0');
-        DAC_Start();
-        DAC_Sleep();
+        if (helper_set_voltage_source(data_buffer[2]-'0')) {
+            DAC_Start();
+            DAC_Sleep();
+        }
+        else {
+            USB_Export_Data((uint8_t*)"Error Voltage Source", 21);
+        }
     }
 }
 
@@ -133,24 +312,22 @@ void user_voltage_source_funcs(uint8_t data_buffer[]) {
 *******************************************************************************/
 
 void user_start_cv_run(void){
-    if (!isr_dac_GetState()){  // enable the dac isr if it isnt already enabled
+    if (arena_adc_range(0, 0, lut_length+1) == 0) {  // the data has to fit in the first adc buffer
+        USB_Export_Data((uint8_t*)"Error2", 7);
+    }
+    else if (!isr_dac_GetState()){  // enable the dac isr if it isnt already enabled
         if (isr_adcAmp_GetState()) {  // User has started cyclic voltammetry while amp is already running so disable amperometry
             isr_adcAmp_Disable();
         }
         lut_index = 0;  // start at the beginning of the look up table
         lut_value = waveform_lut[0];
-        helper_HardwareWakeup();  // start the hardware
-        DAC_SetValue(lut_value);  // let the electrode equilibriate
-        CyDelay(20);  // let the electrode voltage settle
-        ADC_SigDel_StartConvert();  // start the converstion process of the delta sigma adc so it will be ready to read when needed
-        CyDelay(10);
+        power_wakeup_run(lut_value);  // start the hardware and let the electrode equilibriate at the first voltage
         PWM_isr_WriteCounter(100);  // set the pwm timer so that it will trigger adc isr first
-        ADC_array[0].data[lut_index] = ADC_SigDel_GetResult16();  // Hack, get first adc reading, timing element doesn't reverse for some reason
-        
-        DAC_SetValue(lut_value);  // let the electrode equilibriate
-        
-        CyDelay(20);  // let the electrode voltage settle
+        adc_buffers[0][lut_index] = ADC_SigDel_GetResult16();  // Hack, get first adc reading, timing element doesn't reverse for some reason
         
+        autorange_start(0);
+        background_start(waveform_lut, lut_length);
+        coulometry_start(lut_value);
         isr_dac_Enable();  // enable the interrupts to start the dac
         isr_adc_Enable();  // and the adc
     }
@@ -164,7 +341,8 @@ void user_start_cv_run(void){
 *******************************************************************************
 *
 * Summary:
-*  Stop all operations by disabling all the isrs and reset the look up table index to 0
+*  Stop all operations by disabling all the isrs and reset the look up table index to 0.
+*  The hardware is put to sleep after the keep warm time set with 'W'
 *  
 * Global variables:
 *  uint16_t lut_index: current index of the look up table
@@ -181,7 +359,8 @@ void user_reset_device(void) {
     isr_dac_Disable();
     isr_adc_Disable();
     isr_adcAmp_Disable();
-    helper_HardwareSleep();
+    power_release(POWER_HOLDER_RUN, POWER_RUN_BLOCKS);
+    autorange_stop();
     
     lut_index = 0;  
 }
@@ -230,11 +409,11 @@ void user_identify(void) {
 
 
 void user_set_isr_timer(uint8_t data_buffer[]) {
-    PWM_isr_Wakeup();
+    power_acquire(POWER_HOLDER_TIMER, POWER_PWM);  // only woken if a run is not using it
     uint16_t timer_period = LUT_Convert2Dec(&data_buffer[2], 5);
     PWM_isr_WriteCompare(timer_period / 2);  // not used in amperometry run so just set in the middle
     PWM_isr_WritePeriod(timer_period);
-    PWM_isr_Sleep();
+    power_release(POWER_HOLDER_TIMER, POWER_PWM);
 }
 
 /******************************************************************************
@@ -242,7 +421,8 @@ void user_set_isr_timer(uint8_t data_buffer[]) {
 *******************************************************************************
 *
 * Summary:
-*  Make a look up table that will run a chronoamperometry experiment.  Hackish now
+*  Make a look up table that will run a chronoamperometry experiment.  Hackish now.
+*  For chronocoulometry turn on the charge integration with 'q' before the run
 * 
 * Parameters:
 *  uint8 data_buffer[]: array of chars used to make the look up table
@@ -262,7 +442,7 @@ void user_set_isr_timer(uint8_t data_buffer[]) {
 *******************************************************************************/
 
 uint16_t user_chrono_lut_maker(uint8_t data_buffer[]) {
-    PWM_isr_Wakeup();
+    power_acquire(POWER_HOLDER_TIMER, POWER_PWM);
     uint16_t baseline = LUT_Convert2Dec(&data_buffer[2], 4);
     uint16_t pulse = LUT_Convert2Dec(&data_buffer[7], 4);
     uint16_t timer_period = LUT_Convert2Dec(&data_buffer[12], 5);
@@ -272,7 +452,10 @@ uint16_t user_chrono_lut_maker(uint8_t data_buffer[]) {
     LUT_MakePulse(baseline, pulse);
     lut_value = waveform_lut[0];  // setup the dac so when it starts it will be at the correct voltage
                 
-    PWM_isr_Sleep();
+    power_release(POWER_HOLDER_TIMER, POWER_PWM);
+    if (arena_lut_size < 4000) {  // LUT_MakePulse stops at the end of the look up table
+        return arena_lut_size;
+    }
     return 4000; // the look up table length will be 4000
 }
 
@@ -378,15 +561,76 @@ uint16_t user_lookup_table_maker(uint8_t data_buffer[]) {
         printf("make look up table for swv\n");
         return user_lookup_table_maker_swv(data_buffer);
     }
-    PWM_isr_Wakeup();
     uint16_t start_dac_value = LUT_Convert2Dec(&data_buffer[2], 4);
     uint16_t end_dac_value = LUT_Convert2Dec(&data_buffer[7], 4);
     uint16_t timer_period = LUT_Convert2Dec(&data_buffer[12], 5);
-    uint8_t sweep_type = data_buffer[18];
-    uint8_t start_volt_type = data_buffer[19];
+    printf("user lookup table: %i, %i\n", start_dac_value, end_dac_value);
+    return user_make_cv_lut(start_dac_value, end_dac_value, timer_period,
+                            data_buffer[18], data_buffer[19]);
+}
+
+/******************************************************************************
+* Function Name: user_lookup_table_maker_mV
+*******************************************************************************
+*
+* Summary:
+*  Make a look up table for a cyclic voltammetry or linear sweep experiment from
+*  potentials and a scan rate, the device converts them for the DAC picked by
+*  DAC_Start so the host does not have to know which voltage source is used
+* 
+* Parameters:
+*  uint8 data_buffer[]: array of chars used to make the look up table
+*  input is v|SXXXX|SYYYY|ZZZZZ|AB: 
+*  SXXXX - sign ('+' or '-') and mV of the starting potential
+*  SYYYY - sign and mV of the ending potential
+*  ZZZZZ - uint16_t scan rate in mV/s
+*  A, B - same as the 'S' command, see user_lookup_table_maker
+*  
+* Return:
+*  uint16_t lut_length - how many look up table elements there are, the look up
+*                        table is not changed if the scan rate can not be made
+*                        with the DAC in use
+*
+*******************************************************************************/
+
+uint16_t user_lookup_table_maker_mV(uint8_t data_buffer[]) {
+    int16_t start_mV = LUT_Convert2Signed(&data_buffer[2], 5);
+    int16_t end_mV = LUT_Convert2Signed(&data_buffer[8], 5);
+    uint16_t scan_rate = LUT_Convert2Dec(&data_buffer[14], 5);
+    uint32_t timer_period = LUT_scan_rate_to_period(scan_rate, dac_ops->mv_per_bit);
+    if ((timer_period == 0) || (timer_period > 0xFFFF)) {  // too slow or fast for the 16-bit PWM
+        USB_Export_Data((uint8_t*)"Error Scan Rate", 16);
+        return lut_length;
+    }
+    return user_make_cv_lut(DAC_mV_to_value(start_mV), DAC_mV_to_value(end_mV), timer_period,
+                            data_buffer[20], data_buffer[21]);
+}
+
+/******************************************************************************
+* Function Name: user_make_cv_lut
+*******************************************************************************
+*
+* Summary:
+*  Set the sampling rate and fill in the look up table of a cyclic voltammetry
+*  or linear sweep experiment, used by the 'S' and 'v' commands
+* 
+* Parameters:
+*  uint16_t start_dac_value: starting number to put in the DAC
+*  uint16_t end_dac_value: ending number to put in the DAC
+*  uint16_t timer_period: period of the PWM timer that sets the sampling rate
+*  uint8_t sweep_type: 'L' for a linear sweep or 'C' for cyclic voltammetry
+*  uint8_t start_volt_type: 'Z' to start at 0 Volts or 'S' to start at start_dac_value
+*  
+* Return:
+*  uint16_t lut_length - how many look up table elements there are
+*
+*******************************************************************************/
+
+static uint16_t user_make_cv_lut(uint16_t start_dac_value, uint16_t end_dac_value, uint16_t timer_period,
+                                 uint8_t sweep_type, uint8_t start_volt_type) {
+    power_acquire(POWER_HOLDER_TIMER, POWER_PWM);
     PWM_isr_WritePeriod(timer_period);
     uint16_t local_lut_index = 0;
-    printf("user lookup table: %i, %i\n", start_dac_value, end_dac_value);
     if (sweep_type == 'L') {  // Make look up table for linear sweep, ignore start volt type
         // The dac changes once after the run, so hold the voltage at the end constant
         // for 1 more tick
@@ -401,7 +645,7 @@ uint16_t user_lookup_table_maker(uint8_t data_buffer[]) {
         local_lut_index = LUT_MakeTriangle_Wave(start_dac_value, end_dac_value);
     }
     lut_value = waveform_lut[0];  // Initialize for the start of the experiment
-    PWM_isr_Sleep();
+    power_release(POWER_HOLDER_TIMER, POWER_PWM);
     return local_lut_index;
 }
 
@@ -415,9 +659,9 @@ uint16_t user_lookup_table_maker_swv(uint8_t data_buffer[]) {
     uint16_t timer_period = LUT_Convert2Dec(&data_buffer[22], 5);
     uint16_t sweep_type = data_buffer[28];
     uint16_t start_volt_type = data_buffer[29];
-    PWM_isr_Wakeup();
+    power_acquire(POWER_HOLDER_TIMER, POWER_PWM);
     PWM_isr_WritePeriod(timer_period);
-    PWM_isr_Sleep();
+    power_release(POWER_HOLDER_TIMER, POWER_PWM);
     printf("start_voltage: %i\n", start_dac_value);
     printf("end voltage: %i\n", end_dac_value);
     printf("inc voltage: %i\n", swv_inc);
@@ -454,7 +698,8 @@ uint16_t user_lookup_table_make_future(uint8_t data_buffer[]) {
 * Summary:
 *  Start an amperometry experiment.  Turn on all the hardware required, set the dac,
 *  initialize the look up table index that will be a point where to put the data points
-*  in the adc buffer, and start the Delta Sigma ADC to start converting.
+*  in the adc buffer, and start the Delta Sigma ADC to start converting.  The isrs are
+*  disabled before the hardware is woken so a CV that is running does not change the DAC
 * 
 * Parameters:
 *  uint8 data_buffer[]: array of chars used to make the look up table
@@ -471,7 +716,6 @@ uint16_t user_lookup_table_make_future(uint8_t data_buffer[]) {
 *******************************************************************************/
 
 uint16_t user_run_amperometry(uint8_t data_buffer[]) {
-    helper_HardwareWakeup();  
     if (!isr_adcAmp_GetState()) {  // enable isr if it is not already
         if (isr_dac_GetState()) {  // User selected to run amperometry but a CV is still running 
             isr_dac_Disable();
@@ -480,11 +724,14 @@ uint16_t user_run_amperometry(uint8_t data_buffer[]) {
     }
     uint16_t dac_value = LUT_Convert2Dec(&data_buffer[2], 4);  // get the voltage the user wants and set the dac
     lut_index = 0;
-    DAC_SetValue(dac_value);
-    
-    ADC_SigDel_StartConvert();
-    CyDelay(15);
+    power_wakeup_run(dac_value);
     uint16_t buffer_size_data_pts = LUT_Convert2Dec(&data_buffer[7], 4);  // how many data points to collect in each adc channel before exporting the data
+    if (buffer_size_data_pts > arena_adc_buffer_size) {  // the isr does not check the buffer size
+        buffer_size_data_pts = arena_adc_buffer_size;
+    }
+    decimate_reset();
+    background_clear();  // amperometry records in every ADC buffer
+    autorange_start(buffer_size_data_pts);
     isr_adcAmp_Enable();
     return buffer_size_data_pts;
 }
@@ -15,10 +15,19 @@
 #include <project.h>
 #include "stdio.h"  // gets rid of the type errors
     
+#include "arena.h"
+#include "autorange.h"
+#include "background.h"
+#include "calibrate.h"
+#include "coulometry.h"
+#include "data_export.h"
+#include "decimate.h"
 #include "globals.h"
 #include "helper_functions.h"
 #include "usb_protocols.h"
 #include "lut_protocols.h"
+#include "power.h"
+#include "telemetry.h"
     
     
 #define DO_NOT_RESTART_ADC      0
@@ -27,9 +36,14 @@
 *        Function Prototypes
 ***************************************/  
 
-//void user_export_lut(uint8_t data_buffer[]);
-//void user_export_lut_length();
+void user_export_lut(uint8_t data_buffer[]);
+void user_export_lut_length(void);
 void user_setup_TIA_ADC(uint8_t data_buffer[]);
+void user_export_adc_range(uint8_t data_buffer[]);
+void user_set_data_route(uint8_t data_buffer[]);
+void user_export_status(void);
+void user_partition_arena(uint8_t data_buffer[]);
+void user_set_background(uint8_t data_buffer[]);
 void user_run_cv_experiment(uint8_t data_buffer[]);
 void user_voltage_source_funcs(uint8_t data_buffer[]);
 void user_start_cv_run(void);
@@ -41,6 +55,7 @@ uint16_t user_dpv_lut_maker(uint8_t data_buffer[]);
 //uint16_t user_dpv_lut_make_depr(uint8_t data_buffer[]);
 uint16_t user_lookup_table_make_future(uint8_t data_buffer[]);
 uint16_t user_lookup_table_maker(uint8_t data_buffer[]);
+uint16_t user_lookup_table_maker_mV(uint8_t data_buffer[]);
 uint16_t user_lookup_table_maker_swv(uint8_t data_buffer[]);
 uint16_t user_run_amperometry(uint8_t data_buffer[]);
 
@@ -51,8 +66,10 @@ uint16_t user_run_amperometry(uint8_t data_buffer[]);
 
 extern uint8_t TIA_resistor_value_index;
 extern uint8_t ADC_buffer_index;
-union waveform_lut_union;
+extern uint8_t ADC_config_index;
 extern uint16_t lut_length;
+extern uint16_t buffer_size_data_pts;
+extern uint8_t adc_recording_channel;
     
 #endif
 
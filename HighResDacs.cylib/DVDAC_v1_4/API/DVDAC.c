@@ -25,10 +25,17 @@ uint8  `$INSTANCE_NAME`_initVar = 0;
 uint16 `$INSTANCE_NAME`_currentValue = `$INSTANCE_NAME`_DEFAULT_DATA; 
 
 /* Variable declarations for DAC_DMA */
-uint8 `$INSTANCE_NAME`_DArray[`$INSTANCE_NAME`_DITHER_SIZE];
+/* The dither array is written as 32-bit words by SetValue, the DMA sends the
+*  first DITHER_SIZE bytes of it */
+uint32 `$INSTANCE_NAME`_DArrayWords[`$INSTANCE_NAME`_DITHER_WORDS];
+uint8 * const `$INSTANCE_NAME`_DArray = (uint8 *)`$INSTANCE_NAME`_DArrayWords;
 uint8 `$INSTANCE_NAME`_TD;
 uint8 `$INSTANCE_NAME`_Channel;
 
+/* The 1 LSB steps to add to the MSB for each LSB value, the last row is all 0
+*  for the max value of the DAC.  Made by InitDither */
+static uint32 `$INSTANCE_NAME`_ditherPatterns[`$INSTANCE_NAME`_DITHER_SIZE + 1][`$INSTANCE_NAME`_DITHER_WORDS];
+
 
 /*******************************************************************************
 * Function Name: `$INSTANCE_NAME`_Init
@@ -64,6 +71,9 @@ void `$INSTANCE_NAME`_Init(void)
    /* Set default range */
    `$INSTANCE_NAME`_SetRange(`$INSTANCE_NAME`_DEFAULT_RANGE); 
 	 
+   /* Make the dither patterns before SetValue uses them */
+   `$INSTANCE_NAME`_InitDither();
+   
    /* Set default value */
    `$INSTANCE_NAME`_SetValue(`$INSTANCE_NAME`_DEFAULT_DATA);
    
@@ -198,6 +208,48 @@ void `$INSTANCE_NAME`_SetRange(uint8 range)  `=ReentrantKeil($INSTANCE_NAME . "_
 }
 
 
+/*******************************************************************************
+* Function Name: `$INSTANCE_NAME`_InitDither
+********************************************************************************
+*
+* Summary:
+*  Make the dither pattern for each LSB value once, so SetValue only has to add
+*  the MSB to a pattern.  Element i of the pattern for an LSB value is 1 if
+*  i <= lsb, the same dither the element by element loop made before.
+*
+* Parameters:  
+*  (void)
+*
+* Return: 
+*  (void) 
+*
+* Theory: 
+*  The patterns are stored as 32-bit words, little endian like the Cortex-M3,
+*  so byte i of a pattern is the step for element i of the dither array.
+*
+*******************************************************************************/
+void `$INSTANCE_NAME`_InitDither(void)
+{
+   uint8 lsb;
+   uint8 i;
+   
+   for(lsb=0; lsb <= `$INSTANCE_NAME`_DITHER_SIZE; lsb++)
+   {
+		for(i=0; i < `$INSTANCE_NAME`_DITHER_WORDS; i++)
+		{
+			`$INSTANCE_NAME`_ditherPatterns[lsb][i] = 0u;
+		}
+		for(i=0; i < `$INSTANCE_NAME`_DITHER_SIZE; i++)
+		{
+			if((lsb < `$INSTANCE_NAME`_DITHER_SIZE) && (i <= lsb))
+			{
+				`$INSTANCE_NAME`_ditherPatterns[lsb][i / 4u] |= ((uint32)1u << (8u * (i % 4u)));
+			}
+		}
+   }
+}
+
+
 /*******************************************************************************
 * Function Name: `$INSTANCE_NAME`_SetValue
 ********************************************************************************
@@ -212,6 +264,9 @@ void `$INSTANCE_NAME`_SetRange(uint8 range)  `=ReentrantKeil($INSTANCE_NAME . "_
 *  (void) 
 *
 * Theory: 
+*  The dither array is the MSB plus the pattern for the LSB made by
+*  InitDither, written 4 elements at a time with no branch per element.  At
+*  the max MSB value the all 0 pattern is used so every element is 0xFF.
 *
 * Side Effects:
 *
@@ -221,6 +276,8 @@ void `$INSTANCE_NAME`_SetValue(uint16 value)  `=ReentrantKeil($INSTANCE_NAME . "
    uint8 msb;
    uint8 lsb;
    uint8 i;
+   uint32 msbWord;
+   const uint32 *pattern;
    
    `$INSTANCE_NAME`_currentValue = value;
    msb = (uint8)(value >> `$INSTANCE_NAME`_SHIFT_LEN); 
@@ -228,25 +285,14 @@ void `$INSTANCE_NAME`_SetValue(uint16 value)  `=ReentrantKeil($INSTANCE_NAME . "
    
    if (msb == 0xFF)     /* If DAC is at max value force limit */
    {
-   		for(i=0; i < `$INSTANCE_NAME`_DITHER_SIZE; i++)
-		{
-	  		`$INSTANCE_NAME`_DArray[i] = 0xFF;
-		}
+   		lsb = `$INSTANCE_NAME`_DITHER_SIZE;
    }
-   else
+   msbWord = msb * `$INSTANCE_NAME`_MSB_TO_WORD;
+   pattern = `$INSTANCE_NAME`_ditherPatterns[lsb];
+   for(i=0; i < `$INSTANCE_NAME`_DITHER_WORDS; i++)
    {
-		for(i=0; i < `$INSTANCE_NAME`_DITHER_SIZE; i++)
-		{
-			if(i > lsb )
-			{
-				`$INSTANCE_NAME`_DArray[i] = msb;  
-			}
-			else
-			{
-				`$INSTANCE_NAME`_DArray[i] = msb+1;
-			}
-		}
-	}
+		`$INSTANCE_NAME`_DArrayWords[i] = msbWord + pattern[i];  /* msb+1 is at most 0xFF so no carry into the next byte */
+   }
 }
 
 
@@ -56,6 +56,7 @@ void `$INSTANCE_NAME`_SetRange(uint8 range) `=ReentrantKeil($INSTANCE_NAME . "_S
 void `$INSTANCE_NAME`_SetValue(uint16 value)`=ReentrantKeil($INSTANCE_NAME . "_SetValue")`;
 void `$INSTANCE_NAME`_DacTrim(void)         `=ReentrantKeil($INSTANCE_NAME . "_DacTrim")`;
 void `$INSTANCE_NAME`_setupDMA(void)        `=ReentrantKeil($INSTANCE_NAME . "_setupDMA")`;
+void `$INSTANCE_NAME`_InitDither(void);
 void `$INSTANCE_NAME`_Init(void)            `=ReentrantKeil($INSTANCE_NAME . "_Init")`;
 void `$INSTANCE_NAME`_Enable(void)          `=ReentrantKeil($INSTANCE_NAME . "_Enable")`;
 void `$INSTANCE_NAME`_SaveConfig(void);
@@ -87,6 +88,8 @@ void `$INSTANCE_NAME`_Wakeup(void)          `=ReentrantKeil($INSTANCE_NAME . "_W
 #define `$INSTANCE_NAME`_SHIFT_LEN         (`$Resolution`-8)  /* Data Shift */
 #define `$INSTANCE_NAME`_DITHER_SIZE       (1<<(`$Resolution`-8)) /* Size of dither array */
 #define `$INSTANCE_NAME`_LSB_MASK          (`$INSTANCE_NAME`_DITHER_SIZE - 1)          /* Used to mask of the LSbs */
+#define `$INSTANCE_NAME`_DITHER_WORDS      ((`$INSTANCE_NAME`_DITHER_SIZE + 3) / 4)    /* Dither array as 32-bit words */
+#define `$INSTANCE_NAME`_MSB_TO_WORD       0x01010101u                    /* Copies the MSB to each byte of a word */
 
 
 /* DMA Configuration for DAC_DMA */
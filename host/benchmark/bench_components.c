@@ -0,0 +1,63 @@
+/*******************************************************************************
+* File Name: bench_components.c
+*
+* Description:
+*  PSoC DAC components mocked with volatile variables in place of the data
+*  registers, and the DAC_SetValue the firmware used before the DAC functions
+*  were put in a table, for dac_isr_bench.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include "DAC.h"
+
+extern uint8_t bench_voltage_source;
+
+// mocked DAC data registers
+static volatile uint8 vdac_data_register;
+static volatile uint16 dvdac_data_register;
+static volatile uint16 midac_data_register;
+static volatile uint16 pidac_data_register;
+
+void VDAC_source_Start(void) {}
+void VDAC_source_Stop(void) {}
+void VDAC_source_Sleep(void) {}
+void VDAC_source_Wakeup(void) {}
+void VDAC_source_SetValue(uint8 value) { vdac_data_register = value; }
+void DVDAC_Start(void) {}
+void DVDAC_Stop(void) {}
+void DVDAC_Sleep(void) {}
+void DVDAC_Wakeup(void) {}
+void DVDAC_SetValue(uint16 value) { dvdac_data_register = value; }
+void MIDAC_source_Start(void) {}
+void MIDAC_source_Stop(void) {}
+void MIDAC_source_Sleep(void) {}
+void MIDAC_source_Wakeup(void) {}
+void MIDAC_source_SetValue(uint16 value) { midac_data_register = value; }
+void PIDAC_source_Start(void) {}
+void PIDAC_source_Stop(void) {}
+void PIDAC_source_Sleep(void) {}
+void PIDAC_source_Wakeup(void) {}
+void PIDAC_source_SetValue(uint16 value) { pidac_data_register = value; }
+void AMux_V_source_Select(uint8 channel) { (void)channel; }
+uint8_t helper_check_voltage_source(void) { return bench_voltage_source; }
+void isr_dac_SetVector(cyisraddress address) { (void)address; }
+
+// call an isr the way the interrupt vector does, out of line so it is not inlined
+void bench_isr_vector(void (*isr)(void)) {
+    isr();
+}
+
+// how DAC_SetValue picked the DAC on every call before
+void branch_DAC_SetValue(uint16_t value) {
+    if (selected_voltage_source == VDAC_IS_DVDAC) {
+        DVDAC_SetValue(value);
+    }
+    else {
+        VDAC_source_SetValue(value);
+    }
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,146 @@
+/*******************************************************************************
+* File Name: dac_isr_bench.c
+*
+* Description:
+*  Time the body of the DAC isr on the host with the DAC registers mocked as
+*  volatile variables.  Each isr is called through a function pointer like the
+*  interrupt vector calls it.
+*   branch: checks selected_voltage_source each sample like DAC_SetValue used to
+*   ops table: calls the DAC through the DacOps table picked by DAC_Start
+*   isr per DAC: the isr DAC_Start puts in the vector calls its DAC directly,
+*                this is what the firmware uses
+*  DAC.c is the firmware file so the tables are the ones the firmware builds.
+*  The mocked components and the old DAC_SetValue are in bench_components.c so
+*  they are not inlined, like the PSoC component APIs and the old DAC.c
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "DAC.h"
+#undef printf  // globals.h turns printf off for the firmware
+
+#define BENCH_LUT_LENGTH    4000
+#define BENCH_SAMPLES       20000000u
+#define BENCH_REPEATS       5  // the fastest repeat is reported
+
+// lut_index and lut_value are the globals.h variables the firmware isrs use
+uint8_t bench_voltage_source;  // what the mocked EEPROM says the voltage source is
+static uint16_t bench_lut[BENCH_LUT_LENGTH];
+static uint16_t lut_length = BENCH_LUT_LENGTH;
+
+void branch_DAC_SetValue(uint16_t value);  // in bench_components.c
+void bench_isr_vector(void (*isr)(void));  // in bench_components.c
+
+/**************************************
+*      DAC isr bodies, as in main.c
+**************************************/
+
+// the end of the run is not timed, start the look up table again
+static void bench_run_done(void) {
+    lut_index = 0;
+}
+
+static void dacInterruptBranch(void) {
+    branch_DAC_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) {
+        bench_run_done();
+    }
+    lut_value = bench_lut[lut_index];
+}
+
+static void dacInterruptOpsTable(void) {
+    DAC_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) {
+        bench_run_done();
+    }
+    lut_value = bench_lut[lut_index];
+}
+
+void dacInterruptVdac(void) {
+    VDAC_source_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) {
+        bench_run_done();
+    }
+    lut_value = bench_lut[lut_index];
+}
+
+void dacInterruptDvdac(void) {
+    DVDAC_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) {
+        bench_run_done();
+    }
+    lut_value = bench_lut[lut_index];
+}
+
+void dacInterruptMidac(void) {
+    MIDAC_source_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) {
+        bench_run_done();
+    }
+    lut_value = bench_lut[lut_index];
+}
+
+void dacInterruptPidac(void) {
+    PIDAC_source_SetValue(lut_value);
+    lut_index++;
+    if (lut_index >= lut_length) {
+        bench_run_done();
+    }
+    lut_value = bench_lut[lut_index];
+}
+
+/**************************************
+*      Timing
+**************************************/
+
+static double bench_ns_per_sample(void (*isr)(void)) {
+    double best_ns = 0;
+    for (uint8_t repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        struct timespec start, end;
+        lut_index = 0;
+        lut_value = bench_lut[0];
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+            bench_isr_vector(isr);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double ns = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_SAMPLES;
+        if ((repeat == 0) || (ns < best_ns)) {
+            best_ns = ns;
+        }
+    }
+    return best_ns;
+}
+
+int main(void) {
+    const char *names[] = {"", "VDAC", "DVDAC"};
+    for (uint16_t i = 0; i < BENCH_LUT_LENGTH; i++) {
+        bench_lut[i] = rand() & 0xFFF;
+    }
+    printf("ns per DAC isr, fastest of %d runs of %u samples\n", BENCH_REPEATS, BENCH_SAMPLES);
+    printf("%-6s %10s %10s %12s %8s\n", "DAC", "branch", "ops table", "isr per DAC", "saving");
+    // the branch version only knew the VDAC and DVDAC
+    for (uint8_t source = VDAC_IS_VDAC; source <= VDAC_IS_DVDAC; source++) {
+        bench_voltage_source = source;
+        DAC_Start();  // binds dac_ops and sets selected_voltage_source for the branch version
+        double branch_ns = bench_ns_per_sample(dacInterruptBranch);
+        double ops_ns = bench_ns_per_sample(dacInterruptOpsTable);
+        double isr_ns = bench_ns_per_sample(dac_ops->isr);
+        printf("%-6s %10.2f %10.2f %12.2f %7.1f%%\n", names[source], branch_ns, ops_ns, isr_ns,
+               100.0 * (branch_ns - isr_ns) / branch_ns);
+    }
+    return 0;
+}
+
+/* [] END OF FILE */
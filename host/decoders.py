@@ -0,0 +1,334 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Decode the data export formats the potentiostat can send through the USB.
+The format is selected on the device with the "O|X" command.
+"""
+
+__author__ = "Kyle Vitatus Lopin"
+
+# standard libraries
+import binascii
+import struct
+
+EXPORT_FORMAT_RAW16 = 0
+EXPORT_FORMAT_PACKED = 1
+EXPORT_FORMAT_PICOAMPS = 2
+EXPORT_FORMAT_SWV_DIFFERENCE = 3
+EXPORT_FORMAT_SWV_ALL = 4
+
+# calibration table sent with the 'k' command, see calibrate.h
+CAL_TABLE_VERSION = 1
+CAL_TIA_RESISTORS = 8
+CAL_ADC_GAINS = 4
+CAL_ADC_CONFIGS = 2
+CAL_ENTRY_SIZE = 24
+CAL_TABLE_SIZE = CAL_TIA_RESISTORS * CAL_ADC_GAINS * CAL_ADC_CONFIGS * CAL_ENTRY_SIZE
+CAL_DATA_SIZE = 20  # bytes of one calibration, the 'B' command
+CAL_SWEEP_SIZE = CAL_TIA_RESISTORS * CAL_ADC_GAINS * CAL_DATA_SIZE
+CAL_FIT_SIZE = 16  # N point calibration result, the 'n' command
+
+# automatic ranging log sent with the 'w' command, see autorange.h
+AUTORANGE_LOG_SIZE = 32
+AUTORANGE_LOG_HEADER_SIZE = 4
+AUTORANGE_EVENT_SIZE = 8
+AUTORANGE_EXPORT_SIZE = AUTORANGE_LOG_HEADER_SIZE + AUTORANGE_EVENT_SIZE * AUTORANGE_LOG_SIZE
+
+# peak summary sent after a voltammetry run, see peaks.h
+PEAKS_VERSION = 1
+PEAKS_HEADER_SIZE = 4
+PEAKS_ENTRY_SIZE = 16
+
+# chronocoulometry charge trace sent with the 'J' command, see coulometry.h
+COULOMETRY_VERSION = 1
+COULOMETRY_HEADER_SIZE = 16
+COULOMETRY_FRACTION_BITS = 16
+PWM_CLOCK_HZ = 240000  # clock of the timer that sets the sample rate
+
+# statistics of an amperometry buffer sent instead of "DoneX" after 'Z|1', see block_stats.h
+BLOCK_STATS_VERSION = 1
+BLOCK_STATS_SIZE = 32
+BLOCK_STATS_FRACTION_BITS = 16
+
+
+def decode_raw16(data: bytes) -> list[int]:
+    """
+    Decode data sent in the raw 16-bit format, 2 bytes per sample little endian
+    Args:
+        data: bytes received from the device
+
+    Returns: list of the ADC readings
+
+    """
+    return list(struct.unpack(f"<{len(data) // 2}h", data[:2 * (len(data) // 2)]))
+
+
+def decode_picoamps(data: bytes) -> list[int]:
+    """
+    Decode data sent in the picoamp format, the device converts each ADC
+    reading to pA with its calibration and sends 4 bytes per sample
+    little endian
+    Args:
+        data: bytes received from the device
+
+    Returns: list of the currents in pA
+
+    """
+    return list(struct.unpack(f"<{len(data) // 4}i", data[:4 * (len(data) // 4)]))
+
+
+def swv_steps(lut_length: int) -> int:
+    """ Number of square wave steps the device sends in the square wave
+    formats for a look up table of lut_length, see export_swv_steps """
+    return max(lut_length - 1, 0) // 2
+
+
+def decode_swv_difference(data: bytes) -> list[int]:
+    """
+    Decode data sent in the square wave difference format, 2 bytes per step
+    little endian of the forward minus the reverse reading
+    Args:
+        data: bytes received from the device
+
+    Returns: list of the differences of each step
+
+    """
+    return decode_raw16(data)
+
+
+def decode_swv_all(data: bytes) -> list[tuple[int, int, int]]:
+    """
+    Decode data sent in the square wave format with every reading, 6 bytes
+    per step little endian of the forward, reverse and difference readings
+    Args:
+        data: bytes received from the device
+
+    Returns: list of (forward, reverse, difference) of each step
+
+    """
+    values = decode_raw16(data[:6 * (len(data) // 6)])
+    return [tuple(values[i:i + 3]) for i in range(0, len(values), 3)]
+
+
+def unpack_samples(data: bytes, bits: int, count: int,
+                   signed: bool = True) -> list[int]:
+    """
+    Unpack samples from a little endian bit stream where the first sample
+    is in the lowest bits of the first byte.
+    Args:
+        data: packed bytes, without the header byte
+        bits: number of bits each sample was packed with
+        count: number of samples to unpack
+        signed: sign extend each sample from the packed number of bits
+
+    Returns: list of the ADC readings
+
+    """
+    stream = int.from_bytes(data, "little")
+    mask = (1 << bits) - 1
+    samples = []
+    for i in range(count):
+        value = (stream >> (i * bits)) & mask
+        if signed and value & (1 << (bits - 1)):
+            value -= 1 << bits
+        samples.append(value)
+    return samples
+
+
+def decode_packed(data: bytes, count: int, signed: bool = True) -> list[int]:
+    """
+    Decode data sent in the packed format, the first byte is the number
+    of bits per sample and the rest is the packed bit stream
+    Args:
+        data: bytes received from the device, including the header byte
+        count: number of samples that were requested
+        signed: sign extend each sample from the packed number of bits
+
+    Returns: list of the ADC readings
+
+    """
+    bits = data[0]
+    return unpack_samples(data[1:], bits, count, signed)
+
+
+def packed_size(count: int, bits: int) -> int:
+    """ Number of bytes the device sends for count samples in the packed
+    format, including the header byte """
+    return 1 + (count * bits + 7) // 8
+
+
+def decode_calibration_table(data: bytes) -> dict:
+    """
+    Decode the calibration table sent with the 'k' command.  Entries with
+    the wrong version, index or CRC were never saved and are left out.
+    Args:
+        data: the CAL_TABLE_SIZE bytes received from the device
+
+    Returns: dictionary with (TIA resistor index, ADC buffer gain index,
+    ADC configuration) keys and values of (IDAC values, ADC readings), the
+    same 5 points the 'B' command sends
+
+    """
+    table = {}
+    for index in range(len(data) // CAL_ENTRY_SIZE):
+        entry = data[index * CAL_ENTRY_SIZE:(index + 1) * CAL_ENTRY_SIZE]
+        version, entry_index, crc = struct.unpack_from("<BBH", entry, 20)
+        if (version != CAL_TABLE_VERSION or entry_index != index or
+                crc != binascii.crc_hqx(entry[:22], 0xFFFF)):
+            continue
+        points = struct.unpack_from("<10h", entry)
+        resistor = index % CAL_TIA_RESISTORS
+        gain = (index // CAL_TIA_RESISTORS) % CAL_ADC_GAINS
+        adc_config = index // (CAL_TIA_RESISTORS * CAL_ADC_GAINS) + 1
+        table[(resistor, gain, adc_config)] = (points[:5], points[5:])
+    return table
+
+
+def decode_calibration_sweep(data: bytes) -> dict:
+    """
+    Decode the results of the calibration sweep sent with the 'b' command
+    Args:
+        data: the CAL_SWEEP_SIZE bytes received from the device
+
+    Returns: dictionary with (TIA resistor index, ADC buffer gain index) keys
+    and values of (IDAC values, ADC readings), the same 5 points the 'B'
+    command sends
+
+    """
+    sweep = {}
+    for index in range(len(data) // CAL_DATA_SIZE):
+        values = struct.unpack_from("<10h", data, index * CAL_DATA_SIZE)
+        key = (index % CAL_TIA_RESISTORS, index // CAL_TIA_RESISTORS)
+        sweep[key] = (values[:5], values[5:])
+    return sweep
+
+
+def decode_calibration_fit(data: bytes) -> dict:
+    """
+    Decode the result of the N point calibration sent with the 'n' command
+    Args:
+        data: the CAL_FIT_SIZE bytes received from the device
+
+    Returns: dictionary with the fitted "pA_per_count" and "offset_pA", the
+    "max_residual_pA" and which point it was at, the number of "points" and
+    if the fit is "valid"
+
+    """
+    (slope_q16, offset, max_residual, points,
+     max_residual_index, valid, _) = struct.unpack("<3i4B", data[:CAL_FIT_SIZE])
+    return {"pA_per_count": slope_q16 / 65536, "offset_pA": offset,
+            "max_residual_pA": max_residual, "max_residual_index": max_residual_index,
+            "points": points, "valid": bool(valid)}
+
+
+def decode_autorange_log(data: bytes) -> dict:
+    """
+    Decode the log of the range changes sent with the 'w' command
+    Args:
+        data: the AUTORANGE_EXPORT_SIZE bytes received from the device
+
+    Returns: dictionary with the number of "dropped" events that did not fit
+    in the log, if autoranging is "enabled", the "range" in use as
+    (TIA resistor index, ADC buffer gain index) and the "events" as a list of
+    (block number, ADC buffer, first sample index, TIA resistor index,
+    ADC buffer gain index), the first event of a run is the range it started with
+
+    """
+    count, dropped, range_code, enabled = struct.unpack_from("<4B", data)
+    events = []
+    for index in range(count):
+        block, sample_index, adc_buffer, gain_code = struct.unpack_from(
+            "<IHBB", data, AUTORANGE_LOG_HEADER_SIZE + AUTORANGE_EVENT_SIZE * index)
+        events.append((block, adc_buffer, sample_index, gain_code & 0x0F, gain_code >> 4))
+    return {"dropped": dropped, "enabled": bool(enabled), "range": (range_code & 0x0F, range_code >> 4),
+            "events": events}
+
+
+def peaks_size(header: bytes) -> int:
+    """ Number of bytes of the peak summary, from its first PEAKS_HEADER_SIZE bytes """
+    return PEAKS_HEADER_SIZE + PEAKS_ENTRY_SIZE * header[1]
+
+
+def decode_peaks(data: bytes) -> dict:
+    """
+    Decode the peak summary the device sends after a voltammetry run when
+    it was turned on with the 'p' command
+    Args:
+        data: the header and peak entries received from the device
+
+    Returns: dictionary with the "version", the number of "sweeps" in the run,
+    the number of peaks "dropped" because they did not fit and the "peaks" as
+    a list of dictionaries with the sample_index, dac_value, potential_mV,
+    counts, current_pA, sweep and direction of each peak
+
+    """
+    version, count, sweeps, dropped = struct.unpack_from("<4B", data)
+    peaks = []
+    for index in range(count):
+        values = struct.unpack_from("<HHhhiBb", data, PEAKS_HEADER_SIZE + PEAKS_ENTRY_SIZE * index)
+        peaks.append(dict(zip(["sample_index", "dac_value", "potential_mV", "counts",
+                               "current_pA", "sweep", "direction"], values)))
+    return {"version": version, "sweeps": sweeps, "dropped": dropped, "peaks": peaks}
+
+
+def coulometry_size(header: bytes) -> int:
+    """ Number of bytes of the charge trace, from its first COULOMETRY_HEADER_SIZE bytes """
+    return COULOMETRY_HEADER_SIZE + 8 * struct.unpack_from("<H", header, 2)[0]
+
+
+def decode_coulometry(data: bytes) -> dict:
+    """
+    Decode the chronocoulometry charge trace sent with the 'J' command
+    Args:
+        data: the header and charge points received from the device
+
+    Returns: dictionary with the "version", if points were "dropped" because
+    they did not fit, the "samples_per_point", the number of readings in the
+    "baseline" and its average "baseline_counts", the number of
+    "samples_integrated" and the "charge" of each point in ADC counts * samples
+
+    """
+    (version, dropped, points, samples_per_point, baseline_samples,
+     baseline_q16, samples_integrated) = struct.unpack_from("<BBHHHiI", data)
+    charge = struct.unpack_from(f"<{points}q", data, COULOMETRY_HEADER_SIZE)
+    scale = 1 << COULOMETRY_FRACTION_BITS
+    return {"version": version, "dropped": bool(dropped),
+            "samples_per_point": samples_per_point, "baseline": baseline_samples,
+            "baseline_counts": baseline_q16 / scale,
+            "samples_integrated": samples_integrated,
+            "charge": [q / scale for q in charge]}
+
+
+def charge_to_coulombs(charge: float, pA_per_count: float, timer_period: int) -> float:
+    """
+    Convert a charge point in ADC counts * samples to coulombs
+    Args:
+        charge: charge point from decode_coulometry
+        pA_per_count: current of 1 ADC count, from the calibration
+        timer_period: PWM period set with the 'Q' command, the time between samples
+
+    Returns: charge in coulombs
+
+    """
+    return charge * pA_per_count * 1e-12 * (timer_period + 1) / PWM_CLOCK_HZ
+
+
+def decode_block_stats(data: bytes) -> dict:
+    """
+    Decode the statistics of an amperometry buffer sent in the block statistics mode
+    Args:
+        data: the BLOCK_STATS_SIZE bytes received from the device
+
+    Returns: dictionary with the "version", the "adc_buffer" the readings can be
+    read from with 'F', the number of readings "count", the "block" number, the
+    "mean", "std" (population standard deviation), "min" and "max" in ADC counts,
+    the "slope" in ADC counts per sample and the device uptime "time_ms"
+
+    """
+    (version, adc_buffer, count, block, mean_q16, std_q16, minimum, maximum,
+     slope_q16, time_ms) = struct.unpack_from("<BBHIiIhhiI", data)
+    scale = 1 << BLOCK_STATS_FRACTION_BITS
+    return {"version": version, "adc_buffer": adc_buffer, "count": count,
+            "block": block, "mean": mean_q16 / scale, "std": std_q16 / scale,
+            "min": minimum, "max": maximum, "slope": slope_q16 / scale,
+            "time_ms": time_ms}
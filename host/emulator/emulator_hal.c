@@ -0,0 +1,540 @@
+/*******************************************************************************
+* File Name: emulator_hal.c
+*
+* Description:
+*  Run the potentiostat firmware on Linux.  The USBUART is replaced by a
+*  pseudo-terminal so the acquisition software can connect to it like a real
+*  device, and the PWM that times the experiments is simulated from the system
+*  clock to fire the dac, adc and amperometry isrs.
+*
+*  There are no real interrupts, the isrs are fired when the firmware calls into
+*  the hardware layer (polling the USB, waiting on a delay, etc.), the same places
+*  the main loop spends its time on the device.  The electrodes are a simulated
+*  resistor so the data looks like a real measurement.
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "project.h"
+
+/**************************************
+*      Constants
+**************************************/
+
+#define PWM_CLOCK_HZ            240000  // clock of the PWM that times the isrs
+#define USB_PACKET_SIZE         64
+#define SYSTICK_RELOAD          23999  // 1 ms at a 24 MHz bus clock
+#define MAX_TICKS_PER_SERVICE   100000  // don't stall forever if the host was stopped in a debugger
+#define CELL_RESISTANCE_OHMS    100000.0  // simulated resistor between the electrodes
+#define ADC_FULL_SCALE_COUNTS   32768.0
+#define IDAC_AMPS_PER_BIT       0.125e-6
+#define ADC_CONVERSION_NS       100000  // 10 ksps
+#define TIA_SETTLE_TAU_NS       1000000.0  // time constant of the TIA after the current changes
+
+int firmware_main(void);  // main.c compiled with -Dmain=firmware_main
+
+static const double tia_resistor_ohms[] = {20e3, 30e3, 40e3, 80e3, 120e3, 250e3, 500e3, 1000e3};
+
+/**************************************
+*      Emulator state
+**************************************/
+
+struct EmulatedIsr {
+    cyisraddress address;
+    uint8 enabled;
+};
+static struct EmulatedIsr emu_isr_dac, emu_isr_adc, emu_isr_adcAmp;
+
+static int pty_fd = -1;
+static uint8 rx_buffer[USB_PACKET_SIZE];
+static uint16 rx_count = 0;
+
+static uint8 pwm_running = 0;
+static uint16 pwm_period = 1000;
+static uint64_t last_tick_ns = 0;
+static uint8 in_isr = 0;
+
+static cySysTickCallback systick_callbacks[CY_SYS_SYST_NUM_OF_CALLBACKS];
+static uint8 systick_running = 0;
+static uint64_t systick_last_ns = 0;
+
+static uint8 adc_config = 2;
+static uint8 adc_buffer_gain = 0;
+static uint8 tia_resistor_index = 0;
+static uint8 v_source_channel = 0;
+static uint16 vdac_value = 128;
+static uint16 dvdac_value = 2048;
+static uint16 midac_value = 2048;
+static uint16 pidac_value = 1024;
+static uint8 tia_input_channel = 1;
+static uint8 idac_value = 0;
+static uint8 idac_polarity = IDAC_calibrate_SOURCE;
+static double idac_amps_before = 0;  // current before the last IDAC change, for the settling
+static uint64_t idac_change_ns = 0;
+static uint64_t last_conversion_ns = 0;
+static uint32 noise_seed = 12345;
+
+static uint8 eeprom[CYDEV_EE_SIZE];
+static const char *eeprom_file = NULL;
+
+// statistics printed when the emulator exits
+static uint64_t usb_bytes_out = 0;
+static uint64_t isr_ticks = 0;
+
+/**************************************
+*      Time and the simulated PWM
+**************************************/
+
+static uint64_t emu_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Fire the isrs for every PWM period that has passed since the last call.
+ * The adc is read before the dac is changed, like the PWM compare is set up on the device */
+static void emu_systick_service(void) {
+    if (!systick_running) {
+        return;
+    }
+    uint64_t now = emu_now_ns();
+    while (now - systick_last_ns >= 1000000ULL) {
+        systick_last_ns += 1000000ULL;
+        for (uint8 i = 0; i < CY_SYS_SYST_NUM_OF_CALLBACKS; i++) {
+            if (systick_callbacks[i]) {
+                systick_callbacks[i]();
+            }
+        }
+    }
+}
+
+static void emu_service(void) {
+    if (in_isr) {
+        return;
+    }
+    emu_systick_service();
+    if (!pwm_running) {
+        return;
+    }
+    uint64_t period_ns = (uint64_t)(pwm_period + 1) * 1000000000ULL / PWM_CLOCK_HZ;
+    uint64_t now = emu_now_ns();
+    uint32 ticks = 0;
+    in_isr = 1;
+    while ((now - last_tick_ns >= period_ns) && (ticks < MAX_TICKS_PER_SERVICE)) {
+        last_tick_ns += period_ns;
+        ticks++;
+        if (emu_isr_adc.enabled && emu_isr_adc.address) {
+            emu_isr_adc.address();
+        }
+        if (emu_isr_adcAmp.enabled && emu_isr_adcAmp.address) {
+            emu_isr_adcAmp.address();
+        }
+        if (emu_isr_dac.enabled && emu_isr_dac.address) {
+            emu_isr_dac.address();
+        }
+    }
+    if (ticks >= MAX_TICKS_PER_SERVICE) {
+        last_tick_ns = now;
+    }
+    isr_ticks += ticks;
+    in_isr = 0;
+}
+
+static void emu_pwm_restart(void) {
+    last_tick_ns = emu_now_ns();
+}
+
+void CyDelay(uint32 milliseconds) {
+    uint64_t end = emu_now_ns() + (uint64_t)milliseconds * 1000000ULL;
+    while (emu_now_ns() < end) {
+        emu_service();
+        usleep(100);
+    }
+}
+
+// the isrs only run in emu_service, which does nothing while in_isr is set
+uint8 CyEnterCriticalSection(void) {
+    uint8 saved = in_isr;
+    in_isr = 1;
+    return saved;
+}
+
+void CyExitCriticalSection(uint8 savedIntrStatus) {
+    in_isr = savedIntrStatus;
+}
+
+void CyDelayUs(uint16 microseconds) {
+    usleep(microseconds);
+    emu_service();
+}
+
+void CySysTickStart(void) {
+    systick_running = 1;
+    systick_last_ns = emu_now_ns();
+}
+
+cySysTickCallback CySysTickSetCallback(uint32 number, cySysTickCallback function) {
+    cySysTickCallback old_function = systick_callbacks[number];
+    systick_callbacks[number] = function;
+    return old_function;
+}
+
+uint32 CySysTickGetValue(void) {
+    emu_systick_service();
+    uint64_t since_reload_ns = emu_now_ns() - systick_last_ns;
+    if (since_reload_ns >= 1000000ULL) {
+        return 0;
+    }
+    return SYSTICK_RELOAD - (uint32)(since_reload_ns * (SYSTICK_RELOAD + 1) / 1000000ULL);
+}
+
+uint32 CySysTickGetReload(void) {
+    return SYSTICK_RELOAD;
+}
+
+void CyWdtStart(uint8 ticks, uint8 lpMode) {}
+void CyWdtClear(void) {}
+
+/**************************************
+*      Interrupts
+**************************************/
+
+#define EMU_ISR(name) \
+    void name##_StartEx(cyisraddress address) { emu_##name.address = address; emu_##name.enabled = 1; } \
+    void name##_Enable(void) { emu_##name.enabled = 1; } \
+    void name##_Disable(void) { emu_##name.enabled = 0; } \
+    void name##_SetVector(cyisraddress address) { emu_##name.address = address; } \
+    uint8 name##_GetState(void) { return emu_##name.enabled; }
+
+EMU_ISR(isr_dac)
+EMU_ISR(isr_adc)
+EMU_ISR(isr_adcAmp)
+
+/**************************************
+*      USBUART on a pseudo-terminal
+**************************************/
+
+static void emu_pty_write(const uint8 *data, uint16 length) {
+    while (length) {
+        ssize_t written = write(pty_fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno == EAGAIN) || (errno == EIO)) {  // host not reading yet or not connected
+                usleep(1000);
+                continue;
+            }
+            perror("emulator: write");
+            exit(1);
+        }
+        data += written;
+        length -= written;
+        usb_bytes_out += written;
+    }
+}
+
+void USBUART_Start(uint8 device, uint8 mode) {}
+uint8 USBUART_GetConfiguration(void) { return 1; }
+uint8 USBUART_CDC_Init(void) { return 1; }
+
+uint16 USBUART_GetCount(void) {
+    emu_service();
+    if (rx_count == 0) {
+        struct pollfd fds = {pty_fd, POLLIN, 0};
+        if ((poll(&fds, 1, 1) > 0) && (fds.revents & POLLIN)) {
+            ssize_t num_read = read(pty_fd, rx_buffer, USB_PACKET_SIZE);
+            if (num_read > 0) {
+                rx_count = num_read;
+            }
+        }
+    }
+    return rx_count;
+}
+
+uint16 USBUART_GetData(uint8 *pData, uint16 length) {
+    if (length > rx_count) {
+        length = rx_count;
+    }
+    memcpy(pData, rx_buffer, length);
+    rx_count = 0;
+    return length;
+}
+
+uint8 USBUART_CDCIsReady(void) {
+    emu_service();
+    return 1;
+}
+
+void USBUART_PutData(const uint8 *pData, uint16 length) {
+    emu_pty_write(pData, length);
+}
+
+uint8 USBUART_GetEPState(uint8 epNumber) {
+    emu_service();
+    return USBUART_IN_BUFFER_EMPTY;
+}
+
+void USBUART_LoadInEP(uint8 epNumber, const uint8 *pData, uint16 length) {
+    emu_pty_write(pData, length);  // the pty is the only pipe to the host
+}
+
+/**************************************
+*      Simulated electrodes and ADC
+**************************************/
+
+static double emu_cell_volts(void) {
+    if (v_source_channel == 1) {
+        return (dvdac_value - 2048) * 0.001;  // DVDAC, 1 mV per bit
+    }
+    if (v_source_channel == 2) {
+        return (midac_value - 2048) * 0.001;  // MIDAC, 1 mV per bit
+    }
+    if (v_source_channel == 3) {
+        return (pidac_value - 1024) * 0.002;  // PIDAC, 2 mV per bit
+    }
+    return (vdac_value - 128) * 0.016;  // VDAC, 16 mV per bit
+}
+
+static double emu_idac_amps(void) {
+    double amps = idac_value * IDAC_AMPS_PER_BIT;
+    if (idac_polarity == IDAC_calibrate_SINK) {
+        amps = -amps;
+    }
+    return amps;
+}
+
+int16 ADC_SigDel_GetResult16(void) {
+    last_conversion_ns = emu_now_ns();
+    double amps;
+    if (tia_input_channel == 0) {  // the calibration IDAC is connected
+        amps = emu_idac_amps();
+        double settled = 1.0 - exp(-(double)(emu_now_ns() - idac_change_ns) / TIA_SETTLE_TAU_NS);
+        amps = idac_amps_before + (amps - idac_amps_before) * settled;
+    }
+    else {
+        amps = emu_cell_volts() / CELL_RESISTANCE_OHMS;
+    }
+    double vref = (adc_config == 1) ? 2.048 : 1.024;
+    double counts = amps * tia_resistor_ohms[tia_resistor_index & 7] * (1 << adc_buffer_gain)
+                    / vref * ADC_FULL_SCALE_COUNTS;
+    noise_seed = noise_seed * 1103515245u + 12345u;
+    counts += (int)((noise_seed >> 16) % 5) - 2;  // a few counts of noise
+    if (counts > 32767) {
+        counts = 32767;
+    }
+    if (counts < -32768) {
+        counts = -32768;
+    }
+    return (int16)counts;
+}
+
+void ADC_SigDel_Start(void) {}
+void ADC_SigDel_Sleep(void) {}
+void ADC_SigDel_Wakeup(void) {}
+void ADC_SigDel_StartConvert(void) {}
+void ADC_SigDel_SelectConfiguration(uint8 config, uint8 restart) { adc_config = config; }
+void ADC_SigDel_SetBufferGain(uint8 gain) { adc_buffer_gain = gain & 3; }
+uint8 ADC_SigDel_IsEndConversion(uint8 retMode) {
+    emu_service();
+    return emu_now_ns() - last_conversion_ns >= ADC_CONVERSION_NS;
+}
+
+/**************************************
+*      Analog blocks
+**************************************/
+
+#define EMU_BLOCK(name) \
+    void name##_Start(void) {} \
+    void name##_Stop(void) {} \
+    void name##_Sleep(void) {} \
+    void name##_Wakeup(void) {}
+
+EMU_BLOCK(TIA)
+EMU_BLOCK(VDAC_TIA)
+EMU_BLOCK(VDAC_source)
+EMU_BLOCK(DVDAC)
+EMU_BLOCK(MIDAC_source)
+EMU_BLOCK(PIDAC_source)
+EMU_BLOCK(Opamp_Aux)
+EMU_BLOCK(IDAC_calibrate)
+
+void TIA_SetResFB(uint8 res) { tia_resistor_index = res; }
+void VDAC_source_SetValue(uint8 value) { vdac_value = value; }
+void DVDAC_SetValue(uint16 value) { dvdac_value = value; }
+void MIDAC_source_SetValue(uint16 value) { midac_value = value; }
+void PIDAC_source_SetValue(uint16 value) { pidac_value = value; }
+static void emu_idac_change(void) {
+    idac_amps_before = emu_idac_amps();
+    idac_change_ns = emu_now_ns();
+}
+
+void IDAC_calibrate_SetValue(uint8 value) { emu_idac_change(); idac_value = value; }
+void IDAC_calibrate_SetPolarity(uint8 polarity) { emu_idac_change(); idac_polarity = polarity; }
+
+void PWM_isr_Start(void) { pwm_running = 1; emu_pwm_restart(); }
+void PWM_isr_Stop(void) { pwm_running = 0; }
+void PWM_isr_Sleep(void) { pwm_running = 0; }
+void PWM_isr_Wakeup(void) { pwm_running = 1; emu_pwm_restart(); }
+void PWM_isr_WritePeriod(uint16 period) { pwm_period = period; }
+void PWM_isr_WriteCompare(uint16 compare) {}
+void PWM_isr_WriteCounter(uint16 counter) { emu_pwm_restart(); }
+
+/**************************************
+*      Analog muxes
+**************************************/
+
+#define EMU_AMUX(name, on_select) \
+    void name##_Init(void) {} \
+    void name##_Select(uint8 channel) { on_select; } \
+    void name##_Connect(uint8 channel) {} \
+    void name##_Disconnect(uint8 channel) {}
+
+EMU_AMUX(AMux_electrode, (void)channel)
+EMU_AMUX(AMux_TIA_input, tia_input_channel = channel)
+EMU_AMUX(AMux_TIA_resistor_bypass, (void)channel)
+EMU_AMUX(AMux_V_source, v_source_channel = channel)
+
+/**************************************
+*      EEPROM, saved to a file if one is given
+**************************************/
+
+static void emu_eeprom_save(void) {
+    if (!eeprom_file) {
+        return;
+    }
+    FILE *file = fopen(eeprom_file, "wb");
+    if (file) {
+        fwrite(eeprom, 1, sizeof(eeprom), file);
+        fclose(file);
+    }
+}
+
+static void emu_eeprom_load(void) {
+    if (!eeprom_file) {
+        return;
+    }
+    FILE *file = fopen(eeprom_file, "rb");
+    if (file) {
+        if (fread(eeprom, 1, sizeof(eeprom), file) != sizeof(eeprom)) {
+            memset(eeprom, 0, sizeof(eeprom));
+        }
+        fclose(file);
+    }
+}
+
+void EEPROM_Start(void) {}
+void EEPROM_Stop(void) {}
+uint8 EEPROM_UpdateTemperature(void) { return 0; }
+
+uint8 EEPROM_WriteByte(uint8 dataByte, uint16 address) {
+    if (address >= CYDEV_EE_SIZE) {
+        return 1;
+    }
+    eeprom[address] = dataByte;
+    emu_eeprom_save();
+    return 0;
+}
+
+uint8 EEPROM_ReadByte(uint16 address) {
+    if (address >= CYDEV_EE_SIZE) {
+        return 0;
+    }
+    return eeprom[address];
+}
+
+uint8 EEPROM_Write(const uint8 *rowData, uint8 rowNumber) {
+    uint16 address = (uint16)rowNumber * CYDEV_EEPROM_ROW_SIZE;
+    if (address >= CYDEV_EE_SIZE) {
+        return 1;
+    }
+    memcpy(&eeprom[address], rowData, CYDEV_EEPROM_ROW_SIZE);
+    emu_eeprom_save();
+    return 0;
+}
+
+/**************************************
+*      Start up
+**************************************/
+
+static void emu_print_stats(void) {
+    fprintf(stderr, "emulator: %llu isr ticks, %llu bytes sent to the host\n",
+            (unsigned long long)isr_ticks, (unsigned long long)usb_bytes_out);
+}
+
+static void emu_stop(int signal_number) {
+    exit(0);  // run the atexit handlers
+}
+
+static int emu_open_pty(const char *link_name) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((fd < 0) || grantpt(fd) || unlockpt(fd)) {
+        perror("emulator: posix_openpt");
+        exit(1);
+    }
+    char *slave_name = ptsname(fd);
+    // make the slave side raw so the binary data is not changed by the line discipline
+    int slave = open(slave_name, O_RDWR | O_NOCTTY);
+    struct termios settings;
+    if ((slave >= 0) && (tcgetattr(slave, &settings) == 0)) {
+        cfmakeraw(&settings);
+        tcsetattr(slave, TCSANOW, &settings);
+    }
+    // the slave is left open so the master does not see a hang up between host connections
+    if (link_name) {
+        unlink(link_name);
+        if (symlink(slave_name, link_name)) {
+            perror("emulator: symlink");
+        }
+    }
+    printf("emulator pty: %s\n", slave_name);
+    fflush(stdout);
+    return fd;
+}
+
+static void emu_usage(const char *name) {
+    fprintf(stderr, "usage: %s [-l link] [-e eeprom_file]\n"
+                    "  -l link         make a symbolic link to the pseudo-terminal\n"
+                    "  -e eeprom_file  keep the EEPROM in a file between runs\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    const char *link_name = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "l:e:h")) != -1) {
+        switch (option) {
+        case 'l':
+            link_name = optarg;
+            break;
+        case 'e':
+            eeprom_file = optarg;
+            break;
+        default:
+            emu_usage(argv[0]);
+            return 2;
+        }
+    }
+    emu_eeprom_load();
+    pty_fd = emu_open_pty(link_name);
+    atexit(emu_print_stats);
+    signal(SIGINT, emu_stop);
+    signal(SIGTERM, emu_stop);
+    return firmware_main();
+}
+
+/* [] END OF FILE */
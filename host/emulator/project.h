@@ -0,0 +1,161 @@
+/*******************************************************************************
+* File Name: project.h
+*
+* Description:
+*  Hardware abstraction layer used to run the firmware on Linux.  This takes the
+*  place of the project.h that PSoC Creator generates, the functions are in
+*  emulator_hal.c and act like the PSoC components well enough for the firmware
+*  logic to run against a pseudo-terminal instead of the USBUART
+*
+**********************************************************************************
+ * Copyright Naresuan University, Phitsanulok Thailand
+ * Released under Creative Commons Attribution-ShareAlike  3.0 (CC BY-SA 3.0 US)
+*********************************************************************************/
+
+#ifndef _PROJECT_H_
+#define _PROJECT_H_
+
+#include "cytypes.h"  // the mock PSoC types in test/mock_files
+
+/**************************************
+*        cy_boot
+**************************************/
+
+#define CY_ISR(FuncName)        void FuncName(void)
+#define CY_ISR_PROTO(FuncName)  void FuncName(void)
+typedef void (*cyisraddress)(void);
+#define CyGlobalIntEnable
+#define CyGlobalIntDisable
+
+void CyDelay(uint32 milliseconds);
+void CyDelayUs(uint16 microseconds);
+uint8 CyEnterCriticalSection(void);
+void CyExitCriticalSection(uint8 savedIntrStatus);
+void CyWdtStart(uint8 ticks, uint8 lpMode);
+void CyWdtClear(void);
+
+#define CY_SYS_SYST_NUM_OF_CALLBACKS    5
+typedef void (*cySysTickCallback)(void);
+void CySysTickStart(void);
+cySysTickCallback CySysTickSetCallback(uint32 number, cySysTickCallback function);
+uint32 CySysTickGetValue(void);
+uint32 CySysTickGetReload(void);
+
+/**************************************
+*        Interrupts
+**************************************/
+
+#define EMU_ISR_PROTOS(name) \
+    void name##_StartEx(cyisraddress address); \
+    void name##_Enable(void); \
+    void name##_Disable(void); \
+    void name##_SetVector(cyisraddress address); \
+    uint8 name##_GetState(void);
+
+EMU_ISR_PROTOS(isr_dac)
+EMU_ISR_PROTOS(isr_adc)
+EMU_ISR_PROTOS(isr_adcAmp)
+
+/**************************************
+*        USBUART
+**************************************/
+
+#define USBUART_5V_OPERATION        1
+#define USBUART_3V_OPERATION        0
+#define USBUART_IN_BUFFER_EMPTY     2
+#define USBUART_IN_BUFFER_FULL      1
+
+void USBUART_Start(uint8 device, uint8 mode);
+uint8 USBUART_GetConfiguration(void);
+uint8 USBUART_CDC_Init(void);
+uint16 USBUART_GetCount(void);
+uint16 USBUART_GetData(uint8 *pData, uint16 length);
+uint8 USBUART_CDCIsReady(void);
+void USBUART_PutData(const uint8 *pData, uint16 length);
+uint8 USBUART_GetEPState(uint8 epNumber);
+void USBUART_LoadInEP(uint8 epNumber, const uint8 *pData, uint16 length);
+
+/**************************************
+*        Delta Sigma ADC
+**************************************/
+
+#define ADC_SigDel_CFG1_RESOLUTION  16
+#define ADC_SigDel_CFG2_RESOLUTION  16
+#define ADC_SigDel_RETURN_STATUS    1
+#define ADC_SigDel_WAIT_FOR_RESULT  0
+
+void ADC_SigDel_Start(void);
+void ADC_SigDel_Sleep(void);
+void ADC_SigDel_Wakeup(void);
+void ADC_SigDel_StartConvert(void);
+void ADC_SigDel_SelectConfiguration(uint8 config, uint8 restart);
+void ADC_SigDel_SetBufferGain(uint8 gain);
+int16 ADC_SigDel_GetResult16(void);
+uint8 ADC_SigDel_IsEndConversion(uint8 retMode);
+
+/**************************************
+*        Analog blocks
+**************************************/
+
+#define EMU_BLOCK_PROTOS(name) \
+    void name##_Start(void); \
+    void name##_Stop(void); \
+    void name##_Sleep(void); \
+    void name##_Wakeup(void);
+
+EMU_BLOCK_PROTOS(TIA)
+EMU_BLOCK_PROTOS(VDAC_TIA)
+EMU_BLOCK_PROTOS(VDAC_source)
+EMU_BLOCK_PROTOS(DVDAC)
+EMU_BLOCK_PROTOS(MIDAC_source)
+EMU_BLOCK_PROTOS(PIDAC_source)
+EMU_BLOCK_PROTOS(Opamp_Aux)
+EMU_BLOCK_PROTOS(IDAC_calibrate)
+EMU_BLOCK_PROTOS(PWM_isr)
+
+void TIA_SetResFB(uint8 res);
+void VDAC_source_SetValue(uint8 value);
+void DVDAC_SetValue(uint16 value);
+void MIDAC_source_SetValue(uint16 value);
+void PIDAC_source_SetValue(uint16 value);
+
+#define IDAC_calibrate_SOURCE       0
+#define IDAC_calibrate_SINK         4
+void IDAC_calibrate_SetValue(uint8 value);
+void IDAC_calibrate_SetPolarity(uint8 polarity);
+
+void PWM_isr_WritePeriod(uint16 period);
+void PWM_isr_WriteCompare(uint16 compare);
+void PWM_isr_WriteCounter(uint16 counter);
+
+/**************************************
+*        Analog muxes
+**************************************/
+
+#define EMU_AMUX_PROTOS(name) \
+    void name##_Init(void); \
+    void name##_Select(uint8 channel); \
+    void name##_Connect(uint8 channel); \
+    void name##_Disconnect(uint8 channel);
+
+EMU_AMUX_PROTOS(AMux_electrode)
+EMU_AMUX_PROTOS(AMux_TIA_input)
+EMU_AMUX_PROTOS(AMux_TIA_resistor_bypass)
+EMU_AMUX_PROTOS(AMux_V_source)
+
+/**************************************
+*        EEPROM
+**************************************/
+
+#define CYDEV_EE_SIZE               2048
+#define CYDEV_EEPROM_ROW_SIZE       16
+
+void EEPROM_Start(void);
+void EEPROM_Stop(void);
+uint8 EEPROM_UpdateTemperature(void);
+uint8 EEPROM_WriteByte(uint8 dataByte, uint16 address);
+uint8 EEPROM_ReadByte(uint16 address);
+uint8 EEPROM_Write(const uint8 *rowData, uint8 rowNumber);
+
+#endif
+/* [] END OF FILE */
@@ -60,7 +60,7 @@ def remove_compiled_files():
 
 def load(_filenames, function_names: list[str], header_includes: list[str] = [],
          compiled_file_end: str = "",
-         print_debug=True):
+         print_debug=True, mock_dir: str = None):
     """
     Takes in a list of c files and functions and makes a compiled module out
     of them that can be used in python programs.  Originally developed for
@@ -77,6 +77,9 @@ def load(_filenames, function_names: list[str], header_includes: list[str] = [],
         if you want to use a variable that is not in a file in _filenames
         compiled_file_end: string, the aggrecated source files will be made into
         1 c file with the name pytest_+comipiled_file_end
+        mock_dir: string, name of a folder in the mock_files folder with a
+        project.h to use instead of the default mock, e.g. 'usbuart' to record
+        the data sent through the USB
 
     Returns: the compiled files in a module
 
@@ -115,9 +118,11 @@ def load(_filenames, function_names: list[str], header_includes: list[str] = [],
     ffi_builder.cdef(cdef)
     # ffi_builder.new("struct RunParams run_params")
     # there should be mocked file in the current directory also so include that
+    include_dirs = [project_dir, ".", MOCK_FILE_DIR]
+    if mock_dir:  # search the special mock folder before the default mock files
+        include_dirs.insert(1, os.path.join(MOCK_FILE_DIR, mock_dir))
     ffi_builder.set_source(compiled_filename, source,
-                           include_dirs=[project_dir, ".",
-                                         MOCK_FILE_DIR])
+                           include_dirs=include_dirs)
     ffi_builder.compile()
     # import the module and return it
     sys.path.append(os.getcwd())  # make sure the file can be found
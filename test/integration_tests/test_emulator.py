@@ -0,0 +1,584 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+End to end test of the firmware running in the Linux emulator in host/emulator,
+the commands are sent through the emulator's pseudo-terminal like the
+acquisition software does with a real device
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import os
+import select
+import statistics
+import struct
+import binascii
+import subprocess
+import tempfile
+import time
+import tty
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+EMULATOR_DIR = os.path.join(helper_funcs.root_dir, 'host', 'emulator')
+
+
+class EmulatorTestCase(unittest.TestCase):
+    """ Build the emulator, start it, and talk to it through its pseudo-terminal
+
+    Attributes:
+        emulator: the running emulator process
+        pty: file descriptor of the pseudo-terminal the emulator made
+    """
+    @classmethod
+    def setUpClass(cls):
+        """ Build and start the emulator just one time for each test """
+        subprocess.run(['make', '-s', '-C', EMULATOR_DIR], check=True)
+        cls.eeprom_dir = tempfile.TemporaryDirectory()
+        cls.eeprom_file = os.path.join(cls.eeprom_dir.name, 'eeprom.bin')
+        cls.emulator = subprocess.Popen([os.path.join(EMULATOR_DIR, 'potentiostat_emulator'),
+                                         '-e', cls.eeprom_file],
+                                        stdout=subprocess.PIPE, universal_newlines=True)
+        pty_name = cls.emulator.stdout.readline().split(': ')[1].strip()
+        cls.pty = os.open(pty_name, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(cls.pty)
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        os.close(cls.pty)
+        cls.emulator.terminate()
+        cls.emulator.wait()
+        cls.eeprom_dir.cleanup()
+
+    def send(self, command: bytes):
+        """ Send a command and give the emulator time to process it """
+        os.write(self.pty, command)
+        time.sleep(0.05)
+
+    def read(self, num_bytes: int, timeout: float = 5.0) -> bytes:
+        """ Read num_bytes from the emulator or what came before the timeout """
+        data = b''
+        end_time = time.time() + timeout
+        while len(data) < num_bytes and time.time() < end_time:
+            ready, _, _ = select.select([self.pty], [], [], 0.1)
+            if ready:
+                data += os.read(self.pty, num_bytes - len(data))
+        return data
+
+    def test_identify(self):
+        """ Test the device identifies itself """
+        self.send(b'I')
+        self.assertEqual(self.read(21), b'Naresuan Potentiostat')
+
+    def test_cyclic_voltammetry(self):
+        """ Test a cyclic voltammetry look up table can be made and run,
+        and the data follows the triangle wave applied to the resistor """
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'g')
+        lut_length = struct.unpack('<H', self.read(2))[0]
+        self.assertEqual(lut_length, 42)
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        data = struct.unpack(f'<{lut_length + 1}h', self.read(2 * (lut_length + 1)))
+        self.assertEqual(data[-1], -16384, msg="end of run marker (0xC000) is missing")
+        peak = data.index(max(data[:-1]))
+        self.assertAlmostEqual(peak, lut_length // 2, delta=2)
+        self.send(b'e|0|0002|0003')
+        self.assertEqual(struct.unpack('<3h', self.read(6)), data[2:5])
+
+    def test_dvdac_isr(self):
+        """ Test the DAC isr follows the voltage source selected with 'V' """
+        self.send(b'VS2')
+        self.send(b'VR')
+        self.assertEqual(self.read(2), b'V\x02')
+        self.send(b'S|2000|2100|00240|CS')
+        self.send(b'g')
+        lut_length = struct.unpack('<H', self.read(2))[0]
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        data = struct.unpack(f'<{lut_length + 1}h', self.read(2 * (lut_length + 1)))
+        self.send(b'VS1')
+        # 1 mV per bit of the DVDAC, 2048 is 0 V
+        peak = data.index(max(data[1:-1]))
+        self.assertAlmostEqual(peak, lut_length // 2, delta=2)
+        self.assertGreater(data[peak], 0)
+
+    def test_chronocoulometry(self):
+        """ Test the charge trace of a pulse run matches the integral of the
+        current readings, with the baseline before the pulse taken off """
+        self.send(b'q|00100')
+        self.send(b'Q|0128|0140|00024')
+        self.send(b'R')
+        self.assertEqual(self.read(5, timeout=10), b'Done\x00')
+        self.send(b'J')
+        header = self.read(decoders.COULOMETRY_HEADER_SIZE)
+        trace = decoders.decode_coulometry(header + self.read(decoders.coulometry_size(header) -
+                                                              len(header)))
+        self.send(b'E0')
+        data = struct.unpack('<4001h', self.read(2 * 4001))
+        self.send(b'q|00000')
+        # sample k is read while the DAC is at look up table entry k-1, the pulse is entries 1000 to 1999
+        baseline = data[:1001]
+        self.assertEqual(trace["baseline"], len(baseline))
+        self.assertAlmostEqual(trace["baseline_counts"], sum(baseline) / len(baseline), delta=0.01)
+        self.assertEqual(trace["samples_integrated"], 2999)
+        self.assertEqual(len(trace["charge"]), 29)
+        for i, charge in enumerate(trace["charge"]):
+            samples = data[1001:1001 + 100 * (i + 1)]
+            expected = sum(samples) - len(samples) * trace["baseline_counts"]
+            self.assertAlmostEqual(charge, expected, delta=1, msg=f"charge point {i}")
+        self.assertGreater(trace["charge"][9], 0, msg="no charge from the pulse")
+
+    def test_current_dac_sources(self):
+        """ Test runs with the MIDAC and PIDAC as the voltage source, each
+        with its own virtual ground """
+        # MIDAC 1 mV per bit, 2048 is 0 V.  PIDAC 2 mV per bit, 1024 is 0 V
+        for source, command in ((3, b'S|2000|2100|00240|CS'), (4, b'S|1000|1050|00240|CS')):
+            self.send(b'VS' + str(source).encode())
+            self.send(b'VR')
+            self.assertEqual(self.read(2), b'V' + bytes([source]))
+            self.send(command)
+            self.send(b'g')
+            lut_length = struct.unpack('<H', self.read(2))[0]
+            self.send(b'R')
+            self.assertEqual(self.read(5), b'Done\x00')
+            self.send(b'E0')
+            data = struct.unpack(f'<{lut_length + 1}h', self.read(2 * (lut_length + 1)))
+            peak = data.index(max(data[1:-1]))
+            self.assertAlmostEqual(peak, lut_length // 2, delta=2, msg=f"voltage source {source}")
+            self.assertGreater(data[peak], 0)
+        self.send(b'VS1')
+
+    def test_unknown_voltage_source(self):
+        """ Test a voltage source that does not exist is refused with an error
+        and the voltage source in use is kept """
+        self.send(b'VS2')
+        self.send(b'VS9')
+        self.assertEqual(self.read(21), b'Error Voltage Source\x00')
+        self.send(b'VR')
+        self.assertEqual(self.read(2), b'V' + bytes([2]))
+        self.send(b'VS1')
+
+    def test_voltage_source_during_run(self):
+        """ Test the voltage source is not changed while a run holds the DAC """
+        self.send(b'VS1')
+        self.send(b'M|0140|0020')
+        self.assertEqual(self.read(6, timeout=10)[:4], b'Done')
+        self.send(b'VS2')
+        self.send(b'X')
+        replies = b''
+        while reply := self.read(64, timeout=0.5):  # the error comes between the "DoneX" of the buffers
+            replies += reply
+        self.assertIn(b'Error Voltage Source', replies, msg="voltage source was changed during a run")
+        self.send(b'VR')
+        self.assertEqual(self.read(2), b'V' + bytes([1]))
+
+    def test_mv_look_up_table(self):
+        """ Test the 'v' command makes the look up table for the voltage source in use """
+        # 1 mV per bit, 2048 is 0 V
+        self.send(b'VS2')
+        self.send(b'v|-0100|+0100|00100|CS')
+        self.send(b'g')
+        lut_length = struct.unpack('<H', self.read(2))[0]
+        self.assertEqual(lut_length, 402)
+        self.send(b'l|0402')
+        lut = struct.unpack('<201H', self.read(402))
+        self.assertEqual((lut[0], lut[200]), (1948, 2148))
+        # 16 mV per bit, 128 is 0 V, -100 mV rounds to -6 bits
+        self.send(b'VS1')
+        self.send(b'v|-0100|+0100|01000|CS')
+        self.send(b'g')
+        self.assertEqual(struct.unpack('<H', self.read(2))[0], 26)
+        self.send(b'l|0004')
+        self.assertEqual(struct.unpack('<2H', self.read(4)), (122, 123))
+        # 1 mV/s needs a period of 16*240000 with the VDAC
+        self.send(b'v|-0100|+0100|00001|CS')
+        self.assertEqual(self.read(16), b'Error Scan Rate\x00')
+        self.send(b'g')
+        self.assertEqual(struct.unpack('<H', self.read(2))[0], 26)
+
+    def test_swv_export(self):
+        """ Test the square wave formats combine the forward and reverse
+        readings of each step on the device """
+        self.send(b'G|0100|0120|0002|0005|00240|LS')
+        self.send(b'g')
+        lut_length = struct.unpack('<H', self.read(2))[0]
+        self.assertEqual(lut_length, 22)
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        raw = struct.unpack(f'<{lut_length + 1}h', self.read(2 * (lut_length + 1)))
+        steps = decoders.swv_steps(lut_length)
+        expected = [(raw[2 * i + 1], raw[2 * i + 2], raw[2 * i + 1] - raw[2 * i + 2])
+                    for i in range(steps)]
+        self.send(b'O|3')
+        self.send(b'E0')
+        self.assertEqual(decoders.decode_swv_difference(self.read(2 * steps)),
+                         [step[2] for step in expected])
+        self.send(b'O|4')
+        self.send(b'E0')
+        self.assertEqual(decoders.decode_swv_all(self.read(6 * steps)), expected)
+        self.send(b'O|0')
+        # the pulse is 5 VDAC bits up then down through the resistor
+        self.assertTrue(all(step[2] > 0 for step in expected))
+
+    def test_decimation(self):
+        """ Test the amperometry readings are averaged down with the 'f' command """
+        runs = {}
+        for command in (b'f|0|0000', b'f|1|0016', b'f|2|0016'):
+            self.send(command)
+            self.send(b'M|0140|0020')
+            self.assertEqual(self.read(6, timeout=10), b'Done0\x00')
+            self.send(b'X')
+            self.send(b'F0')
+            runs[command[2]] = struct.unpack('<21h', self.read(42))[:20]
+        self.send(b'f|0|0000')
+        raw_mean = sum(runs[ord('0')]) / 20
+        self.assertGreater(raw_mean, 0)
+        for filter_type in (ord('1'), ord('2')):
+            data = runs[filter_type]
+            self.assertAlmostEqual(sum(data) / len(data), raw_mean, delta=2 + abs(raw_mean) * 0.01)
+            self.assertLessEqual(max(data) - min(data), max(runs[ord('0')]) - min(runs[ord('0')]))
+
+    def test_streaming_route(self):
+        """ Test the 'u' command moves the ADC array exports to the streaming
+        endpoint, a picoamp export made in blocks still comes out whole """
+        self.send(b'u|1')
+        self.assertEqual(self.read(2), b'u1')
+        self.send(b'M|0140|0200')
+        self.assertEqual(self.read(6, timeout=10), b'Done0\x00')
+        self.send(b'X')
+        self.send(b'O|2')
+        self.send(b'F0')
+        currents = decoders.decode_picoamps(self.read(4 * 201))
+        self.send(b'O|0')
+        self.send(b'u|0')
+        self.assertEqual(self.read(2), b'u0')
+        self.assertEqual(len(currents), 201)
+        self.assertEqual(self.read(1, timeout=0.5), b'', msg="the export sent extra data")
+
+    def test_block_stats(self):
+        """ Test the statistics of each amperometry buffer are sent instead of
+        "DoneX" with 'Z|1', and the readings can still be read with 'F' """
+        self.send(b'Z|1')
+        self.send(b'M|0140|0020')
+        stats = decoders.decode_block_stats(self.read(decoders.BLOCK_STATS_SIZE, timeout=10))
+        self.send(b'X')
+        self.send(b'F%d' % stats["adc_buffer"])
+        data = struct.unpack('<21h', self.read(42))[:20]
+        self.send(b'Z|0')
+        self.assertEqual(stats["version"], decoders.BLOCK_STATS_VERSION)
+        self.assertEqual(stats["count"], 20)
+        self.assertEqual((stats["min"], stats["max"]), (min(data), max(data)))
+        self.assertAlmostEqual(stats["mean"], statistics.fmean(data), delta=2 ** -16)
+        self.assertAlmostEqual(stats["std"], statistics.pstdev(data), delta=2 ** -14)
+        self.send(b'M|0140|0020')
+        self.assertEqual(self.read(6, timeout=10)[:4], b'Done', msg="'Z|0' did not go back to DoneX")
+        self.send(b'X')
+
+    def test_peak_summary(self):
+        """ Test the peak summary is sent after a run, and the data of the run
+        after it when asked for """
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'p|1|05|00064')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        header = self.read(decoders.PEAKS_HEADER_SIZE)
+        summary = decoders.decode_peaks(header + self.read(decoders.peaks_size(header) - len(header)))
+        self.assertEqual(summary["version"], decoders.PEAKS_VERSION)
+        self.assertEqual(summary["sweeps"], 2)
+        # the current through the resistor follows the triangle wave, no peaks
+        self.assertEqual(summary["peaks"], [])
+        self.send(b'p|2|05|00064')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.assertEqual(self.read(decoders.PEAKS_HEADER_SIZE), header)
+        data = struct.unpack('<43h', self.read(2 * 43))
+        self.send(b'p|0|05|00064')
+        self.assertEqual(data[-1], -16384, msg="end of run marker (0xC000) is missing")
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.assertEqual(self.read(1, timeout=0.5), b'', msg="nothing is sent with the peaks off")
+
+    def test_wakeup_latency(self):
+        """ Test the wake up time of a run is reported and follows the settle time set with 'W' """
+        self.send(b'S|0090|0110|00240|CS')
+        for settle_ms in [20, 2]:
+            self.send(f'W|{settle_ms:05d}|{settle_ms:05d}|01000'.encode())
+            self.send(b'R')
+            self.assertEqual(self.read(5), b'Done\x00')
+            self.send(b'Y')
+            latency_us = struct.unpack_from('<I', self.read(64), 48)[0]
+            self.assertGreaterEqual(latency_us, 1000 * settle_ms)
+            self.assertLess(latency_us, 1000 * settle_ms + 5000)
+        self.send(b'W|00020|00020|01000')
+
+    def test_power_keep_warm(self):
+        """ Test the analog blocks are kept awake after a run and put to sleep after the keep warm time """
+        self.send(b'W|00020|00020|00300')
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'Y')
+        self.assertEqual(self.read(64)[47], 0x3F, msg="blocks were not kept awake")
+        time.sleep(0.5)
+        self.send(b'Y')
+        self.assertEqual(self.read(64)[47], 0, msg="blocks were not put to sleep")
+        self.send(b'W|00020|00020|01000')
+
+    def test_device_config(self):
+        """ Test the settings block in EEPROM rows 0 and 1 is only written when
+        the voltage source changes """
+        self.send(b'VS2')
+        with open(self.eeprom_file, 'rb') as eeprom:
+            config = eeprom.read(32)
+        self.assertEqual(config[0], 2)
+        self.assertEqual(config[1], 1, msg="settings version")
+        self.assertEqual(struct.unpack_from('<H', config, 30)[0],
+                         binascii.crc_hqx(config[:30], 0xFFFF))
+        written = os.stat(self.eeprom_file).st_mtime_ns
+        time.sleep(0.01)
+        self.send(b'VS2')
+        self.send(b'VR')
+        self.assertEqual(self.read(2), b'V\x02')
+        self.assertEqual(os.stat(self.eeprom_file).st_mtime_ns, written,
+                         msg="EEPROM was written without a change")
+        self.send(b'VS1')
+
+    def test_status(self):
+        """ Test the status packet has the counters of a run """
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'Y')
+        status = self.read(64)
+        self.assertEqual(len(status), 64)
+        version, isr_states, lut_index, lut_length = struct.unpack_from('<BBHH', status)
+        self.assertEqual(version, 1)
+        self.assertEqual(isr_states, 0, msg="isrs should be off after a run")
+        self.assertEqual(lut_length, 42)
+        samples_acquired = struct.unpack_from('<I', status, 12)[0]
+        self.assertGreaterEqual(samples_acquired, lut_length)
+
+    def test_partition(self):
+        """ Test the SRAM arena can be partitioned and ranges outside of the
+        new ADC arrays are refused """
+        self.send(b'P|01000|08|00500')
+        self.assertEqual(self.read(2), b'P1')
+        self.send(b'e|7|0000|0501')
+        self.assertEqual(len(self.read(2 * 501)), 2 * 501)
+        self.send(b'e|8|0000|0001')
+        self.assertEqual(self.read(16), b'Error Exporting\x00')
+        self.send(b'P|30000|04|05000')
+        self.assertEqual(self.read(2), b'P0', msg="partition larger than the arena was accepted")
+        self.send(b'P|05000|04|05000')
+        self.assertEqual(self.read(2), b'P1')
+
+    def test_background_subtraction(self):
+        """ Test a blank run is saved and taken off the next runs with the same
+        look up table """
+        self.send(b'K|1|00')
+        self.assertEqual(self.read(2), b'K0', msg="buffer 0 is used by the runs")
+        self.send(b'K|1|01')
+        self.assertEqual(self.read(2), b'K1')
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E1')
+        blank = struct.unpack('<43h', self.read(2 * 43))
+        self.send(b'Y')
+        self.assertEqual(self.read(64)[52], 0x01, msg="blank was not saved")
+        self.send(b'K|2|00')
+        self.assertEqual(self.read(2), b'K1')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        subtracted = struct.unpack('<43h', self.read(2 * 43))
+        self.send(b'Y')
+        self.assertEqual(self.read(64)[52], 0x03, msg="blank was not taken off")
+        # a different look up table is not subtracted
+        self.send(b'S|0090|0112|00240|CS')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'Y')
+        self.assertEqual(self.read(64)[52], 0x01)
+        self.send(b'K|0|00')
+        self.assertEqual(self.read(2), b'K1')
+        self.assertGreater(max(abs(x) for x in blank[1:-1]), 1000)
+        # only the noise of the 2 runs is left
+        self.assertLess(max(abs(x) for x in subtracted[1:-1]), 100)
+
+    def test_calibration_table(self):
+        """ Test a calibration is saved in the EEPROM table and read back """
+        self.send(b'A|1|3|0|F|0')
+        start_time = time.time()
+        self.send(b'B')
+        calibration = struct.unpack('<10h', self.read(20))
+        # the TIA settles in a few ms in the emulator, the fixed delays took 600 ms
+        self.assertLess(time.time() - start_time, 0.3)
+        self.send(b'k')
+        table = decoders.decode_calibration_table(self.read(decoders.CAL_TABLE_SIZE))
+        self.assertIn((3, 0, 1), table)
+        idac_values, adc_readings = table[(3, 0, 1)]
+        self.assertEqual(idac_values, calibration[:5])
+        self.assertEqual(adc_readings, calibration[5:])
+        self.send(b'A|2|0|0|F|0')  # back to the settings the device starts with
+
+    def test_calibration_sweep(self):
+        """ Test the sweep calibrates every TIA resistor and ADC buffer gain,
+        saves them in the table and puts the settings back """
+        self.send(b'A|2|3|0|F|0')
+        self.send(b'b')
+        sweep = decoders.decode_calibration_sweep(self.read(decoders.CAL_SWEEP_SIZE))
+        self.assertEqual(len(sweep), 32)
+        self.send(b'k')
+        table = decoders.decode_calibration_table(self.read(decoders.CAL_TABLE_SIZE))
+        for (resistor, gain), (idac_values, adc_readings) in sweep.items():
+            self.assertEqual(table[(resistor, gain, 2)], (idac_values, adc_readings))
+            # the highest current was picked to give about 1 V at the ADC
+            self.assertGreater(adc_readings[4], 0)
+            self.assertLess(adc_readings[0], 0)
+        self.send(b'B')
+        calibration = struct.unpack('<10h', self.read(20))
+        self.assertEqual(calibration[:5], sweep[(3, 0)][0], msg="TIA resistor was not put back")
+        self.send(b'A|2|0|0|F|0')
+
+    def test_n_point_calibration(self):
+        """ Test the device fits a line to an N point calibration and the
+        line matches the 5 point calibration """
+        self.send(b'A|1|3|0|F|0')
+        self.send(b'n|11')
+        fit = decoders.decode_calibration_fit(self.read(decoders.CAL_FIT_SIZE))
+        self.send(b'A|2|0|0|F|0')
+        self.assertTrue(fit["valid"])
+        self.assertEqual(fit["points"], 11)
+        # 2.048 V / (32768 counts * 80 kohms) = 781.25 pA per count
+        self.assertAlmostEqual(fit["pA_per_count"], 781.25, delta=781.25 * 0.01)
+        # the simulated TIA is linear, what is left is the noise and the settling
+        # tolerance, keep it under 0.5% of the 12.5 uA full scale current
+        self.assertLess(fit["max_residual_pA"], 0.005 * 12.5e6)
+
+    def test_autorange(self):
+        """ Test the range is lowered when the current saturates the ADC and
+        the data rescaled with the log matches a run with a fixed range """
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'A|2|0|0|F|0')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        reference = struct.unpack('<43h', self.read(2 * 43))
+        self.send(b'a|1')
+        self.send(b'A|2|7|0|F|0')  # 1 Mohm saturates the ADC
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        data = struct.unpack('<43h', self.read(2 * 43))
+        self.send(b'w')
+        log = decoders.decode_autorange_log(self.read(decoders.AUTORANGE_EXPORT_SIZE))
+        self.send(b'a|0')
+        self.send(b'A|2|0|0|F|0')
+        self.assertTrue(log["enabled"])
+        self.assertEqual(log["dropped"], 0)
+        events = log["events"]
+        self.assertEqual(events[0][1:], (0, 0, 7, 0))
+        self.assertGreater(len(events), 1, msg="range was not lowered")
+        resistors = [20, 30, 40, 80, 120, 250, 500, 1000]
+        _, _, last_switch, resistor, gain = events[-1]
+        self.assertLess(max(abs(x) for x in data[last_switch:-1]), 30000)
+        # the samples after the last switch, rescaled to the 20 kohm range
+        for x, ref in zip(data[last_switch:-1], reference[last_switch:-1]):
+            rescaled = x * 20 / (resistors[resistor] * 2 ** gain)
+            self.assertAlmostEqual(rescaled, ref, delta=3)
+
+    def test_autorange_blocks(self):
+        """ Test the autorange events of an amperometry run have the block
+        number of the 'Z' statistics and the log is cleared when it is sent """
+        self.send(b'a|1')
+        self.send(b'Z|1')
+        self.send(b'M|0140|0020')
+        stats = decoders.decode_block_stats(self.read(decoders.BLOCK_STATS_SIZE, timeout=10))
+        self.send(b'X')
+        self.send(b'Z|0')
+        self.send(b'w')
+        log = decoders.decode_autorange_log(self.read(decoders.AUTORANGE_EXPORT_SIZE))
+        self.send(b'w')
+        cleared = decoders.decode_autorange_log(self.read(decoders.AUTORANGE_EXPORT_SIZE))
+        self.send(b'a|0')
+        self.assertEqual(log["events"][0][:3], (stats["block"], stats["adc_buffer"], 0))
+        self.assertEqual(cleared["events"], [])
+
+    def test_autorange_off_during_run(self):
+        """ Test the range selected with 'A' is put back at the end of a run
+        that was ranging even if 'a|0' was sent during it """
+        self.send(b'a|1')
+        self.send(b'A|2|7|0|F|0')  # 1 Mohm saturates the ADC
+        self.send(b'M|0140|0020')
+        self.assertEqual(self.read(6, timeout=10)[:4], b'Done')
+        self.send(b'a|0')
+        self.send(b'X')
+        while self.read(6, timeout=0.5):  # the "DoneX" of the buffers filled before 'X'
+            pass
+        self.send(b'w')
+        log = decoders.decode_autorange_log(self.read(decoders.AUTORANGE_EXPORT_SIZE))
+        self.send(b'A|2|0|0|F|0')
+        self.assertEqual(log["events"][0][3:], (7, 0))
+        self.assertGreater(len(log["events"]), 1, msg="range was not lowered")
+        self.assertEqual(log["range"], (7, 0))
+
+    def test_autorange_refuses_picoamps(self):
+        """ Test the pA format and the peaks are refused with an error while
+        automatic ranging is on, and the ranging while they are selected, they
+        would convert every sample with the 'A' range """
+        self.send(b'a|1')
+        self.send(b'O|2')
+        self.assertEqual(self.read(16), b'Error Autorange\x00')
+        self.send(b'p|1|05|00064')
+        self.assertEqual(self.read(16), b'Error Autorange\x00')
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.assertEqual(self.read(1, timeout=0.5), b'', msg="peaks were sent with autorange on")
+        self.send(b'E0')
+        self.assertEqual(len(self.read(4 * 43, timeout=1)), 2 * 43, msg="pA format was used with autorange on")
+        self.send(b'a|0')
+        self.send(b'O|2')
+        self.send(b'a|1')
+        self.assertEqual(self.read(16), b'Error Autorange\x00')
+        self.send(b'w')
+        log = decoders.decode_autorange_log(self.read(decoders.AUTORANGE_EXPORT_SIZE))
+        self.send(b'O|0')
+        self.assertFalse(log["enabled"], msg="autorange was turned on with the pA format")
+
+    def test_picoamp_export(self):
+        """ Test the device converts the ADC readings to pA with the line
+        fitted to the calibration """
+        self.send(b'A|1|3|0|F|0')
+        self.send(b'B')
+        calibration = struct.unpack('<10h', self.read(20))
+        self.send(b'S|0090|0110|00240|CS')
+        self.send(b'R')
+        self.assertEqual(self.read(5), b'Done\x00')
+        self.send(b'E0')
+        counts = struct.unpack('<43h', self.read(2 * 43))
+        self.send(b'O|2')
+        self.send(b'E0')
+        currents = decoders.decode_picoamps(self.read(4 * 43))
+        self.send(b'O|0')
+        self.send(b'A|2|0|0|F|0')
+        # same least squares fit as calibrate_fit_line, the first 2 points sink
+        amps = [-125000 * v if i < 2 else 125000 * v
+                for i, v in enumerate(calibration[:5])]
+        adc = calibration[5:]
+        mean_x, mean_y = sum(adc) / 5, sum(amps) / 5
+        slope = (sum((x - mean_x) * (y - mean_y) for x, y in zip(adc, amps)) /
+                 sum((x - mean_x) ** 2 for x in adc))
+        # the 'E' command overwrites the first sample after it is exported
+        for count, current in zip(counts[1:], currents[1:]):
+            expected = slope * (count - mean_x) + mean_y
+            self.assertAlmostEqual(current, expected, delta=2 + abs(expected) * 1e-4)
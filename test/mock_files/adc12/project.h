@@ -0,0 +1,5 @@
+/* The default mocks with ADC configuration 1 built at 12 bits, to test the
+ * code that scales with the ADC resolution */
+
+#define ADC_SigDel_CFG1_RESOLUTION 12
+#include "../project.h"
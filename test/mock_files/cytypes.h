@@ -1 +1,19 @@
-//
\ No newline at end of file
+//
+#ifndef _CYTYPES_H_
+#define _CYTYPES_H_
+
+#include <stdint.h>
+
+// PSoC types used by the project files
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef float float32;
+
+#define CYRET_SUCCESS 0x00u
+#define CYRET_BAD_PARAM 0x02u
+
+#endif
@@ -8,6 +8,12 @@ int ADC_SigDel_StartConvert() {return 1;}
 int ADC_SigDel_Wakeup() {return 1;}
 int ADC_SigDel_Sleep() {return 1;}
 int ADC_SigDel_SetBufferGain(uint16_t foo) {return 1;}
+int ADC_SigDel_IsEndConversion(uint16_t foo) {return 1;}
+#define ADC_SigDel_RETURN_STATUS 1
+#if !defined(ADC_SigDel_CFG1_RESOLUTION)  // the adc12 mock builds configuration 1 at 12 bits
+#define ADC_SigDel_CFG1_RESOLUTION 16
+#endif
+#define ADC_SigDel_CFG2_RESOLUTION 16
 uint8_t ADC_buffer_index;
 
 int AMux_electrode_Select(uint16_t foo) {return 1;}
@@ -23,12 +29,24 @@ int AMux_V_source_Init() {return 1;}
 
 int CyDelay(uint16_t foo) {return 1;}
 int CyDelayUs(uint16_t foo) {return 1;}
+void CySysTickStart(void) {}
+void CySysTickSetCallback(uint32_t number, void (*function)(void)) {}
+uint32_t CySysTickGetValue(void) {return 0;}
+uint32_t CySysTickGetReload(void) {return 23999;}
+uint8_t CyEnterCriticalSection(void) {return 0;}
+void CyExitCriticalSection(uint8_t foo) {}
 
 void DAC_Start(void){}
 int VDAC_TIA_Wakeup() {return 1;}
 void DAC_Sleep(void){};
+void DAC_Stop(void){}
+uint8_t power_acquire(uint8_t holder, uint8_t blocks) {return 0;}
+void power_release(uint8_t holder, uint8_t blocks) {}
+void power_sleep_idle(void) {}
+uint8_t power_held(uint8_t blocks) {return 0;}
 int VDAC_TIA_Start() {return 1;}
-void DAC_SetValue(uint16_t value){}
+struct DacOps;  // DAC_SetValue is inline in DAC.h and calls through dac_ops
+const struct DacOps *dac_ops;
 int DVDAC_Stop() {return 1;}
 void DAC_Wakeup(void){}
 int VDAC_source_Stop() {return 1;}
@@ -39,6 +57,8 @@ int EEPROM_ReadByte(uint16_t foo) {return 1;}
 int EEPROM_UpdateTemperature() {return 1;}
 int EEPROM_WriteByte(uint16_t foo, uint16_t bar) {return 1;}
 int EEPROM_Stop() {return 1;}
+int EEPROM_Write(const uint8_t *foo, uint8_t bar) {return 0;}
+#define CYDEV_EEPROM_ROW_SIZE 16
 
 int isr_adcAmp_GetState() {return 1;}
 int isr_adc_Disable() {return 1;}
@@ -46,9 +66,17 @@ int isr_dac_Enable() {return 1;}
 int isr_dac_Disable() {return 1;}
 int isr_adcAmp_Enable() {return 1;}
 int isr_adc_Enable() {return 1;}
+int isr_adc_GetState() {return 1;}
 int isr_dac_GetState() {return 1;}
 int isr_adcAmp_Disable() {return 1;}
 
+int IDAC_calibrate_Start() {return 1;}
+int IDAC_calibrate_Stop() {return 1;}
+int IDAC_calibrate_SetValue(uint16_t foo) {return 1;}
+int IDAC_calibrate_SetPolarity(uint16_t foo) {return 1;}
+#define IDAC_calibrate_SOURCE 0
+#define IDAC_calibrate_SINK 4
+
 int Opamp_Aux_Wakeup() {return 1;}
 int Opamp_Aux_Start() {return 1;}
 int Opamp_Aux_Sleep() {return 1;}
@@ -63,9 +91,14 @@ int PWM_isr_WriteCompare(uint16_t foo) {return 1;}
 int TIA_Wakeup() {return 1;}
 int TIA_Start() {return 1;}
 int TIA_Sleep() {return 1;}
-int TIA_SetResFB(uint16_t foo) {return 1;}
+uint8_t mock_tia_resistor;  // last TIA resistor index set
+int TIA_SetResFB(uint16_t foo) {mock_tia_resistor = foo; return 1;}
 uint8_t TIA_resistor_value_index;
+uint8_t adc_recording_channel;  // in main.c
 
 void USB_Export_Data(uint8_t array[], uint16_t size){}
+void USB_Export_Sample_Data(uint8_t array[], uint16_t size){}
+void USB_Export_Sample_Block(uint8_t array[], uint16_t size){}
+void USB_Export_Sample_End(void){}
 
 #endif
@@ -0,0 +1,63 @@
+#ifndef _PROJECT_H_
+#define _PROJECT_H_
+
+#include "cytypes.h"
+
+/* Host side mock of the USBUART used to test usb_protocols.c.
+ * Every packet loaded into an IN endpoint or put into the CDC is recorded
+ * so the tests can check how the data was split up */
+
+#define USBUART_IN_BUFFER_EMPTY 2
+// a 12-bit ADC configuration to test the packed export below 16 bits
+#define ADC_SigDel_CFG1_RESOLUTION 12
+#define ADC_SigDel_CFG2_RESOLUTION 16
+#define MOCK_MAX_BYTES 20000
+#define MOCK_MAX_PACKETS 400
+
+uint8_t mock_ep_data[MOCK_MAX_BYTES];  // all the bytes loaded into the endpoint
+uint16_t mock_ep_packet_sizes[MOCK_MAX_PACKETS];  // size of each packet loaded
+uint16_t mock_ep_num_bytes;
+uint16_t mock_ep_num_packets;
+uint8_t mock_ep_last_endpoint;
+uint8_t mock_cdc_data[MOCK_MAX_BYTES];  // all the bytes put into the CDC
+uint16_t mock_cdc_num_bytes;
+uint16_t mock_cdc_num_packets;
+
+void mock_usb_reset(void) {
+    mock_ep_num_bytes = 0;
+    mock_ep_num_packets = 0;
+    mock_ep_last_endpoint = 0;
+    mock_cdc_num_bytes = 0;
+    mock_cdc_num_packets = 0;
+}
+
+uint8_t USBUART_GetEPState(uint8_t ep) {return USBUART_IN_BUFFER_EMPTY;}
+void USBUART_LoadInEP(uint8_t ep, const uint8_t data[], uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        mock_ep_data[mock_ep_num_bytes + i] = data[i];
+    }
+    mock_ep_num_bytes += length;
+    mock_ep_packet_sizes[mock_ep_num_packets] = length;
+    mock_ep_num_packets++;
+    mock_ep_last_endpoint = ep;
+}
+
+uint8_t USBUART_CDCIsReady(void) {return 1;}
+void USBUART_PutData(const uint8_t data[], uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        mock_cdc_data[mock_cdc_num_bytes + i] = data[i];
+    }
+    mock_cdc_num_bytes += length;
+    mock_cdc_num_packets++;
+}
+uint16_t USBUART_GetCount(void) {return 0;}
+uint16_t USBUART_GetData(uint8_t data[], uint16_t length) {return 0;}
+
+void CySysTickStart(void) {}
+void CySysTickSetCallback(uint32_t number, void (*function)(void)) {}
+uint32_t CySysTickGetValue(void) {return 0;}
+uint32_t CySysTickGetReload(void) {return 23999;}
+uint8_t CyEnterCriticalSection(void) {return 0;}
+void CyExitCriticalSection(uint8_t foo) {}
+
+#endif
@@ -0,0 +1,107 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the arena_partition function in the arena.c file splits the SRAM
+arena correctly and that arena_adc_range checks the bounds of the ADC buffers
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+MAX_LUT_SIZE = 5000
+ADC_CHANNELS = 4
+ARENA_LUT_PAD = 5
+ARENA_ADC_MARKER_PAD = 1
+ARENA_SIZE_WORDS = MAX_LUT_SIZE + ARENA_LUT_PAD + ADC_CHANNELS * (MAX_LUT_SIZE + ARENA_ADC_MARKER_PAD)
+
+
+class PartitionTestCase(unittest.TestCase):
+    """ Test that the arena partitions work properly
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = 'arena'
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["arena_partition", "arena_adc_range"],
+            header_includes=["extern uint16_t *waveform_lut;",
+                             "extern uint16_t arena_lut_size;",
+                             "extern int16_t *adc_buffers[];",
+                             "extern uint8_t arena_adc_buffer_count;",
+                             "extern uint16_t arena_adc_buffer_size;"],
+            compiled_file_end="partition")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def setUp(self) -> None:
+        """ Start each test with the default partition """
+        self.module.arena_partition(MAX_LUT_SIZE, ADC_CHANNELS, MAX_LUT_SIZE)
+
+    def address(self, pointer):
+        """ Get the address of a c pointer as an int """
+        return int(self.ffi.cast("uintptr_t", pointer))
+
+    def check_layout(self, lut_size, buffer_count, buffer_size):
+        """ Check the buffers follow the look up table and each other without
+        overlapping and stay in the arena """
+        lut_start = self.address(self.module.waveform_lut)
+        next_start = lut_start + 2 * (lut_size + ARENA_LUT_PAD)
+        for i in range(buffer_count):
+            self.assertEqual(self.address(self.module.adc_buffers[i]), next_start,
+                             msg=f"adc buffer {i} is in the wrong place")
+            next_start += 2 * (buffer_size + ARENA_ADC_MARKER_PAD)
+        self.assertLessEqual(next_start, lut_start + 2 * ARENA_SIZE_WORDS)
+
+    def test_default(self):
+        """ Test the default partition is the same as the old fixed arrays """
+        self.assertEqual(self.module.arena_lut_size, MAX_LUT_SIZE)
+        self.assertEqual(self.module.arena_adc_buffer_count, ADC_CHANNELS)
+        self.check_layout(MAX_LUT_SIZE, ADC_CHANNELS, MAX_LUT_SIZE)
+
+    def test_many_short_buffers(self):
+        """ Test making many short buffers for fast amperometry """
+        self.assertTrue(self.module.arena_partition(1000, 16, 1400))
+        self.assertEqual(self.module.arena_adc_buffer_count, 16)
+        self.assertEqual(self.module.arena_adc_buffer_size, 1400)
+        self.check_layout(1000, 16, 1400)
+
+    def test_large_lut(self):
+        """ Test using most of the arena for the look up table """
+        buffer_size = ARENA_SIZE_WORDS - 20000 - ARENA_LUT_PAD - ARENA_ADC_MARKER_PAD
+        self.assertTrue(self.module.arena_partition(20000, 1, buffer_size))
+        self.assertEqual(self.module.arena_lut_size, 20000)
+        self.check_layout(20000, 1, buffer_size)
+
+    def test_does_not_fit(self):
+        """ Test a partition that is too big or invalid is refused and the
+        old partition is kept """
+        self.assertFalse(self.module.arena_partition(MAX_LUT_SIZE, ADC_CHANNELS, MAX_LUT_SIZE + 2))
+        self.assertFalse(self.module.arena_partition(1000, 17, 100))
+        self.assertFalse(self.module.arena_partition(1000, 0, 100))
+        self.assertFalse(self.module.arena_partition(1000, 4, 0))
+        self.assertEqual(self.module.arena_adc_buffer_size, MAX_LUT_SIZE)
+        self.check_layout(MAX_LUT_SIZE, ADC_CHANNELS, MAX_LUT_SIZE)
+
+    def test_adc_range(self):
+        """ Test the bounds checks of the ADC buffer ranges """
+        self.module.arena_partition(1000, 8, 500)
+        start = self.module.arena_adc_range(2, 0, 501)  # the end of data marker can be read
+        self.assertEqual(self.address(start), self.address(self.module.adc_buffers[2]))
+        middle = self.module.arena_adc_range(2, 100, 50)
+        self.assertEqual(self.address(middle), self.address(start) + 200)
+        self.assertEqual(self.module.arena_adc_range(2, 1, 501), self.ffi.NULL)
+        self.assertEqual(self.module.arena_adc_range(8, 0, 1), self.ffi.NULL)
+        self.assertEqual(self.module.arena_adc_range(0, 65535, 65535), self.ffi.NULL)
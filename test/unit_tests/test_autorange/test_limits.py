@@ -0,0 +1,92 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the autorange.c file scales its limits with the resolution of the
+ADC configuration, ADC configuration 1 is built at 12 bits by the adc12 mock
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+LOW_SAMPLES = 16
+SETTLE_SAMPLES = 2
+
+
+class AutorangeLimitsTestCase(unittest.TestCase):
+    """ Test the range changes at the limits of each ADC resolution
+
+    Attributes:
+        _filenames (list[str]): names of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filenames = ['autorange', 'arena', 'calibrate', 'data_export', 'helper_functions', 'telemetry']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filenames, ["autorange_enable", "autorange_start", "autorange_sample",
+                             "autorange_stop"],
+            header_includes=["uint8_t selected_voltage_source;",
+                             "uint8_t ADC_config_index;",
+                             "uint8_t TIA_resistor_value_index;",
+                             "uint8_t mock_tia_resistor;"],
+            compiled_file_end="autorange_limits", mock_dir="adc12")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def setUp(self):
+        self.module.autorange_enable(1)
+
+    def tearDown(self):
+        self.module.autorange_stop()
+        self.module.autorange_enable(0)
+
+    def start(self, adc_config, resistor):
+        """ Start a run at a TIA resistor with the ADC configuration """
+        self.module.ADC_config_index = adc_config
+        self.module.TIA_resistor_value_index = resistor
+        self.module.autorange_start(100)
+
+    def run_readings(self, readings):
+        """ Put the readings through the ranging and return the TIA resistor in use """
+        for i, reading in enumerate(readings):
+            self.module.autorange_sample(reading, 0, i)
+        return self.module.mock_tia_resistor
+
+    def test_lower_12bit(self):
+        """ Test a reading above 1875 counts lowers the range at 12 bits, the
+        16-bit limit of 30000 counts can not be reached """
+        self.start(1, 7)
+        self.assertEqual(self.run_readings([0] * SETTLE_SAMPLES + [1870]), 7)
+        self.assertEqual(self.run_readings([1880]), 6)
+
+    def test_lower_16bit(self):
+        """ Test configuration 2 still uses the 16-bit limit """
+        self.start(2, 7)
+        self.assertEqual(self.run_readings([0] * SETTLE_SAMPLES + [2000, 29990]), 7)
+        self.assertEqual(self.run_readings([30010]), 6)
+
+    def test_raise_12bit(self):
+        """ Test the range is raised only if the readings stay below 1000 counts
+        at 12 bits with the higher gain, 500 kohm to 1000 kohm doubles them """
+        self.start(1, 6)
+        self.assertEqual(self.run_readings([0] * SETTLE_SAMPLES + [510] * (2 * LOW_SAMPLES)), 6)
+        self.assertEqual(self.run_readings([490] * LOW_SAMPLES), 7)
+
+    def test_raise_16bit(self):
+        """ Test the same readings raise the range at 16 bits """
+        self.start(2, 6)
+        self.assertEqual(self.run_readings([0] * SETTLE_SAMPLES + [510] * LOW_SAMPLES), 7)
+
+
+if __name__ == '__main__':
+    unittest.main()
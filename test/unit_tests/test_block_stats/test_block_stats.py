@@ -0,0 +1,98 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the block_stats_compute function in the block_stats.c file makes the
+same mean, standard deviation, min, max and slope as the statistics module
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import random
+import statistics
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+Q16 = 2 ** -16
+
+
+class BlockStatsTestCase(unittest.TestCase):
+    """ Test the integer statistics of a block of readings
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = ['block_stats', 'arena', 'telemetry']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["block_stats_compute"],
+            header_includes=["struct BlockStats {uint8_t version; uint8_t adc_buffer;"
+                             "uint16_t count; uint32_t block; int32_t mean_q16;"
+                             "uint32_t std_q16; int16_t min; int16_t max;"
+                             "int32_t slope_q16; uint32_t time_ms; uint32_t reserved;};"],
+            compiled_file_end="block_stats")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def compute(self, readings):
+        """ Put the readings through the c function and return the decoded statistics """
+        stats = self.ffi.new("struct BlockStats *")
+        samples = self.ffi.new("int16_t[]", readings)
+        self.module.block_stats_compute(samples, len(readings), stats)
+        data = bytes(self.ffi.buffer(stats))
+        self.assertEqual(len(data), decoders.BLOCK_STATS_SIZE)
+        return decoders.decode_block_stats(data)
+
+    def check_stats(self, readings):
+        """ Check the statistics against the statistics module """
+        stats = self.compute(readings)
+        self.assertEqual(stats["version"], decoders.BLOCK_STATS_VERSION)
+        self.assertEqual(stats["count"], len(readings))
+        self.assertEqual(stats["min"], min(readings))
+        self.assertEqual(stats["max"], max(readings))
+        self.assertAlmostEqual(stats["mean"], statistics.fmean(readings), delta=Q16)
+        # the variance is truncated to Q16 before the square root
+        self.assertAlmostEqual(stats["std"], statistics.pstdev(readings), delta=4 * Q16)
+        slope = statistics.linear_regression(range(len(readings)), readings).slope
+        self.assertAlmostEqual(stats["slope"], slope, delta=Q16)
+
+    def test_random(self):
+        """ Test a noisy drifting block """
+        random.seed(50)
+        self.check_stats([random.randint(-500, 500) + i // 3 - 1000 for i in range(4000)])
+
+    def test_full_scale(self):
+        """ Test the 64-bit sums do not overflow with full scale readings """
+        self.check_stats([-32768, 32767] * 2000)
+        self.check_stats([32767] * 8000)
+
+    def test_line(self):
+        """ Test the slope of a straight line is exact """
+        stats = self.compute([7 * i - 3000 for i in range(500)])
+        self.assertEqual(stats["slope"], 7)
+        self.assertEqual(stats["mean"], 7 * 499 / 2 - 3000)
+
+    def test_small_block(self):
+        """ Test the standard deviation of a short block keeps its precision """
+        self.check_stats([3, 5, 4, 6, 2, 5, 4, 3, 6, 5, 2, 4, 3, 5, 6, 4, 3, 2, 5, 4])
+
+    def test_short(self):
+        """ Test blocks of 1 and 0 readings """
+        stats = self.compute([123])
+        self.assertEqual((stats["mean"], stats["std"], stats["slope"]), (123, 0, 0))
+        self.assertEqual((stats["min"], stats["max"]), (123, 123))
+        self.assertEqual(self.compute([])["count"], 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,131 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the calibrate_fit_line and calibrate_fit_points functions in the
+calibrate.c file fit the calibration points with integer math as well as a
+floating point fit, and that the ADC counts are converted to pA by the
+export_counts_to_pA function
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+PICOAMPS_PER_IDAC_BIT = 125000
+
+
+def float_fit(idac_values, adc_counts, sink_points=2):
+    """ Least squares fit of the current against the ADC counts in floating
+    point, the first sink_points points sink current """
+    currents = [-PICOAMPS_PER_IDAC_BIT * v if i < sink_points else PICOAMPS_PER_IDAC_BIT * v
+                for i, v in enumerate(idac_values)]
+    n = len(adc_counts)
+    mean_x = sum(adc_counts) / n
+    mean_y = sum(currents) / n
+    slope = (sum((x - mean_x) * (y - mean_y) for x, y in zip(adc_counts, currents)) /
+             sum((x - mean_x) ** 2 for x in adc_counts))
+    return slope, mean_y - slope * mean_x
+
+
+class FitLineTestCase(unittest.TestCase):
+    """ Test that the calibrate_fit_line works properly
+
+    Attributes:
+        _filenames (list[str]): names of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filenames = ['calibrate', 'helper_functions', 'telemetry', 'data_export']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filenames, ["calibrate_fit_line", "calibrate_fit_points",
+                             "calibrate_nominal_pA_per_count_q16",
+                             "export_set_calibration", "export_counts_to_pA"],
+            header_includes=["uint8_t selected_voltage_source;",
+                             "struct CalibrateFit {int32_t pA_per_count_q16; int32_t offset_pA;"
+                             "int32_t max_residual_pA; uint8_t points; uint8_t max_residual_index;"
+                             "uint8_t valid; uint8_t version;};"],
+            compiled_file_end="fit_line")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def fit(self, idac_values, adc_counts):
+        """ Fit the points with the c function and return the slope in pA
+        per count and the offset in pA """
+        cal_data = self.ffi.new("int16_t[]", list(idac_values) + list(adc_counts))
+        slope = self.ffi.new("int32_t *")
+        offset = self.ffi.new("int32_t *")
+        self.assertTrue(self.module.calibrate_fit_line(cal_data, slope, offset))
+        return slope[0] / 65536, offset[0]
+
+    def test_fit(self):
+        """ Test the integer fit is the same as a floating point fit """
+        for idac_values, adc_counts in [((100, 50, 0, 50, 100), (-15993, -8010, 0, 7998, 15985)),
+                                        ((250, 125, 0, 125, 250), (-31900, -15930, 25, 15980, 31950)),
+                                        ((1, 0, 0, 0, 1), (-31993, -12, 1, 0, 31990)),
+                                        ((8, 4, 0, 4, 8), (-255, -130, -3, 122, 250))]:
+            slope, offset = self.fit(idac_values, adc_counts)
+            float_slope, float_offset = float_fit(idac_values, adc_counts)
+            self.assertAlmostEqual(slope, float_slope, delta=abs(float_slope) * 1e-4 + 1 / 65536)
+            self.assertAlmostEqual(offset, float_offset, delta=1 + abs(float_slope) * 1e-3)
+
+    def test_fit_points(self):
+        """ Test an N point fit matches a floating point fit and finds the
+        point furthest from the line """
+        idac_values = list(range(-100, 101, 10))
+        adc_counts = [160 * v + 3 for v in idac_values]
+        adc_counts[15] += 40  # make 1 point not linear
+        fit = self.ffi.new("struct CalibrateFit *")
+        self.module.calibrate_fit_points(self.ffi.new("int16_t[]", idac_values),
+                                         self.ffi.new("int16_t[]", adc_counts),
+                                         len(idac_values), fit)
+        float_slope, float_offset = float_fit(idac_values, adc_counts, sink_points=0)
+        self.assertTrue(fit.valid)
+        self.assertEqual(fit.points, 21)
+        self.assertAlmostEqual(fit.pA_per_count_q16 / 65536, float_slope, delta=1 / 65536)
+        self.assertAlmostEqual(fit.offset_pA, float_offset, delta=2)
+        self.assertEqual(fit.max_residual_index, 15)
+        residuals = [abs(PICOAMPS_PER_IDAC_BIT * v - (float_slope * x + float_offset))
+                     for v, x in zip(idac_values, adc_counts)]
+        self.assertAlmostEqual(fit.max_residual_pA, max(residuals), delta=3)
+
+    def test_offset_rounding(self):
+        """ Test an offset of half a pA is rounded away from 0 for both signs,
+        the slope is 3906.25 pA per count so the offset is -+7812.5 pA """
+        fit = self.ffi.new("struct CalibrateFit *")
+        for adc_counts, offset in [([-30, 34], -7813), ([-34, 30], 7813)]:
+            self.module.calibrate_fit_points(self.ffi.new("int16_t[]", [-1, 1]),
+                                             self.ffi.new("int16_t[]", adc_counts), 2, fit)
+            self.assertEqual(fit.pA_per_count_q16, 3906.25 * 65536)
+            self.assertEqual(fit.offset_pA, offset)
+
+    def test_fit_flat(self):
+        """ Test the fit fails if the ADC did not change """
+        cal_data = self.ffi.new("int16_t[]", [100, 50, 0, 50, 100] + [5] * 5)
+        slope = self.ffi.new("int32_t *")
+        offset = self.ffi.new("int32_t *")
+        self.assertFalse(self.module.calibrate_fit_line(cal_data, slope, offset))
+
+    def test_nominal(self):
+        """ Test the nominal pA per count of a few settings """
+        # 1.024 V / (32768 counts * 20 kohms) = 1562.5 pA per count
+        self.assertEqual(self.module.calibrate_nominal_pA_per_count_q16(0, 0, 2), 1562.5 * 65536)
+        # 2.048 V / (32768 counts * 8 gain * 1000 kohms) = 7.8125 pA per count
+        self.assertEqual(self.module.calibrate_nominal_pA_per_count_q16(7, 3, 1), 7.8125 * 65536)
+
+    def test_counts_to_pA(self):
+        """ Test the conversion of ADC counts to pA rounds to the nearest pA """
+        slope_q16 = int(1562.5 * 65536)
+        self.module.export_set_calibration(slope_q16, -300)
+        for counts in [-32768, -1001, -1, 0, 1, 777, 32767]:
+            self.assertEqual(self.module.export_counts_to_pA(counts),
+                             int((counts * slope_q16 + 32768) // 65536) - 300)
@@ -0,0 +1,48 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that calibrate_nominal_pA_per_count_q16 in the calibrate.c file uses the
+full scale of the ADC resolution, with ADC configuration 1 built at 12 bits
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+
+class Nominal12BitTestCase(unittest.TestCase):
+    """ Test the nominal conversion of a 12-bit ADC configuration
+
+    Attributes:
+        _filenames (list[str]): names of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filenames = ['calibrate', 'helper_functions', 'telemetry', 'data_export']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filenames, ["calibrate_nominal_pA_per_count_q16"],
+            header_includes=["uint8_t selected_voltage_source;"],
+            compiled_file_end="nominal_12bit", mock_dir="adc12")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def test_nominal_12bit(self):
+        """ Test a 12-bit configuration has 2048 counts at full scale """
+        # 2.048 V / (2048 counts * 8 gain * 1000 kohms) = 125 pA per count
+        self.assertEqual(self.module.calibrate_nominal_pA_per_count_q16(7, 3, 1), 125 * 65536)
+        # configuration 2 is still 16 bits, 1.024 V / (32768 counts * 20 kohms)
+        self.assertEqual(self.module.calibrate_nominal_pA_per_count_q16(0, 0, 2), 1562.5 * 65536)
+
+
+if __name__ == '__main__':
+    unittest.main()
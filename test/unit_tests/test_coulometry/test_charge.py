@@ -0,0 +1,98 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the coulometry_sample function in the coulometry.c file integrates
+the baseline corrected readings the same as summing them on the host
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import random
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+BASE = 128
+PULSE = 140
+
+
+class ChargeTestCase(unittest.TestCase):
+    """ Test that the charge is integrated properly
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = 'coulometry'
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["coulometry_set", "coulometry_start", "coulometry_sample",
+                            "coulometry_get_trace"],
+            header_includes=["struct CoulometryTrace {uint8_t version; uint8_t dropped;"
+                             "uint16_t points; uint16_t samples_per_point;"
+                             "uint16_t baseline_samples; int32_t baseline_q16;"
+                             "uint32_t samples_integrated; int64_t charge_q16[128];};"],
+            compiled_file_end="charge")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def run_pulse(self, readings, dac_values, samples_per_point):
+        """ Put a run through the c functions and return the decoded trace """
+        self.module.coulometry_set(samples_per_point)
+        self.module.coulometry_start(dac_values[0])
+        for reading, dac_value in zip(readings, dac_values):
+            self.module.coulometry_sample(reading, dac_value)
+        trace = self.module.coulometry_get_trace()
+        data = bytes(self.ffi.buffer(trace, decoders.COULOMETRY_HEADER_SIZE + 8 * trace.points))
+        return decoders.decode_coulometry(data)
+
+    def test_charge(self):
+        """ Test the charge is the sum of the readings minus the baseline average """
+        random.seed(48)
+        dac_values = [BASE] * 100 + [PULSE] * 200 + [BASE] * 200
+        readings = [random.randint(-200, 200) + (3000 if v == PULSE else 0) - 50
+                    for v in dac_values]
+        trace = self.run_pulse(readings, dac_values, 10)
+        baseline = sum(readings[:100]) / 100
+        self.assertEqual(trace["version"], decoders.COULOMETRY_VERSION)
+        self.assertEqual(trace["baseline"], 100)
+        self.assertAlmostEqual(trace["baseline_counts"], baseline, delta=2 ** -16)
+        self.assertEqual(trace["samples_integrated"], 400)
+        self.assertEqual(len(trace["charge"]), 40)
+        self.assertFalse(trace["dropped"])
+        for i, charge in enumerate(trace["charge"]):
+            samples = readings[100:100 + 10 * (i + 1)]
+            expected = sum(samples) - len(samples) * baseline
+            self.assertAlmostEqual(charge, expected, delta=len(samples) * 2 ** -16,
+                                   msg=f"charge point {i}")
+
+    def test_off(self):
+        """ Test nothing is integrated when chronocoulometry is off """
+        trace = self.run_pulse([1000] * 20, [BASE] * 5 + [PULSE] * 15, 0)
+        self.assertEqual(trace["samples_integrated"], 0)
+        self.assertEqual(trace["charge"], [])
+
+    def test_full_scale(self):
+        """ Test the 64-bit integral does not overflow with a full scale current """
+        dac_values = [BASE] * 10 + [PULSE] * 60000
+        trace = self.run_pulse([-32768] * 10 + [32767] * 60000, dac_values, 1000)
+        self.assertEqual(trace["charge"][-1], 60000 * 65535)
+
+    def test_dropped(self):
+        """ Test the points that do not fit are flagged """
+        trace = self.run_pulse([5] * 300, [BASE] + [PULSE] * 299, 2)
+        self.assertEqual(len(trace["charge"]), 128)
+        self.assertTrue(trace["dropped"])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,7 @@
+# Copyright (c) 2022 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+
+"""
+
+__author__ = "Kyle Vitatus Lopin"
@@ -0,0 +1,150 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the boxcar and CIC filters in the decimate.c file give the same
+data points as a floating point reference of the same filter
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import math
+import random
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+DECIMATE_OFF = 0
+DECIMATE_BOXCAR = 1
+DECIMATE_CIC = 2
+CIC_ORDER = 3
+
+
+def boxcar_reference(readings: list[int], ratio: int) -> list[float]:
+    """ Average of each block of ratio readings """
+    return [sum(readings[i:i + ratio]) / ratio
+            for i in range(0, len(readings) - ratio + 1, ratio)]
+
+
+def cic_reference(readings: list[int], ratio: int) -> list[float]:
+    """ 3 moving sums of ratio readings in a row, with every ratio-th output
+    kept and divided by the gain of ratio^3.  The first CIC_ORDER-1 outputs
+    have the zeros the sums start with in them so they are not kept """
+    filtered = list(readings)
+    for _ in range(CIC_ORDER):
+        running_sum = 0
+        moving_sums = []
+        for i, value in enumerate(filtered):
+            running_sum += value
+            if i >= ratio:
+                running_sum -= filtered[i - ratio]
+            moving_sums.append(running_sum)
+        filtered = moving_sums
+    return [x / ratio ** CIC_ORDER for x in filtered[ratio - 1::ratio][CIC_ORDER - 1:]]
+
+
+class DecimateTestCase(unittest.TestCase):
+    """ Test that the decimation filters work properly
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = 'decimate'
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(cls._filename,
+                                                ["decimate_set", "decimate_reset",
+                                                 "decimate_sample"],
+                                                compiled_file_end="decimate")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def decimate(self, readings, filter_type, ratio):
+        """ Put the readings through the c filter and return the saved data points """
+        self.module.decimate_set(filter_type, ratio)
+        output = self.ffi.new("int16_t *")
+        data_points = []
+        for reading in readings:
+            if self.module.decimate_sample(reading, output):
+                data_points.append(output[0])
+        return data_points
+
+    def check_reference(self, data_points, reference):
+        """ Check the c filter is the reference rounded to the nearest count """
+        self.assertEqual(len(data_points), len(reference))
+        for i, (point, ref) in enumerate(zip(data_points, reference)):
+            self.assertLessEqual(abs(point - ref), 0.5, msg=f"data point {i}")
+
+    def test_off(self):
+        """ Test every reading is saved when the filter is off, or the ratio is 1 """
+        readings = [5, -3, 32767, -32768]
+        self.assertEqual(self.decimate(readings, DECIMATE_OFF, 10), readings)
+        self.assertEqual(self.decimate(readings, DECIMATE_BOXCAR, 1), readings)
+
+    def test_boxcar(self):
+        """ Test the boxcar averages each block of readings """
+        random.seed(46)
+        readings = [random.randint(-32768, 32767) for _ in range(1000)]
+        for ratio in [2, 3, 10, 64, 100]:
+            self.check_reference(self.decimate(readings, DECIMATE_BOXCAR, ratio),
+                                 boxcar_reference(readings, ratio))
+
+    def test_cic(self):
+        """ Test the CIC filter matches 3 moving averages once it has filled """
+        random.seed(46)
+        readings = [random.randint(-32768, 32767) for _ in range(600)]
+        for ratio in [2, 5, 16, 50]:
+            self.check_reference(self.decimate(readings, DECIMATE_CIC, ratio),
+                                 cic_reference(readings, ratio))
+
+    def test_cic_large_ratio(self):
+        """ Test the CIC filter does not overflow at the largest ratio with a
+        full scale input """
+        ratio = 4096
+        readings = [-32768] * (4 * ratio)
+        data_points = self.decimate(readings, DECIMATE_CIC, ratio)
+        self.assertEqual(data_points, [-32768, -32768])
+        # a slow sine wave keeps its amplitude
+        readings = [round(30000 * math.sin(2 * math.pi * i / (10 * ratio)))
+                    for i in range(20 * ratio)]
+        self.check_reference(self.decimate(readings, DECIMATE_CIC, ratio),
+                             cic_reference(readings, ratio))
+
+    def test_cic_constant(self):
+        """ Test a constant input gives the constant from the first saved data
+        point, the filter does not save the points made while it fills """
+        for ratio in [2, 5, 16]:
+            for value in [1000, -2500, 32767]:
+                data_points = self.decimate([value] * (10 * ratio), DECIMATE_CIC, ratio)
+                self.assertEqual(data_points, [value] * (10 - CIC_ORDER + 1),
+                                 msg=f"ratio {ratio}, input {value}")
+
+    def test_reset(self):
+        """ Test a reset starts a new block """
+        self.module.decimate_set(DECIMATE_BOXCAR, 4)
+        output = self.ffi.new("int16_t *")
+        for reading in [1000, 1000]:
+            self.assertFalse(self.module.decimate_sample(reading, output))
+        self.module.decimate_reset()
+        ready = [self.module.decimate_sample(8, output) for _ in range(4)]
+        self.assertEqual(ready, [False, False, False, True])
+        self.assertEqual(output[0], 8)
+        # the CIC filter fills again after a reset
+        self.module.decimate_set(DECIMATE_CIC, 2)
+        for reading in [-9000] * 7:
+            self.module.decimate_sample(reading, output)
+        self.module.decimate_reset()
+        ready = [self.module.decimate_sample(8, output) for _ in range(6)]
+        self.assertEqual(ready, [False, False, False, False, False, True])
+        self.assertEqual(output[0], 8)
+
+
+if __name__ == '__main__':
+    unittest.main()
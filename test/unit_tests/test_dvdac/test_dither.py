@@ -0,0 +1,127 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the DVDAC_SetValue function in the HighResDacs.cylib DVDAC
+component, that uses the dither patterns made by DVDAC_InitDither, fills the
+dither array the same as the element by element loop it replaced, for every
+DAC code of each resolution
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import importlib
+import os
+import re
+import sys
+import unittest
+
+# installed libraries
+import cffi
+
+# local files
+from test import helper_functions as helper_funcs
+
+API_DIR = os.path.join(helper_funcs.root_dir, 'HighResDacs.cylib', 'DVDAC_v1_4', 'API')
+INSTANCE_NAME = "DVDAC"
+
+# the loop DVDAC_SetValue used before the dither patterns, to compare against
+REFERENCE_SET_VALUE = """
+void reference_SetValue(uint16 value, uint8 DArray[]) {
+   uint8 msb;
+   uint8 lsb;
+   uint8 i;
+   msb = (uint8)(value >> DVDAC_SHIFT_LEN);
+   lsb = (uint8)(value & DVDAC_LSB_MASK);
+   if (msb == 0xFF) {
+        for(i=0; i < DVDAC_DITHER_SIZE; i++) {
+            DArray[i] = 0xFF;
+        }
+   }
+   else {
+        for(i=0; i < DVDAC_DITHER_SIZE; i++) {
+            if(i > lsb ) {
+                DArray[i] = msb;
+            }
+            else {
+                DArray[i] = msb+1;
+            }
+        }
+    }
+}
+"""
+
+
+def fill_template(text: str, resolution: int) -> str:
+    """ Fill in the PSoC Creator template fields that the dither code uses """
+    text = text.replace("`$INSTANCE_NAME`", INSTANCE_NAME)
+    text = text.replace("`$Resolution`", str(resolution))
+    text = text.replace("`$Initial_Value`", "0")
+    return re.sub(r"`=ReentrantKeil\([^`]*\)`", "", text)
+
+
+def get_function(source: str, name: str) -> str:
+    """ Get the text of a function from its definition to its closing brace """
+    start = re.search(r"^void " + name + r"\(", source, re.MULTILINE).start()
+    index = source.index("{", start)
+    depth = 0
+    while True:
+        if source[index] == "{":
+            depth += 1
+        elif source[index] == "}":
+            depth -= 1
+            if depth == 0:
+                return source[start:index + 1]
+        index += 1
+
+
+def load_dither(resolution: int):
+    """ Compile the dither code of the DVDAC component for a resolution """
+    with open(os.path.join(API_DIR, 'DVDAC.c'), 'r', encoding="utf-8") as _file:
+        source = fill_template(_file.read(), resolution)
+    with open(os.path.join(API_DIR, 'DVDAC.h'), 'r', encoding="utf-8") as _file:
+        header = fill_template(_file.read(), resolution)
+    # the constants the dither code needs, the rest of the header is for the hardware
+    defines = [line for line in header.split('\n')
+               if re.match(r"#define DVDAC_(DEFAULT_DATA|SHIFT_LEN|DITHER_SIZE|LSB_MASK|DITHER_WORDS|MSB_TO_WORD)\b", line)]
+    variables = [line for line in source.split('\n')
+                 if re.match(r"(static )?uint(8|16|32) .*DVDAC_(currentValue|DArrayWords|DArray|ditherPatterns)\b", line)]
+    code = "\n".join(['#include "cytypes.h"'] + defines + variables +
+                     [get_function(source, "DVDAC_InitDither"),
+                      get_function(source, "DVDAC_SetValue"), REFERENCE_SET_VALUE])
+    ffi_builder = cffi.FFI()
+    ffi_builder.cdef("void DVDAC_InitDither(void); void DVDAC_SetValue(uint16_t value);"
+                     "void reference_SetValue(uint16_t value, uint8_t DArray[]);"
+                     "uint8_t * const DVDAC_DArray;")
+    compiled_filename = f"py_test_dither_{resolution}"
+    ffi_builder.set_source(compiled_filename, code, include_dirs=[helper_funcs.MOCK_FILE_DIR])
+    ffi_builder.compile()
+    sys.path.append(os.getcwd())
+    _module = importlib.import_module(compiled_filename)
+    return _module.lib, _module.ffi
+
+
+class DitherTestCase(unittest.TestCase):
+    """ Test that the DVDAC_SetValue works properly """
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def test_all_codes(self):
+        """ Test every DAC code gives the same dither array as the old loop """
+        for resolution in range(9, 13):
+            with self.subTest(resolution=resolution):
+                module, ffi = load_dither(resolution)
+                module.DVDAC_InitDither()
+                dither_size = 1 << (resolution - 8)
+                reference = ffi.new("uint8_t[]", dither_size)
+                for value in range(1 << resolution):
+                    module.DVDAC_SetValue(value)
+                    module.reference_SetValue(value, reference)
+                    self.assertEqual(list(module.DVDAC_DArray[0:dither_size]), list(reference),
+                                     msg=f"value {value} at {resolution} bits")
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,76 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the export_run_samples function in the data_export.c file leaves the
+0xC000 end of run marker out of the packed format, where it can not be told
+apart from a reading at less than 16 bits
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import struct
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+END_MARKER = -16384  # 0xC000
+EXPORT_FORMAT_RAW16 = 0
+EXPORT_FORMAT_PACKED = 1
+ADC_CONFIG_12_BIT = 1  # ADC_SigDel_CFG1_RESOLUTION of the usbuart mock
+
+
+class ExportMarkerTestCase(unittest.TestCase):
+    """ Test the end of run marker in the different export formats
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = ['data_export', 'usb_protocols', 'telemetry']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["export_set_format", "export_set_resolution",
+                            "export_run_samples"],
+            header_includes=["void mock_usb_reset(void);",
+                             "uint8_t mock_cdc_data[];",
+                             "uint16_t mock_cdc_num_bytes;"],
+            compiled_file_end="export_marker", mock_dir="usbuart")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def export_run(self, readings, export_format):
+        """ Export a run that ends with the marker and return the bytes sent """
+        self.module.mock_usb_reset()
+        self.module.export_set_format(export_format)
+        self.module.export_set_resolution(ADC_CONFIG_12_BIT)
+        samples = self.ffi.new("int16_t[]", readings + [END_MARKER])
+        self.module.export_run_samples(samples, len(readings))
+        self.module.export_set_format(EXPORT_FORMAT_RAW16)
+        return bytes(self.ffi.buffer(self.module.mock_cdc_data, self.module.mock_cdc_num_bytes))
+
+    def test_packed_12_bit(self):
+        """ Test the packed data is only the readings, with no marker packed to 0 """
+        readings = [0, 2047, -2048, -1, 5, 0, 100]
+        data = self.export_run(readings, EXPORT_FORMAT_PACKED)
+        self.assertEqual(data[0], 12)
+        self.assertEqual(len(data), decoders.packed_size(len(readings), 12))
+        self.assertListEqual(decoders.decode_packed(data, len(readings)), readings)
+
+    def test_raw_keeps_marker(self):
+        """ Test the raw format still ends with the marker """
+        readings = [0, 2047, -2048]
+        data = self.export_run(readings, EXPORT_FORMAT_RAW16)
+        self.assertListEqual(list(struct.unpack('<4h', data)), readings + [END_MARKER])
+
+
+if __name__ == '__main__':
+    unittest.main()
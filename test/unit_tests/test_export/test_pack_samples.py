@@ -0,0 +1,69 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the export_pack_samples function in the data_export.c file packs
+the ADC data so the host decoder gets the same numbers back
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+
+class PackSamplesTestCase(unittest.TestCase):
+    """ Test that the export_pack_samples works properly
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = 'data_export'
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(cls._filename, ["export_pack_samples"],
+                                                compiled_file_end="pack_samples")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def pack(self, samples, bits):
+        """ Pack the samples with the c function and return the packed bytes """
+        c_samples = self.ffi.new("int16_t[]", samples)
+        packed = self.ffi.new("uint8_t[]", 2 * len(samples) + 1)
+        num_bytes = self.module.export_pack_samples(c_samples, len(samples),
+                                                    bits, packed)
+        return bytes(self.ffi.buffer(packed, num_bytes))
+
+    def test_12_bit(self):
+        """ Test 2 12-bit samples are packed into 3 bytes """
+        packed = self.pack([0x123, -1], 12)
+        self.assertEqual(packed, bytes([0x23, 0xF1, 0xFF]))
+
+    def test_round_trip(self):
+        """ Test the host decoder gets the same numbers back for every
+        resolution, including a last group that does not end on a byte """
+        for bits in range(8, 17):
+            low = -(1 << (bits - 1))
+            high = (1 << (bits - 1)) - 1
+            samples = [low, high, 0, -1, 1] + [(i * 37) % high for i in range(40)]
+            packed = self.pack(samples, bits)
+            self.assertEqual(len(packed) + 1, decoders.packed_size(len(samples), bits),
+                             msg=f"wrong number of bytes for {bits} bits")
+            decoded = decoders.decode_packed(bytes([bits]) + packed, len(samples))
+            self.assertListEqual(decoded, samples,
+                                 msg=f"{bits}-bit samples did not decode properly")
+
+    def test_16_bit_is_raw(self):
+        """ Test packing at 16 bits gives the same bytes as the raw format """
+        samples = [0, 1, -2, 32767, -32768]
+        packed = self.pack(samples, 16)
+        self.assertListEqual(decoders.decode_raw16(packed), samples)
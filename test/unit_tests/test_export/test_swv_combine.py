@@ -0,0 +1,80 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the export_swv_combine function in the data_export.c file gives
+the same forward, reverse and difference of each square wave step as the
+host used to compute from the raw readings
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import random
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+
+class SWVCombineTestCase(unittest.TestCase):
+    """ Test that the export_swv_combine works properly
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = 'data_export'
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(cls._filename,
+                                                ["export_swv_combine", "export_swv_steps"],
+                                                compiled_file_end="swv_combine")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def combine(self, samples, fmt):
+        """ Combine the samples with the c function and return the results """
+        steps = len(samples) // 2
+        c_samples = self.ffi.new("int16_t[]", samples)
+        combined = self.ffi.new("int16_t[]", 3 * steps + 1)
+        num_values = self.module.export_swv_combine(c_samples, steps, fmt, combined)
+        return list(combined[0:num_values])
+
+    def test_difference(self):
+        """ Test only the difference of each step is returned """
+        random.seed(45)
+        samples = [random.randint(-30000, 30000) for _ in range(64)]
+        expected = [samples[i] - samples[i + 1] for i in range(0, 64, 2)]
+        expected = [max(-32768, min(32767, x)) for x in expected]
+        self.assertEqual(self.combine(samples, decoders.EXPORT_FORMAT_SWV_DIFFERENCE),
+                         expected)
+
+    def test_all(self):
+        """ Test the forward, reverse and difference of each step are returned """
+        samples = [100, 40, -5, 20, 7, 7]
+        self.assertEqual(self.combine(samples, decoders.EXPORT_FORMAT_SWV_ALL),
+                         [100, 40, 60, -5, 20, -25, 7, 7, 0])
+
+    def test_saturate(self):
+        """ Test the differences that do not fit in 16 bits are limited """
+        samples = [32000, -32000, -32000, 32000]
+        self.assertEqual(self.combine(samples, decoders.EXPORT_FORMAT_SWV_DIFFERENCE),
+                         [32767, -32768])
+
+    def test_steps(self):
+        """ Test the number of steps skips the first sample and the unpaired entry at the end """
+        for lut_length in [0, 1, 2, 3, 42, 43]:
+            self.assertEqual(self.module.export_swv_steps(lut_length),
+                             decoders.swv_steps(lut_length), msg=f"lut length {lut_length}")
+        self.assertEqual(self.module.export_swv_steps(43), 21)
+        self.assertEqual(self.module.export_swv_steps(42), 20)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,51 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the helper_crc16 function in the helper_functions.c file gives the
+same CRC as python so the host can check the data saved in the EEPROM
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import binascii
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+
+class CRC16TestCase(unittest.TestCase):
+    """ Test that the helper_crc16 works properly
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = 'helper_functions'
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(cls._filename, ["helper_crc16"],
+                                                header_includes=["uint8_t selected_voltage_source;"],
+                                                compiled_file_end="crc16")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def crc(self, data: bytes) -> int:
+        """ Calculate the CRC of the data with the c function """
+        return self.module.helper_crc16(self.ffi.new("uint8_t[]", data), len(data))
+
+    def test_check_value(self):
+        """ Test the standard check value of CRC-16/CCITT-FALSE """
+        self.assertEqual(self.crc(b"123456789"), 0x29B1)
+
+    def test_same_as_python(self):
+        """ Test the CRC is the same as binascii.crc_hqx for different data """
+        for data in [b"", b"\x00", bytes(22), bytes(range(256)), b"\xff" * 30]:
+            self.assertEqual(self.crc(data), binascii.crc_hqx(data, 0xFFFF),
+                             msg=f"CRC is wrong for {data}")
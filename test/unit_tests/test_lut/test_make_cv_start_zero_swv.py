@@ -18,7 +18,7 @@ from test.unit_tests.test_lut import solutions
 
 class LUTMakeCVStartZero(unittest.TestCase):
     """ Test that the LUT_MakeTriangle_Wave function works properly"""
-    _filename = 'lut_protocols'
+    _filename = ['lut_protocols', 'arena']
 
     @classmethod
     def setUpClass(cls):
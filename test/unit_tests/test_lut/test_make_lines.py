@@ -26,7 +26,7 @@ class LuTMakeLineTestCase(unittest.TestCase):
     @classmethod
     def setUpClass(cls):
         """ Load the file just one time for each test """
-        cls._filename = 'lut_protocols'
+        cls._filename = ['lut_protocols', 'arena']
         cls.module, _ = helper_funcs.load(cls._filename, ["LUT_make_line"],
                                           header_includes=["static uint16_t waveform_lut[];"],
                                           compiled_file_end="make_lines")
@@ -20,7 +20,7 @@ class LuTMakeTriangleWave(unittest.TestCase):
     @classmethod
     def setUpClass(cls):
         """ Load the file just one time for each test """
-        cls._filename = 'lut_protocols'
+        cls._filename = ['lut_protocols', 'arena']
         # make the waveform_lut static, for testing it doesn't matter,
         # and it suppresses an error
         cls.module, _ = helper_funcs.load(cls._filename,
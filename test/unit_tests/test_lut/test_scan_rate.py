@@ -0,0 +1,59 @@
+# Copyright (c) 2022 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the LUT_Convert2Signed and LUT_scan_rate_to_period functions
+used by the 'v' command work properly in the lut_protocols.c file
+"""
+
+# standard libraries
+import unittest
+
+# local files
+import test.helper_functions as helper_funcs
+
+PWM_CLOCK_HZ = 240000
+
+
+class LuTScanRateTestCase(unittest.TestCase):
+    """ Test the potentials and scan rate of the 'v' command are converted properly
+
+    Attributes:
+        _filename (list[str]): names of the c and h files
+        used in the unit tests
+        module: compiles c module to use for testing
+    """
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls._filename = ['lut_protocols', 'arena']
+        cls.module, _ = helper_funcs.load(cls._filename,
+                                          ["LUT_Convert2Signed", "LUT_scan_rate_to_period"],
+                                          header_includes=["static uint16_t waveform_lut[];"],
+                                          compiled_file_end="scan_rate")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def test_signed(self):
+        """ Test the sign and digits are converted """
+        self.assertEqual(self.module.LUT_Convert2Signed(b"+0800", 5), 800)
+        self.assertEqual(self.module.LUT_Convert2Signed(b"-0500", 5), -500)
+        self.assertEqual(self.module.LUT_Convert2Signed(b"-0000", 5), 0)
+
+    def test_period(self):
+        """ Test the PWM period steps 1 DAC bit per sample at the scan rate """
+        for mv_per_bit in [1, 2, 16]:
+            for scan_rate in [5, 100, 333, 1000, 65535]:
+                period = self.module.LUT_scan_rate_to_period(scan_rate, mv_per_bit)
+                self.assertEqual(period, round(PWM_CLOCK_HZ * mv_per_bit / scan_rate),
+                                 msg=f"{scan_rate} mV/s at {mv_per_bit} mV per bit")
+
+    def test_period_too_slow(self):
+        """ Test a scan rate of 0 returns 0 and slow rates are not cut to 16 bits """
+        self.assertEqual(self.module.LUT_scan_rate_to_period(0, 1), 0)
+        self.assertEqual(self.module.LUT_scan_rate_to_period(1, 16), 16 * PWM_CLOCK_HZ)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -23,7 +23,7 @@ class SWVMakeLineTestCase(unittest.TestCase):
         used in the integration tests
         module: compiles c module to use for testing
     """
-    _filenames = 'lut_protocols'
+    _filenames = ['lut_protocols', 'arena']
 
     @classmethod
     def setUpClass(cls) -> None:
@@ -0,0 +1,132 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the peaks_find function in the peaks.c file finds the peaks of
+each sweep of a voltammetry run and does not count the noise as peaks
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import math
+import random
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+
+def make_cv(start: int, end: int) -> list[int]:
+    """ Triangle look up table from start to end and back """
+    return list(range(start, end)) + list(range(end, start - 1, -1))
+
+
+def gaussian(x: float, center: float, width: float, height: float) -> float:
+    """ Peak shape added to the current """
+    return height * math.exp(-((x - center) / width) ** 2)
+
+
+class FindPeaksTestCase(unittest.TestCase):
+    """ Test that the peaks_find works properly
+
+    Attributes:
+        _filename (list[str]): names of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = ['peaks', 'data_export']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["peaks_set", "peaks_find"],
+            header_includes=["struct PeaksEntry {uint16_t sample_index; uint16_t dac_value;"
+                             "int16_t potential_mV; int16_t counts; int32_t current_pA;"
+                             "uint8_t sweep; int8_t direction; uint16_t reserved;};",
+                             "struct PeaksSummary {uint8_t version; uint8_t count; uint8_t sweeps;"
+                             "uint8_t dropped; struct PeaksEntry peaks[16];};"],
+            compiled_file_end="find_peaks")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def find(self, samples, lut, window=5, threshold=64):
+        """ Find the peaks with the c function, samples[i+1] is read at lut[i] """
+        self.module.peaks_set(1, window, threshold)
+        c_samples = self.ffi.new("int16_t[]", samples)
+        c_lut = self.ffi.new("uint16_t[]", lut)
+        summary = self.ffi.new("struct PeaksSummary *")
+        self.module.peaks_find(c_samples, c_lut, len(lut), summary)
+        return summary
+
+    def run_cv(self, lut, noise=0):
+        """ Oxidation peak on the forward sweep at 150, reduction peak on the reverse at 140 """
+        random.seed(47)
+        samples = [0]
+        for i, value in enumerate(lut[:-1]):
+            forward = i < len(lut) // 2
+            current = 10 * (value - 100)
+            if forward:
+                current += gaussian(value, 150, 8, 4000)
+            else:
+                current -= gaussian(value, 140, 8, 4000)
+            samples.append(round(current + random.gauss(0, noise)))
+        samples.append(-16384)  # end of run marker
+        return samples
+
+    def test_cv_peaks(self):
+        """ Test a peak is found on each sweep at the right potential """
+        lut = make_cv(100, 200)
+        summary = self.find(self.run_cv(lut, noise=20), lut)
+        self.assertEqual(summary.version, 1)
+        self.assertEqual(summary.sweeps, 2)
+        self.assertEqual(summary.count, 2)
+        self.assertEqual(summary.dropped, 0)
+        forward, reverse = summary.peaks[0], summary.peaks[1]
+        self.assertEqual((forward.sweep, forward.direction), (0, 1))
+        self.assertEqual((reverse.sweep, reverse.direction), (1, -1))
+        self.assertAlmostEqual(forward.dac_value, 151, delta=3)
+        self.assertAlmostEqual(reverse.dac_value, 139, delta=3)
+        self.assertEqual(lut[forward.sample_index - 1], forward.dac_value)
+        self.assertGreater(forward.counts, 4000)
+        self.assertLess(reverse.counts, -3000)
+
+    def test_noise_not_peaks(self):
+        """ Test a straight line with noise below the threshold has no peaks """
+        lut = make_cv(100, 200)
+        random.seed(47)
+        samples = [0] + [10 * (v - 100) + random.randint(-100, 100) for v in lut[:-1]] + [-16384]
+        summary = self.find(samples, lut)
+        self.assertEqual(summary.sweeps, 2)
+        self.assertEqual(summary.count, 0)
+        # without smoothing or threshold the noise is counted
+        summary = self.find(samples, lut, window=1, threshold=10)
+        self.assertGreater(summary.count, 2)
+
+    def test_too_many_peaks(self):
+        """ Test the peaks that do not fit are counted """
+        lut = list(range(100, 400))
+        samples = [0] + [1000 * (i % 10 < 5) for i in range(len(lut) - 1)] + [-16384]
+        summary = self.find(samples, lut, window=1, threshold=100)
+        self.assertEqual(summary.count, 16)
+        self.assertEqual(summary.dropped, 29 - 16)
+
+    def test_sweeps_saturate(self):
+        """ Test a square wave look up table, which turns around every step,
+        stops counting the sweeps at 255 instead of wrapping """
+        lut = [100 + 50 * (i % 2) for i in range(600)]
+        samples = [0] + [1000 * (i % 2) for i in range(len(lut) - 1)] + [-16384]
+        summary = self.find(samples, lut)
+        self.assertEqual(summary.sweeps, 255)
+        self.assertEqual(summary.count, 0)
+
+    def test_short_run(self):
+        """ Test a look up table too short to smooth has no peaks """
+        summary = self.find([0, 1, 2, -16384], [100, 101, 102])
+        self.assertEqual(summary.count, 0)
+
+
+if __name__ == '__main__':
+    unittest.main()
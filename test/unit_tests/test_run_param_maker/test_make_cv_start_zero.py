@@ -23,7 +23,7 @@ class RunParamMaker(unittest.TestCase):
     @classmethod
     def setUpClass(cls):
         """ Load the file just one time for each test """
-        cls._filename = 'lut_protocols'
+        cls._filename = ['lut_protocols', 'arena']
         # make the waveform_lut static, for testing it doesn't matter,
         # and it suppresses an error
         cls.module = helper_funcs.load(cls._filename,
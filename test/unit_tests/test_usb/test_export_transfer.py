@@ -0,0 +1,97 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the export_samples function in the data_export.c file sends an
+export made in blocks as 1 transfer on the streaming endpoint, only the last
+packet is short or a zero length packet
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import unittest
+
+# local files
+from host import decoders
+from test import helper_functions as helper_funcs
+
+USB_ROUTE_CDC = 0
+USB_ROUTE_STREAMING_ENDPOINT = 1
+EXPORT_FORMAT_RAW16 = 0
+EXPORT_FORMAT_PACKED = 1
+EXPORT_FORMAT_PICOAMPS = 2
+ADC_CONFIG_12_BIT = 1  # ADC_SigDel_CFG1_RESOLUTION of the usbuart mock
+
+
+class ExportTransferTestCase(unittest.TestCase):
+    """ Test the blocks of an export are joined into 1 transfer
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = ['data_export', 'usb_protocols', 'telemetry']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["export_set_format", "export_set_resolution",
+                            "export_samples", "USB_Set_Data_Route"],
+            header_includes=["void mock_usb_reset(void);",
+                             "uint8_t mock_ep_data[];",
+                             "uint16_t mock_ep_packet_sizes[];",
+                             "uint16_t mock_ep_num_bytes;",
+                             "uint16_t mock_ep_num_packets;"],
+            compiled_file_end="export_transfer", mock_dir="usbuart")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def setUp(self) -> None:
+        self.module.mock_usb_reset()
+        self.module.USB_Set_Data_Route(USB_ROUTE_STREAMING_ENDPOINT)
+        self.module.export_set_resolution(ADC_CONFIG_12_BIT)
+
+    def tearDown(self) -> None:
+        self.module.USB_Set_Data_Route(USB_ROUTE_CDC)
+        self.module.export_set_format(EXPORT_FORMAT_RAW16)
+
+    def export(self, samples, export_format):
+        """ Export the samples and return the data and packet sizes the endpoint got """
+        self.module.export_set_format(export_format)
+        self.module.export_samples(self.ffi.new("int16_t[]", samples), len(samples))
+        data = bytes(self.ffi.buffer(self.module.mock_ep_data, self.module.mock_ep_num_bytes))
+        packets = helper_funcs.convert_c_array_to_list(
+            self.module.mock_ep_packet_sizes, 0, self.module.mock_ep_num_packets)
+        return data, packets
+
+    def check_one_transfer(self, packets, num_bytes):
+        """ Check every packet is full except the last one """
+        self.assertEqual(sum(packets), num_bytes)
+        self.assertTrue(all(size == 64 for size in packets[:-1]), msg=f"{packets}")
+        self.assertLess(packets[-1], 64)
+        if num_bytes % 64 == 0:
+            self.assertEqual(packets[-1], 0, msg="a zero length packet ends the transfer")
+
+    def test_picoamps(self):
+        """ Test the currents converted in blocks are sent as 1 transfer """
+        samples = [(i * 7) % 2000 - 1000 for i in range(1000)]
+        data, packets = self.export(samples, EXPORT_FORMAT_PICOAMPS)
+        self.check_one_transfer(packets, 4 * len(samples))
+        self.assertEqual(len(decoders.decode_picoamps(data)), len(samples))
+
+    def test_packed(self):
+        """ Test the data packed in blocks is sent as 1 transfer """
+        for count in (700, 298, 42):  # short last packet, full last packet over 2 blocks and in 1
+            self.module.mock_usb_reset()
+            samples = [(i * 13) % 4000 - 2000 for i in range(count)]
+            data, packets = self.export(samples, EXPORT_FORMAT_PACKED)
+            self.check_one_transfer(packets, decoders.packed_size(count, 12))
+            self.assertListEqual(decoders.decode_packed(data, count), samples)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,105 @@
+# Copyright (c) 2023 Kyle Lopin (Naresuan University) <kylel@nu.ac.th>
+
+"""
+Test that the USB_Stream_Data function in the usb_protocols.c file splits
+the data into full size packets for the bulk streaming endpoint
+"""
+
+__author__ = "Kyle Vitautus Lopin"
+
+# standard libraries
+import struct
+import unittest
+
+# local files
+from test import helper_functions as helper_funcs
+
+STREAMING_ENDPOINT = 4
+USB_ROUTE_CDC = 0
+USB_ROUTE_STREAMING_ENDPOINT = 1
+TELEMETRY_PACKET_SIZE = 64
+# offset of usb_bytes_sent and usb_packets_sent in the struct Telemetry
+TELEMETRY_USB_OFFSET = 28
+
+
+class StreamDataTestCase(unittest.TestCase):
+    """ Test that the USB_Stream_Data works properly with a mock USBUART
+
+    Attributes:
+        _filename (str): name of the c and h files used in the tests
+        module: compiles c module to use for testing
+        ffi: cffi interface to make the c arrays
+    """
+    _filename = ['usb_protocols', 'telemetry']
+
+    @classmethod
+    def setUpClass(cls):
+        """ Load the file just one time for each test """
+        cls.module, cls.ffi = helper_funcs.load(
+            cls._filename, ["USB_Stream_Data", "USB_Set_Data_Route",
+                            "USB_Export_Sample_Data", "telemetry_snapshot"],
+            header_includes=["void mock_usb_reset(void);",
+                             "uint8_t mock_ep_data[];",
+                             "uint16_t mock_ep_packet_sizes[];",
+                             "uint16_t mock_ep_num_bytes;",
+                             "uint16_t mock_ep_num_packets;",
+                             "uint8_t mock_ep_last_endpoint;",
+                             "uint16_t mock_cdc_num_bytes;"],
+            compiled_file_end="stream_data", mock_dir="usbuart")
+
+    @classmethod
+    def tearDownClass(cls) -> None:
+        helper_funcs.remove_compiled_files()
+
+    def setUp(self) -> None:
+        """ Clear the data recorded by the mock USBUART """
+        self.module.mock_usb_reset()
+
+    def stream(self, size):
+        """ Stream size bytes and return the data and packet sizes the mock
+        endpoint got """
+        data = bytes(i % 251 for i in range(size))
+        self.module.USB_Stream_Data(self.ffi.new("uint8_t[]", data), size)
+        sent = bytes(self.ffi.buffer(self.module.mock_ep_data,
+                                     self.module.mock_ep_num_bytes))
+        packets = helper_funcs.convert_c_array_to_list(
+            self.module.mock_ep_packet_sizes, 0, self.module.mock_ep_num_packets)
+        self.assertEqual(sent, data, msg="data was changed by the streaming endpoint")
+        self.assertEqual(self.module.mock_ep_last_endpoint, STREAMING_ENDPOINT)
+        return packets
+
+    def test_short_packet_ends(self):
+        """ Test data that does not fill the last packet is sent without
+        a zero length packet """
+        self.assertListEqual(self.stream(150), [64, 64, 22])
+
+    def test_zero_length_packet(self):
+        """ Test a zero length packet ends a transfer of full packets """
+        self.assertListEqual(self.stream(128), [64, 64, 0])
+
+    def test_route_to_endpoint(self):
+        """ Test the sample data goes to the streaming endpoint when it is
+        selected, and back to the CDC """
+        route = self.module.USB_Set_Data_Route(USB_ROUTE_STREAMING_ENDPOINT)
+        self.assertEqual(route, USB_ROUTE_STREAMING_ENDPOINT)
+        self.module.USB_Export_Sample_Data(self.ffi.new("uint8_t[]", 100), 100)
+        self.assertEqual(self.module.mock_cdc_num_bytes, 0)
+        self.assertEqual(self.module.mock_ep_num_bytes, 100)
+        route = self.module.USB_Set_Data_Route(USB_ROUTE_CDC)
+        self.assertEqual(route, USB_ROUTE_CDC)
+        self.module.USB_Export_Sample_Data(self.ffi.new("uint8_t[]", 100), 100)
+        self.assertEqual(self.module.mock_cdc_num_bytes, 100)
+        self.assertEqual(self.module.mock_ep_num_bytes, 100)
+
+    def test_telemetry_usb_counters(self):
+        """ Test the telemetry counts the bytes and packets sent on the CDC
+        and the streaming endpoint """
+        packet = self.ffi.new("uint8_t[]", TELEMETRY_PACKET_SIZE)
+        self.module.telemetry_snapshot(packet)
+        bytes_before, packets_before = struct.unpack_from("<2I", bytes(packet), TELEMETRY_USB_OFFSET)
+        self.stream(150)
+        self.module.USB_Export_Sample_Data(self.ffi.new("uint8_t[]", 100), 100)
+        self.module.telemetry_snapshot(packet)
+        bytes_after, packets_after = struct.unpack_from("<2I", bytes(packet), TELEMETRY_USB_OFFSET)
+        self.assertEqual(bytes_after - bytes_before, 250)
+        self.assertEqual(packets_after - packets_before, 5)